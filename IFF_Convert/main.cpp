@@ -0,0 +1,109 @@
+// O------------------------------------------------------------------------------O
+// | IFF Convert |
+// O------------------------------------------------------------------------------O
+
+// Decodes and exports IFF images without opening a window, so that batch
+// conversion runs on machines with no display. Links the library only;
+// olcPixelGameEngine is not involved.
+
+#include "BatchConverter.h"
+#include "FileData.h"
+#include "lyra/lyra.hpp"
+
+using std::cout;
+
+// Prints what each file in the folder (not below it) holds.
+int PrintInfo(const string &path) {
+  size_t shown = 0;
+  for (const auto &file_path :
+       IFFReader::GetPathsInFolder(fs::absolute(path))) {
+    const IFFReader::File file(file_path.string());
+    const auto image = file.AsILBM();
+    if (!image) {
+      cout << "Skipped " << file_path.filename().string()
+           << ": not a readable IFF ILBM.\n";
+      continue;
+    }
+    cout << "File: " << file_path.filename().string() << "\n"
+         << image->GetImageInfo() << "\n";
+    ++shown;
+  }
+
+  if (shown == 0) {
+    cout << "No suitable IFF files found.\n";
+    return 2;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  string path;
+  string output = ".";
+  string format_name = "ppm";
+  auto show_info = false;
+  auto show_help = false;
+  IFFReader::ConvertSettings settings;
+  const auto cli =
+      lyra::cli_parser() | lyra::help(show_help) |
+      lyra::opt(output, "folder")["-o"]["--output"](
+          "Folder for converted images (default: current folder).") |
+      lyra::opt(format_name, "ppm|pam|png|raw")["-f"]["--format"](
+          "Output format (default ppm).") |
+      lyra::opt(settings.correct_aspect)["-a"]["--aspect"](
+          "Make pixels square, going by the aspect in the file.") |
+      lyra::opt(settings.threads, "threads")["--threads"](
+          "Threads per decode, resolve and encode stage (default 2).") |
+      lyra::opt(settings.io_threads, "threads")["--io-threads"](
+          "Threads per read and write stage (default 2).") |
+      lyra::opt(settings.queue_length, "images")["--queue"](
+          "Images waiting between two stages (default 4).") |
+      lyra::opt(show_info)["-i"]["--info"](
+          "Print image information instead of converting.") |
+      lyra::arg(path, "path")("File or folder tree to convert.");
+
+  const auto result = cli.parse({argc, argv});
+  if (!result) {
+    cout << result.errorMessage() << "\n";
+    return 1;
+  }
+
+  if (show_help) {
+    cout << cli << "\n";
+    return 0;
+  }
+
+  if (!IFFReader::ParseExportFormat(format_name, settings.format)) {
+    cout << "Unknown format " << format_name << ".\n";
+    return 1;
+  }
+
+  if (path.empty()) {
+    cout << "You need to supply a file path.\n";
+    return 1;
+  }
+
+  if (!IFFReader::CheckPath(path)) {
+    cout << "File or path " << fs::absolute(path).string() << " not found.\n";
+    return 1;
+  }
+
+  if (show_info) {
+    return PrintInfo(path);
+  }
+
+  // The tree below path is recreated in output, files passing through the
+  // bounded pipeline of BatchConverter.h.
+  const auto stats = IFFReader::ConvertTree(
+      fs::absolute(path), fs::absolute(output), settings,
+      [](const fs::path &source, const string &reason) {
+        cout << "Skipped " << source.string() << ": " << reason << ".\n";
+      });
+  cout << IFFReader::FormatConvertStats(stats);
+
+  if (stats.images == 0) {
+    cout << "No suitable IFF files found.\n";
+    return 2;
+  }
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include "AnimBenchmark.h"
+
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+using std::chrono::steady_clock;
+
+constexpr double MEGABYTE = 1 << 20;
+
+static const double SecondsSince(const steady_clock::time_point start) {
+  return std::chrono::duration<double>(steady_clock::now() - start).count();
+}
+
+// Operation J goes by its letter, the others by number.
+static const string OperationName(const uint8_t operation) {
+  return operation >= 'A' ? string(1, static_cast<char>(operation))
+                          : std::to_string(operation);
+}
+
+void IFFReader::BenchmarkDeltas(const ANIM &anim, const size_t passes,
+                                DeltaBenchmarks &results) {
+  if (!anim.Image()) {
+    return;
+  }
+
+  // Clips are counted once per operation they use.
+  map<uint8_t, bool> seen;
+  const auto &first = anim.FirstPlanes();
+  vector<uint8_t> chunky(static_cast<size_t>(first.width) * first.height);
+  vector<uint32_t> rows;
+
+  for (size_t pass = 0; pass < passes; ++pass) {
+    array<PlanarFrame, 2> buffers = {first, first};
+    size_t shown = 0;
+
+    for (size_t n = 1; n < anim.FrameCount(); ++n) {
+      const auto header = anim.FrameHeader(n);
+      const auto delta = anim.FrameDelta(n);
+      if (!header || !delta) {
+        continue;
+      }
+      auto &result = results[header->Operation()];
+      if (!seen[header->Operation()]) {
+        seen[header->Operation()] = true;
+        ++result.clips;
+      }
+      ++result.frames;
+      result.delta_bytes += delta->GetData().size();
+      if (!SupportsDeltaOperation(header->Operation())) {
+        ++result.failed;
+        continue;
+      }
+
+      const auto target = header->Interleave() == 1 ? shown : 1 - shown;
+      DirtyRows dirty(first.height, 0);
+      auto start = steady_clock::now();
+      if (!ApplyDelta(*header, delta->GetData(), buffers[target], dirty)) {
+        ++result.failed;
+      }
+      result.seconds += SecondsSince(start);
+
+      rows.clear();
+      for (uint32_t y = 0; y < dirty.size(); ++y) {
+        if (dirty[y]) {
+          rows.push_back(y);
+        }
+      }
+      start = steady_clock::now();
+      PlanarRowsToChunky(buffers[target], rows, chunky.data());
+      result.chunky_seconds += SecondsSince(start);
+      result.rows += rows.size();
+      shown = target;
+    }
+  }
+}
+
+const double IFFReader::DeltaBenchmark::MicrosecondsPerFrame() const {
+  return frames > 0 ? seconds * 1e6 / frames : 0;
+}
+
+const double IFFReader::DeltaBenchmark::MegabytesPerSecond() const {
+  return seconds > 0 ? delta_bytes / MEGABYTE / seconds : 0;
+}
+
+const string IFFReader::FormatDeltaBenchmarks(const DeltaBenchmarks &results) {
+  std::ostringstream text;
+  text << std::fixed << std::setprecision(2);
+  for (const auto &entry : results) {
+    const auto &result = entry.second;
+    text << "Operation " << OperationName(entry.first) << ": " << result.clips
+         << " clips, " << result.frames << " frames";
+    if (!SupportsDeltaOperation(entry.first)) {
+      text << ", not supported.\n";
+      continue;
+    }
+    if (result.failed > 0) {
+      text << " (" << result.failed << " damaged)";
+    }
+    text << ", " << result.MicrosecondsPerFrame() << " us/frame, "
+         << result.MegabytesPerSecond() << " MB/s of deltas, "
+         << (result.frames > 0 ? double(result.rows) / result.frames : 0)
+         << " rows changed per frame, "
+         << (result.frames > 0 ? result.chunky_seconds * 1e6 / result.frames
+                               : 0)
+         << " us/frame to chunky.\n";
+  }
+  if (results.empty()) {
+    text << "No animations found.\n";
+  }
+  return text.str();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "Animation.h"
+
+/*
+ * Timing ANIM delta decoders against each other. Every frame of a clip is
+ * decoded as in playback, into two planar buffers by turns, and the time
+ * spent applying deltas is summed per operation, apart from the time spent
+ * converting the rows they changed to chunky indices. Results from several
+ * clips add up, so an archive can be measured as a whole.
+ */
+namespace IFFReader {
+
+struct DeltaBenchmark {
+  size_t clips = 0;
+  size_t frames = 0;
+  size_t failed = 0; // Frames whose delta was damaged.
+  uint64_t delta_bytes = 0;
+  uint64_t rows = 0; // Changed, over all frames.
+  double seconds = 0;
+  double chunky_seconds = 0;
+
+  const double MicrosecondsPerFrame() const;
+
+  // Delta data decoded per second.
+  const double MegabytesPerSecond() const;
+};
+
+// Results by ANHD operation.
+using DeltaBenchmarks = map<uint8_t, DeltaBenchmark>;
+
+// Decodes every frame of the clip passes times, adding to results.
+// Operations that cannot be decoded are counted, but not timed.
+void BenchmarkDeltas(const ANIM &anim, const size_t passes,
+                     DeltaBenchmarks &results);
+
+// A line per operation: frames, time per frame, throughput and rows.
+const string FormatDeltaBenchmarks(const DeltaBenchmarks &results);
+} // namespace IFFReader
@@ -0,0 +1,568 @@
+#include "AnimDelta.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <functional>
+
+using std::array;
+
+// DLTA starts with a pointer per plane (up to eight), then eight more that
+// only operation 7 uses, for its data lists. Zero means the plane is
+// unchanged.
+constexpr size_t PLANE_POINTERS = 8;
+constexpr size_t DELTA_HEADER = 16 * 4;
+
+IFFReader::PlanarFrame::PlanarFrame(const uint32_t width,
+                                    const uint32_t height,
+                                    const uint16_t planes)
+    : width(width), height(height), planes(planes),
+      row_bytes((width + 15) / 16 * 2),
+      bytes(row_bytes * height * planes, 0) {}
+
+uint8_t *IFFReader::PlanarFrame::Plane(const uint16_t p) {
+  return bytes.data() + p * PlaneSize();
+}
+
+const uint8_t *IFFReader::PlanarFrame::Plane(const uint16_t p) const {
+  return bytes.data() + p * PlaneSize();
+}
+
+const size_t IFFReader::PlanarFrame::PlaneSize() const {
+  return row_bytes * height;
+}
+
+static const uint32_t ReadLong(const uint8_t *bytes) {
+  return uint32_t(bytes[0]) << 24 | uint32_t(bytes[1]) << 16 |
+         uint32_t(bytes[2]) << 8 | bytes[3];
+}
+
+// Big endian word or longword.
+template <typename Word> static const uint32_t ReadWord(const uint8_t *bytes) {
+  if constexpr (sizeof(Word) == 2) {
+    return uint32_t(bytes[0]) << 8 | bytes[1];
+  } else {
+    return ReadLong(bytes);
+  }
+}
+
+// Stores or XORs Bytes bytes of a value into the plane.
+template <size_t Bytes, bool Xor>
+static void Put(uint8_t *out, const uint8_t *value) {
+  if constexpr (Xor) {
+    for (size_t i = 0; i < Bytes; ++i) {
+      out[i] ^= value[i];
+    }
+  } else {
+    std::memcpy(out, value, Bytes);
+  }
+}
+
+// Decodes every plane of the frame in parallel. Planes mark rows of their
+// own, merged into dirty once all are done.
+using PlaneDecoder =
+    std::function<bool(const uint16_t plane, uint8_t *dirty)>;
+
+static const bool ForEachPlane(IFFReader::PlanarFrame &frame,
+                               IFFReader::DirtyRows &dirty,
+                               const PlaneDecoder &decode) {
+  const auto planes = std::min<size_t>(frame.planes, PLANE_POINTERS);
+  vector<IFFReader::DirtyRows> touched(planes,
+                                       IFFReader::DirtyRows(frame.height, 0));
+  array<bool, PLANE_POINTERS> valid;
+  valid.fill(true);
+
+  IFFReader::ThreadPool::Shared().ParallelFor(
+      0, planes, 1, [&](const size_t first, const size_t last) {
+        for (auto p = first; p < last; ++p) {
+          valid[p] = decode(static_cast<uint16_t>(p), touched[p].data());
+        }
+      });
+
+  dirty.resize(frame.height, 0);
+  for (const auto &rows : touched) {
+    for (uint32_t y = 0; y < frame.height; ++y) {
+      dirty[y] |= rows[y];
+    }
+  }
+  return std::all_of(valid.begin(), valid.begin() + planes,
+                     [](const bool ok) { return ok; });
+}
+
+// Where pointer i of the delta leads; null if zero, end if out of range.
+static const uint8_t *Pointer(const bytefield &delta, const size_t i) {
+  const auto offset = ReadLong(delta.data() + i * 4);
+  if (offset == 0) {
+    return nullptr;
+  }
+  return delta.data() + std::min<size_t>(offset, delta.size());
+}
+
+// One plane, column by column. Operations: 0 repeats the next byte count
+// times, a set top bit copies that many bytes (less the bit), anything else
+// skips that many rows.
+template <bool Xor>
+static const bool ByteVerticalPlane(const uint8_t *data, const uint8_t *end,
+                                    uint8_t *plane, const size_t row_bytes,
+                                    const uint32_t height, uint8_t *dirty) {
+  for (size_t column = 0; column < row_bytes; ++column) {
+    if (data == end) {
+      return false;
+    }
+    auto *out = plane + column;
+    uint32_t y = 0;
+    for (auto ops = *data++; ops > 0; --ops) {
+      if (data == end) {
+        return false;
+      }
+      const auto op = *data++;
+      if (op == 0) {
+        if (end - data < 2 || data[0] > height - y) {
+          return false;
+        }
+        for (auto count = data[0]; count > 0; --count, out += row_bytes) {
+          Put<1, Xor>(out, data + 1);
+          dirty[y++] = 1;
+        }
+        data += 2;
+      } else if (op & 0x80) {
+        const uint32_t count = op & 0x7f;
+        if (static_cast<size_t>(end - data) < count || count > height - y) {
+          return false;
+        }
+        for (uint32_t i = 0; i < count; ++i, out += row_bytes) {
+          Put<1, Xor>(out, data++);
+          dirty[y++] = 1;
+        }
+      } else {
+        if (op > height - y) {
+          return false;
+        }
+        y += op;
+        out += op * row_bytes;
+      }
+    }
+  }
+  return true;
+}
+
+const bool IFFReader::ApplyByteVerticalDelta(const bytefield &delta,
+                                             const bool xor_mode,
+                                             PlanarFrame &frame,
+                                             DirtyRows &dirty) {
+  if (delta.size() < DELTA_HEADER) {
+    return false;
+  }
+  const auto *end = delta.data() + delta.size();
+  return ForEachPlane(frame, dirty, [&](const uint16_t p, uint8_t *rows) {
+    const auto *data = Pointer(delta, p);
+    if (!data) {
+      return true;
+    }
+    auto *plane = frame.Plane(p);
+    return xor_mode ? ByteVerticalPlane<true>(data, end, plane,
+                                              frame.row_bytes, frame.height,
+                                              rows)
+                    : ByteVerticalPlane<false>(data, end, plane,
+                                               frame.row_bytes, frame.height,
+                                               rows);
+  });
+}
+
+// One column of an operation 7 plane. Operations are bytes, as in operation
+// 5, and values words taken in turn from the data list. Bytes is what is
+// written per row: the word, or the high half of a longword in the last
+// column of a frame that is not a whole number of longwords wide.
+template <typename Word, size_t Bytes, bool Xor>
+static const bool ShortLongVerticalColumn(const uint8_t *&ops,
+                                          const uint8_t *&data,
+                                          const uint8_t *end, uint8_t *out,
+                                          const size_t row_bytes,
+                                          const uint32_t height,
+                                          uint8_t *dirty) {
+  if (ops >= end) {
+    return false;
+  }
+  uint32_t y = 0;
+  for (auto count = *ops++; count > 0; --count) {
+    if (ops >= end) {
+      return false;
+    }
+    const auto op = *ops++;
+    if (op == 0) {
+      if (ops >= end || static_cast<size_t>(end - data) < sizeof(Word) ||
+          *ops > height - y) {
+        return false;
+      }
+      for (auto rows = *ops++; rows > 0; --rows, out += row_bytes) {
+        Put<Bytes, Xor>(out, data);
+        dirty[y++] = 1;
+      }
+      data += sizeof(Word);
+    } else if (op & 0x80) {
+      const uint32_t rows = op & 0x7f;
+      if (static_cast<size_t>(end - data) < rows * sizeof(Word) ||
+          rows > height - y) {
+        return false;
+      }
+      for (uint32_t i = 0; i < rows; ++i, out += row_bytes) {
+        Put<Bytes, Xor>(out, data);
+        data += sizeof(Word);
+        dirty[y++] = 1;
+      }
+    } else {
+      if (op > height - y) {
+        return false;
+      }
+      y += op;
+      out += op * row_bytes;
+    }
+  }
+  return true;
+}
+
+template <typename Word, bool Xor>
+static const bool ShortLongVerticalPlane(const uint8_t *ops,
+                                         const uint8_t *data,
+                                         const uint8_t *end, uint8_t *plane,
+                                         const size_t row_bytes,
+                                         const uint32_t height,
+                                         uint8_t *dirty) {
+  const auto columns = row_bytes / sizeof(Word);
+  for (size_t column = 0; column < columns; ++column) {
+    if (!ShortLongVerticalColumn<Word, sizeof(Word), Xor>(
+            ops, data, end, plane + column * sizeof(Word), row_bytes, height,
+            dirty)) {
+      return false;
+    }
+  }
+  if (row_bytes % sizeof(Word) != 0) {
+    return ShortLongVerticalColumn<Word, 2, Xor>(
+        ops, data, end, plane + columns * sizeof(Word), row_bytes, height,
+        dirty);
+  }
+  return true;
+}
+
+template <typename Word, bool Xor>
+static const bool ShortLongVertical(const bytefield &delta,
+                                    IFFReader::PlanarFrame &frame,
+                                    IFFReader::DirtyRows &dirty) {
+  const auto *end = delta.data() + delta.size();
+  return ForEachPlane(frame, dirty, [&](const uint16_t p, uint8_t *rows) {
+    const auto *ops = Pointer(delta, p);
+    const auto *data = Pointer(delta, p + PLANE_POINTERS);
+    if (!ops) {
+      return true;
+    }
+    return data && ShortLongVerticalPlane<Word, Xor>(
+                       ops, data, end, frame.Plane(p), frame.row_bytes,
+                       frame.height, rows);
+  });
+}
+
+const bool IFFReader::ApplyShortLongVerticalDelta(const bytefield &delta,
+                                                  const bool long_data,
+                                                  const bool xor_mode,
+                                                  PlanarFrame &frame,
+                                                  DirtyRows &dirty) {
+  if (delta.size() < DELTA_HEADER) {
+    return false;
+  }
+  if (long_data) {
+    return xor_mode ? ShortLongVertical<uint32_t, true>(delta, frame, dirty)
+                    : ShortLongVertical<uint32_t, false>(delta, frame, dirty);
+  }
+  return xor_mode ? ShortLongVertical<uint16_t, true>(delta, frame, dirty)
+                  : ShortLongVertical<uint16_t, false>(delta, frame, dirty);
+}
+
+// One column of an operation 8 plane: a count of operations, then the
+// operations, each a word, with their counts and values among them. A set
+// top bit copies, zero repeats, anything else skips.
+template <typename Word, size_t Bytes, bool Xor>
+static const bool VerticalWordColumn(const uint8_t *&data, const uint8_t *end,
+                                     uint8_t *out, const size_t row_bytes,
+                                     const uint32_t height, uint8_t *dirty) {
+  constexpr auto size = sizeof(Word);
+  constexpr auto copy = uint32_t(1) << (size * 8 - 1);
+  if (static_cast<size_t>(end - data) < size) {
+    return false;
+  }
+  uint32_t y = 0;
+  auto count = ReadWord<Word>(data);
+  for (data += size; count > 0; --count) {
+    if (static_cast<size_t>(end - data) < size) {
+      return false;
+    }
+    const auto op = ReadWord<Word>(data);
+    data += size;
+    if (op == 0) {
+      if (static_cast<size_t>(end - data) < 2 * size) {
+        return false;
+      }
+      const auto rows = ReadWord<Word>(data);
+      if (rows > height - y) {
+        return false;
+      }
+      for (uint32_t i = 0; i < rows; ++i, out += row_bytes) {
+        Put<Bytes, Xor>(out, data + size);
+        dirty[y++] = 1;
+      }
+      data += 2 * size;
+    } else if (op & copy) {
+      const auto rows = op & (copy - 1);
+      if (rows > height - y ||
+          static_cast<size_t>(end - data) / size < rows) {
+        return false;
+      }
+      for (uint32_t i = 0; i < rows; ++i, out += row_bytes) {
+        Put<Bytes, Xor>(out, data);
+        data += size;
+        dirty[y++] = 1;
+      }
+    } else {
+      if (op > height - y) {
+        return false;
+      }
+      y += op;
+      out += op * row_bytes;
+    }
+  }
+  return true;
+}
+
+template <typename Word, bool Xor>
+static const bool VerticalWord(const bytefield &delta,
+                               IFFReader::PlanarFrame &frame,
+                               IFFReader::DirtyRows &dirty) {
+  const auto *end = delta.data() + delta.size();
+  const auto columns = frame.row_bytes / sizeof(Word);
+  return ForEachPlane(frame, dirty, [&](const uint16_t p, uint8_t *rows) {
+    const auto *data = Pointer(delta, p);
+    if (!data) {
+      return true;
+    }
+    auto *plane = frame.Plane(p);
+    for (size_t column = 0; column < columns; ++column) {
+      if (!VerticalWordColumn<Word, sizeof(Word), Xor>(
+              data, end, plane + column * sizeof(Word), frame.row_bytes,
+              frame.height, rows)) {
+        return false;
+      }
+    }
+    if (frame.row_bytes % sizeof(Word) != 0) {
+      return VerticalWordColumn<Word, 2, Xor>(
+          data, end, plane + columns * sizeof(Word), frame.row_bytes,
+          frame.height, rows);
+    }
+    return true;
+  });
+}
+
+const bool IFFReader::ApplyVerticalWordDelta(const bytefield &delta,
+                                             const bool long_data,
+                                             const bool xor_mode,
+                                             PlanarFrame &frame,
+                                             DirtyRows &dirty) {
+  if (delta.size() < DELTA_HEADER) {
+    return false;
+  }
+  if (long_data) {
+    return xor_mode ? VerticalWord<uint32_t, true>(delta, frame, dirty)
+                    : VerticalWord<uint32_t, false>(delta, frame, dirty);
+  }
+  return xor_mode ? VerticalWord<uint16_t, true>(delta, frame, dirty)
+                  : VerticalWord<uint16_t, false>(delta, frame, dirty);
+}
+
+// Operation J offsets count bytes of rows as wide as the frame, in whole
+// bytes; frames narrower than a 320 pixel screen count 40-byte rows, with
+// the frame centred in them, as Sculpt-Animate's were.
+struct GrahamOffset {
+  uint32_t row;
+  size_t column;
+};
+
+static const bool ToGrahamOffset(const IFFReader::PlanarFrame &frame,
+                                 const uint32_t offset, GrahamOffset &out) {
+  constexpr uint32_t SCREEN_BYTES = 320 / 8;
+  if (frame.width < 320) {
+    const auto margin = (320 - frame.width) / 16;
+    if (offset % SCREEN_BYTES < margin) {
+      return false;
+    }
+    out.row = offset / SCREEN_BYTES;
+    out.column = offset % SCREEN_BYTES - margin;
+  } else {
+    const auto row_bytes = (frame.width + 7) / 8;
+    out.row = offset / row_bytes;
+    out.column = offset % row_bytes;
+  }
+  return out.row < frame.height && out.column < frame.row_bytes;
+}
+
+// Rows of a rectangle, every plane's bytes for a row in turn. Rectangles a
+// word or longword wide, the most common, are copied at a known width.
+template <size_t Bytes, bool Xor>
+static void GrahamRectangle(const uint8_t *&data, IFFReader::PlanarFrame &frame,
+                            const GrahamOffset &at, const uint32_t rows,
+                            const size_t width, uint8_t *dirty) {
+  for (uint32_t r = 0; r < rows; ++r) {
+    const auto offset = (at.row + r) * frame.row_bytes + at.column;
+    for (uint16_t p = 0; p < frame.planes; ++p) {
+      if constexpr (Bytes > 0) {
+        Put<Bytes, Xor>(frame.Plane(p) + offset, data);
+      } else {
+        for (size_t i = 0; i < width; ++i) {
+          Put<1, Xor>(frame.Plane(p) + offset + i, data + i);
+        }
+      }
+      data += width;
+    }
+    dirty[at.row + r] = 1;
+  }
+}
+
+template <bool Xor>
+static void GrahamRectangle(const uint8_t *&data, IFFReader::PlanarFrame &frame,
+                            const GrahamOffset &at, const uint32_t rows,
+                            const size_t width, uint8_t *dirty) {
+  switch (width) {
+  case 1:
+    return GrahamRectangle<1, Xor>(data, frame, at, rows, width, dirty);
+  case 2:
+    return GrahamRectangle<2, Xor>(data, frame, at, rows, width, dirty);
+  case 4:
+    return GrahamRectangle<4, Xor>(data, frame, at, rows, width, dirty);
+  default:
+    return GrahamRectangle<0, Xor>(data, frame, at, rows, width, dirty);
+  }
+}
+
+// Blocks are sequences of groups sharing a shape: type 1 is columns a byte
+// wide, type 2 rectangles. Groups start with their offset; a group's data
+// is padded to whole words. Type 0 ends the delta.
+const bool IFFReader::ApplyEricGrahamDelta(const bytefield &delta,
+                                           PlanarFrame &frame,
+                                           DirtyRows &dirty) {
+  dirty.resize(frame.height, 0);
+  const auto *data = delta.data();
+  const auto *end = data + delta.size();
+  const auto read = [&](uint32_t &value) {
+    if (end - data < 2) {
+      return false;
+    }
+    value = ReadWord<uint16_t>(data);
+    data += 2;
+    return true;
+  };
+
+  uint32_t type;
+  while (read(type) && type != 0) {
+    uint32_t xor_flag, rows, width = 1, groups;
+    if (type == 1) {
+      if (!read(xor_flag) || !read(rows) || !read(groups)) {
+        return false;
+      }
+    } else if (type == 2) {
+      if (!read(xor_flag) || !read(rows) || !read(width) || !read(groups)) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+
+    const size_t size = size_t(rows) * width * frame.planes;
+    for (uint32_t g = 0; g < groups; ++g) {
+      uint32_t offset;
+      GrahamOffset at;
+      if (!read(offset) || static_cast<size_t>(end - data) < size ||
+          !ToGrahamOffset(frame, offset, at) || rows > frame.height - at.row ||
+          width > frame.row_bytes - at.column) {
+        return false;
+      }
+      if (xor_flag) {
+        GrahamRectangle<true>(data, frame, at, rows, width, dirty.data());
+      } else {
+        GrahamRectangle<false>(data, frame, at, rows, width, dirty.data());
+      }
+      if (size % 2 != 0 && data < end) {
+        ++data;
+      }
+    }
+  }
+  return true;
+}
+
+const bool IFFReader::SupportsDeltaOperation(const uint8_t operation) {
+  switch (operation) {
+  case ANIM_OP_BYTE_VERTICAL:
+  case ANIM_OP_SHORT_LONG_VERTICAL:
+  case ANIM_OP_VERTICAL_WORD:
+  case ANIM_OP_ERIC_GRAHAM:
+    return true;
+  default:
+    return false;
+  }
+}
+
+const bool IFFReader::ApplyDelta(const ANHD &header, const bytefield &delta,
+                                 PlanarFrame &frame, DirtyRows &dirty) {
+  switch (header.Operation()) {
+  case ANIM_OP_BYTE_VERTICAL:
+    return ApplyByteVerticalDelta(delta, header.UsesXOR(), frame, dirty);
+  case ANIM_OP_SHORT_LONG_VERTICAL:
+    return ApplyShortLongVerticalDelta(delta, header.LongData(),
+                                       header.UsesXOR(), frame, dirty);
+  case ANIM_OP_VERTICAL_WORD:
+    return ApplyVerticalWordDelta(delta, header.LongData(), header.UsesXOR(),
+                                  frame, dirty);
+  case ANIM_OP_ERIC_GRAHAM:
+    return ApplyEricGrahamDelta(delta, frame, dirty);
+  default:
+    return false;
+  }
+}
+
+// Eight pixels a byte of a plane covers, its bits spread one to a byte,
+// leftmost first in memory whatever the byte order.
+static const array<uint64_t, 256> SPREAD = [] {
+  array<uint64_t, 256> table{};
+  for (uint32_t n = 0; n < 256; ++n) {
+    uint8_t bytes[8];
+    for (uint32_t k = 0; k < 8; ++k) {
+      bytes[k] = (n >> (7 - k)) & 1;
+    }
+    std::memcpy(&table[n], bytes, 8);
+  }
+  return table;
+}();
+
+// A row of planar bytes spread and shifted into place, eight pixels at once;
+// lanes never carry into each other with eight planes or fewer.
+static void PlanarRowToChunky(const IFFReader::PlanarFrame &frame,
+                              const uint32_t y, uint8_t *row) {
+  const auto planes = std::min<uint16_t>(frame.planes, 8);
+  const auto offset = y * frame.row_bytes;
+  for (uint32_t x = 0; x < frame.width; x += 8) {
+    uint64_t pixels = 0;
+    for (uint16_t p = 0; p < planes; ++p) {
+      pixels |= SPREAD[frame.Plane(p)[offset + x / 8]] << p;
+    }
+    std::memcpy(row + x, &pixels, std::min(8u, frame.width - x));
+  }
+}
+
+void IFFReader::PlanarRowsToChunky(const PlanarFrame &frame,
+                                   const vector<uint32_t> &rows,
+                                   uint8_t *chunky) {
+  ThreadPool::Shared().ParallelFor(
+      0, rows.size(), 16, [&](const size_t first, const size_t last) {
+        for (auto i = first; i < last; ++i) {
+          PlanarRowToChunky(frame, rows[i],
+                            chunky + size_t(rows[i]) * frame.width);
+        }
+      });
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "AnimationHeader.h"
+#include "utility.h"
+
+/*
+ * ANIM deltas change a frame in place, as the Amiga did to a bitmap in chip
+ * memory: planes are kept apart, each a column of rows whole words wide,
+ * and deltas are applied to them directly. Every plane's changes are found
+ * through a pointer of its own, so planes are decoded in parallel.
+ *
+ * Decoders mark the rows they touch, so that only those need converting to
+ * chunky pixels afterwards; a frame where little moves costs little.
+ *
+ * Operations 7 and 8 store words or longwords, as ANHD says. Their decoders
+ * are templates over the word size, so that every value is copied into the
+ * plane as one load and store of known size; the file's byte order is the
+ * planes' own, so nothing is swapped.
+ */
+namespace IFFReader {
+
+// ANHD operations the decoders below read.
+constexpr uint8_t ANIM_OP_BYTE_VERTICAL = 5;
+constexpr uint8_t ANIM_OP_SHORT_LONG_VERTICAL = 7;
+constexpr uint8_t ANIM_OP_VERTICAL_WORD = 8;
+constexpr uint8_t ANIM_OP_ERIC_GRAHAM = 'J';
+
+// Bitplanes of one frame, plane after plane; row y of plane p starts at
+// Plane(p) + y * row_bytes.
+struct PlanarFrame {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint16_t planes = 0;
+  size_t row_bytes = 0; // Whole words, as Amiga bitmaps.
+  bytefield bytes;
+
+  PlanarFrame() = default;
+  PlanarFrame(const uint32_t width, const uint32_t height,
+              const uint16_t planes);
+
+  uint8_t *Plane(const uint16_t p);
+  const uint8_t *Plane(const uint16_t p) const;
+  const size_t PlaneSize() const;
+};
+
+// Rows touched by a delta, a flag per row.
+using DirtyRows = vector<uint8_t>;
+
+// Applies an operation 5 (byte vertical) delta. Each plane's data is a
+// list of columns a byte wide; each column a count of operations that skip
+// rows, repeat one byte down several rows, or copy bytes down as many. With
+// xor set, bytes are XORed into the frame instead. Marks touched rows in
+// dirty (height flags). False if the delta is damaged; what came before
+// the damage is applied.
+const bool ApplyByteVerticalDelta(const bytefield &delta, const bool xor_mode,
+                                  PlanarFrame &frame, DirtyRows &dirty);
+
+// Applies an operation 7 delta: as operation 5, but columns are words (or
+// longwords, with long_data) wide, and every plane has two pointers, one to
+// its list of operations (bytes) and one to its list of data (words).
+const bool ApplyShortLongVerticalDelta(const bytefield &delta,
+                                       const bool long_data,
+                                       const bool xor_mode,
+                                       PlanarFrame &frame, DirtyRows &dirty);
+
+// Applies an operation 8 delta: as operation 7, but operations, counts and
+// data share one list per plane, all words (or longwords).
+const bool ApplyVerticalWordDelta(const bytefield &delta,
+                                  const bool long_data, const bool xor_mode,
+                                  PlanarFrame &frame, DirtyRows &dirty);
+
+// Applies an operation J (Eric Graham's) delta: blocks of changes, each
+// either columns a byte wide and some rows high, or rectangles some bytes
+// wide, across all planes at once. Each block says whether to XOR.
+const bool ApplyEricGrahamDelta(const bytefield &delta, PlanarFrame &frame,
+                                DirtyRows &dirty);
+
+// Whether frames encoded with the operation can be decoded.
+const bool SupportsDeltaOperation(const uint8_t operation);
+
+// Applies a frame's delta the way its header says. False if damaged or of
+// an operation not supported.
+const bool ApplyDelta(const ANHD &header, const bytefield &delta,
+                      PlanarFrame &frame, DirtyRows &dirty);
+
+// Converts the given rows of the frame to chunky indices, width per row.
+void PlanarRowsToChunky(const PlanarFrame &frame,
+                        const vector<uint32_t> &rows, uint8_t *chunky);
+} // namespace IFFReader
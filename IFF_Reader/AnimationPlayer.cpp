@@ -0,0 +1,113 @@
+#include "AnimationPlayer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+IFFReader::AnimationPlayer::AnimationPlayer(shared_ptr<ANIM> anim,
+                                            const size_t first,
+                                            const size_t ring_size)
+    : anim_(std::move(anim)), ring_(std::max<size_t>(ring_size, 2)),
+      seeking_(true), seek_to_(first) {
+  producer_ = std::thread([this] { Produce(); });
+}
+
+IFFReader::AnimationPlayer::~AnimationPlayer() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  room_.notify_all();
+  producer_.join();
+}
+
+// The animation is stepped and resolved outside the lock. The slot being
+// decoded into lies past the frames ready, where Pop never looks.
+void IFFReader::AnimationPlayer::Produce() {
+  const auto image = anim_->Image();
+  const auto width = image ? image->width() : 0;
+  const auto height = image ? image->height() : 0;
+
+  for (;;) {
+    size_t slot;
+    uint64_t generation;
+    bool seek;
+    size_t seek_to;
+    {
+      unique_lock<mutex> lock(mutex_);
+      room_.wait(lock, [this] {
+        return stopping_ || seeking_ || count_ < ring_.size();
+      });
+      if (stopping_ || !image) {
+        return;
+      }
+      seek = seeking_;
+      seek_to = std::min(seek_to_, anim_->FrameCount() - 1);
+      seeking_ = false;
+      slot = (head_ + count_) % ring_.size();
+      generation = generation_;
+    }
+
+    const auto valid = seek ? anim_->Seek(seek_to) : anim_->NextFrame();
+
+    auto &out = ring_[slot];
+    out.frame = anim_->CurrentFrame();
+    out.jiffies = anim_->DisplayJiffies(out.frame);
+    out.pixels.resize(static_cast<size_t>(width) * height);
+    ThreadPool::Shared().ParallelFor(
+        0, height, 32, [&](const size_t first, const size_t last) {
+          image->ResolveRows(static_cast<uint32_t>(first),
+                             static_cast<uint32_t>(last),
+                             out.pixels.data() + first * width, width);
+        });
+
+    lock_guard<mutex> lock(mutex_);
+    damaged_ += valid ? 0 : 1;
+    if (generation == generation_) {
+      ++count_;
+    }
+  }
+}
+
+shared_ptr<const IFFReader::ANIM>
+IFFReader::AnimationPlayer::Animation() const {
+  return anim_;
+}
+
+const bool IFFReader::AnimationPlayer::Pop(ResolvedFrame &frame) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (count_ == 0) {
+      return false;
+    }
+    std::swap(frame, ring_[head_]);
+    head_ = (head_ + 1) % ring_.size();
+    --count_;
+  }
+  room_.notify_one();
+  return true;
+}
+
+void IFFReader::AnimationPlayer::Seek(const size_t n) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    count_ = 0;
+    ++generation_;
+    seeking_ = true;
+    seek_to_ = n;
+  }
+  room_.notify_one();
+}
+
+const size_t IFFReader::AnimationPlayer::Ready() const {
+  lock_guard<mutex> lock(mutex_);
+  return count_;
+}
+
+const size_t IFFReader::AnimationPlayer::Damaged() const {
+  lock_guard<mutex> lock(mutex_);
+  return damaged_;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "FileData.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/*
+ * Playing an animation as a producer and a consumer. A thread of the
+ * player's own steps through the frames ahead of time and resolves each to
+ * colors, bands of rows spread over the thread pool, into a ring of a fixed
+ * number of framebuffers. The viewer takes them from the ring as their time
+ * comes, so a frame whose delta is costly to play is absorbed by the frames
+ * decoded ahead of it rather than showing up as a stutter.
+ *
+ * The player has the animation to itself while it lives: nothing else may
+ * step it, or read its image's indices or colors.
+ */
+namespace IFFReader {
+
+// A frame resolved to colors (0xAABBGGRR), width pixels per row.
+struct ResolvedFrame {
+  size_t frame = 0;     // Number within the animation.
+  uint32_t jiffies = 0; // Time it stays up, in 1/60 s.
+  vector<uint32_t> pixels;
+};
+
+class AnimationPlayer {
+  shared_ptr<ANIM> anim_;
+  vector<ResolvedFrame> ring_;
+
+  size_t head_ = 0;  // Slot of the next frame to show.
+  size_t count_ = 0; // Frames decoded ahead, from head_ on.
+
+  // Seeks drop the frames decoded ahead; a frame decoded while one was
+  // asked for belongs to an older generation and is dropped as well.
+  uint64_t generation_ = 0;
+  bool seeking_ = false;
+  size_t seek_to_ = 0;
+
+  size_t damaged_ = 0;
+  bool stopping_ = false;
+  mutable std::mutex mutex_;
+  std::condition_variable room_;
+  std::thread producer_;
+
+  // Decodes frames into the ring until stopped.
+  void Produce();
+
+public:
+  // Starts decoding at frame first, ring_size frames ahead at most.
+  AnimationPlayer(shared_ptr<ANIM> anim, const size_t first = 0,
+                  const size_t ring_size = 8);
+
+  // Stops the producer, waiting for the frame it is on.
+  ~AnimationPlayer();
+
+  AnimationPlayer(const AnimationPlayer &) = delete;
+  AnimationPlayer &operator=(const AnimationPlayer &) = delete;
+
+  shared_ptr<const ANIM> Animation() const;
+
+  // Swaps the next frame into frame, without waiting. False if it is not
+  // decoded yet. The ring keeps frame's old pixels, to decode into later.
+  const bool Pop(ResolvedFrame &frame);
+
+  // Drops the frames decoded ahead; the next frame popped is frame n, then
+  // those after it. Frames past the last are taken as the last.
+  void Seek(const size_t n);
+
+  // Frames decoded ahead and not popped yet.
+  const size_t Ready() const;
+
+  // Frames whose delta was damaged or could not be decoded.
+  const size_t Damaged() const;
+};
+} // namespace IFFReader
@@ -0,0 +1,294 @@
+#include "AspectScaler.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+
+using std::map;
+using std::pair;
+using std::unique_ptr;
+
+constexpr int32_t WEIGHT_ONE = 1 << 14;
+
+// Pixel aspects of PAL and NTSC lores, hires and interlaced modes, as
+// source:destination lengths along the stretched axis.
+constexpr pair<uint32_t, uint32_t> COMMON_ASPECTS[] = {
+    {10, 11}, {5, 11}, {11, 20}, {11, 13}, {11, 26}, {13, 22}};
+
+// Catmull-Rom weights for a sampling position f past the second tap,
+// rounded so that they add up to exactly WEIGHT_ONE.
+static const array<int16_t, 4> CubicWeights(const double f) {
+  const double f2 = f * f;
+  const double f3 = f2 * f;
+  const double w[4] = {(-f3 + 2 * f2 - f) / 2, (3 * f3 - 5 * f2 + 2) / 2,
+                       (-3 * f3 + 4 * f2 + f) / 2, (f3 - f2) / 2};
+
+  array<int16_t, 4> weights;
+  int32_t sum = 0;
+  for (int k = 0; k < 4; ++k) {
+    weights[k] = static_cast<int16_t>(std::lround(w[k] * WEIGHT_ONE));
+    sum += weights[k];
+  }
+
+  const auto largest = f < 0.5 ? 1 : 2;
+  weights[largest] = static_cast<int16_t>(weights[largest] + WEIGHT_ONE - sum);
+  return weights;
+}
+
+static unique_ptr<IFFReader::PolyphaseTable> BuildTable(const uint32_t in,
+                                                        const uint32_t out) {
+  auto table = std::make_unique<IFFReader::PolyphaseTable>();
+  table->in = in;
+  table->out = out;
+  for (uint32_t phase = 0; phase < 2 * out; ++phase) {
+    table->phases.push_back(
+        CubicWeights(static_cast<double>(phase) / (2.0 * out)));
+  }
+  return table;
+}
+
+const IFFReader::PolyphaseTable &
+IFFReader::GetPolyphaseTable(const uint32_t in, const uint32_t out) {
+  static std::mutex mutex;
+  static map<pair<uint32_t, uint32_t>, unique_ptr<PolyphaseTable>> tables;
+
+  const auto divisor = std::gcd(in, out);
+  const auto key = pair<uint32_t, uint32_t>(in / divisor, out / divisor);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (tables.empty()) {
+    for (const auto &[common_in, common_out] : COMMON_ASPECTS) {
+      tables[{common_in, common_out}] = BuildTable(common_in, common_out);
+    }
+  }
+
+  auto &table = tables[key];
+  if (!table) {
+    table = BuildTable(key.first, key.second);
+  }
+  return *table;
+}
+
+// Division rounding towards minus infinity.
+static const int64_t FloorDiv(const int64_t a, const int64_t b) {
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+IFFReader::AspectScaler::AspectScaler(const uint32_t width,
+                                      const uint32_t height,
+                                      const uint32_t x_aspect,
+                                      const uint32_t y_aspect,
+                                      const ScaleFilter filter)
+    : source_width_(width), source_height_(height), width_(width),
+      height_(height), filter_(filter), horizontal_(false) {
+  if (x_aspect == 0 || y_aspect == 0 || x_aspect == y_aspect) {
+    return;
+  }
+
+  // Wide pixels stretch the width, tall pixels the height.
+  horizontal_ = x_aspect > y_aspect;
+  const auto in = horizontal_ ? y_aspect : x_aspect;
+  const auto out = horizontal_ ? x_aspect : y_aspect;
+  const auto length = horizontal_ ? width : height;
+  const auto scaled = static_cast<uint32_t>(
+      (static_cast<uint64_t>(length) * out + in / 2) / in);
+  (horizontal_ ? width_ : height_) = scaled;
+
+  const auto &table = GetPolyphaseTable(in, out);
+  const int64_t tin = table.in;
+  const int64_t tout = table.out;
+
+  for (uint32_t o = 0; o < scaled; ++o) {
+    const auto t = (2 * int64_t(o) + 1) * tin - tout;
+    const auto base = FloorDiv(t, 2 * tout);
+    const auto phase = static_cast<size_t>(t - base * 2 * tout);
+
+    first_tap_.push_back(static_cast<int32_t>(base - 1));
+    weights_.push_back(table.phases[phase]);
+    nearest_.push_back(std::min<uint32_t>(
+        static_cast<uint32_t>(((2 * int64_t(o) + 1) * tin) / (2 * tout)),
+        length - 1));
+  }
+}
+
+const uint32_t IFFReader::AspectScaler::Width() const { return width_; }
+
+const uint32_t IFFReader::AspectScaler::Height() const { return height_; }
+
+const bool IFFReader::AspectScaler::Scales() const {
+  return width_ != source_width_ || height_ != source_height_;
+}
+
+// Weighted sum of four pixels, channel by channel, clamped to a byte.
+static const uint32_t Blend(const uint32_t p[4], const array<int16_t, 4> &w) {
+  uint32_t pixel = 0;
+  for (int c = 0; c < 32; c += 8) {
+    int32_t sum = WEIGHT_ONE / 2;
+    for (int k = 0; k < 4; ++k) {
+      sum += w[k] * static_cast<int32_t>((p[k] >> c) & 0xff);
+    }
+    pixel |= static_cast<uint32_t>(std::clamp(sum >> 14, 0, 255)) << c;
+  }
+  return pixel;
+}
+
+#if IFF_SIMD_X86
+// Pairs of pixels are interleaved channel by channel, so that one multiply-
+// add applies two weights at once.
+IFF_TARGET_SSE2 static const __m128i BlendPairs(const __m128i ab,
+                                                const __m128i cd,
+                                                const __m128i w01,
+                                                const __m128i w23) {
+  const auto sum = _mm_add_epi32(
+      _mm_add_epi32(_mm_madd_epi16(ab, w01), _mm_madd_epi16(cd, w23)),
+      _mm_set1_epi32(WEIGHT_ONE / 2));
+  return _mm_srai_epi32(sum, 14);
+}
+
+IFF_TARGET_SSE2 static const uint32_t Blend_SSE2(const uint32_t p[4],
+                                                 const __m128i w01,
+                                                 const __m128i w23) {
+  const auto zero = _mm_setzero_si128();
+  const auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+  const auto lo = _mm_unpacklo_epi8(pixels, zero);
+  const auto hi = _mm_unpackhi_epi8(pixels, zero);
+  const auto ab = _mm_unpacklo_epi16(lo, _mm_srli_si128(lo, 8));
+  const auto cd = _mm_unpacklo_epi16(hi, _mm_srli_si128(hi, 8));
+
+  const auto sum = BlendPairs(ab, cd, w01, w23);
+  const auto packed = _mm_packus_epi16(_mm_packs_epi32(sum, sum), zero);
+  return static_cast<uint32_t>(_mm_cvtsi128_si32(packed));
+}
+
+// Four rows blended, four pixels at a time. Returns pixels done.
+IFF_TARGET_SSE2 static const size_t
+BlendRows_SSE2(const uint32_t *const rows[4], const size_t count,
+               const __m128i w01, const __m128i w23, uint32_t *destination) {
+  const auto zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i bytes[4];
+    for (int k = 0; k < 4; ++k) {
+      bytes[k] =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k] + i));
+    }
+
+    __m128i pixels[4];
+    for (int half = 0; half < 2; ++half) {
+      const auto a = half ? _mm_unpackhi_epi8(bytes[0], zero)
+                          : _mm_unpacklo_epi8(bytes[0], zero);
+      const auto b = half ? _mm_unpackhi_epi8(bytes[1], zero)
+                          : _mm_unpacklo_epi8(bytes[1], zero);
+      const auto c = half ? _mm_unpackhi_epi8(bytes[2], zero)
+                          : _mm_unpacklo_epi8(bytes[2], zero);
+      const auto d = half ? _mm_unpackhi_epi8(bytes[3], zero)
+                          : _mm_unpacklo_epi8(bytes[3], zero);
+      pixels[half * 2] = BlendPairs(_mm_unpacklo_epi16(a, b),
+                                    _mm_unpacklo_epi16(c, d), w01, w23);
+      pixels[half * 2 + 1] = BlendPairs(_mm_unpackhi_epi16(a, b),
+                                        _mm_unpackhi_epi16(c, d), w01, w23);
+    }
+
+    const auto packed =
+        _mm_packus_epi16(_mm_packs_epi32(pixels[0], pixels[1]),
+                         _mm_packs_epi32(pixels[2], pixels[3]));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i), packed);
+  }
+  return i;
+}
+
+// Weights k and k + 1, repeated for each channel.
+IFF_TARGET_SSE2 static const __m128i WeightPair(const array<int16_t, 4> &w,
+                                                const int k) {
+  return _mm_set1_epi32(static_cast<int32_t>(
+      (static_cast<uint32_t>(static_cast<uint16_t>(w[k + 1])) << 16) |
+      static_cast<uint16_t>(w[k])));
+}
+#endif
+
+// Stretches one row horizontally. Taps past either edge repeat the edge
+// pixel.
+void IFFReader::AspectScaler::ScaleRow(const uint32_t *source,
+                                       uint32_t *destination) const {
+  if (filter_ == ScaleFilter::Nearest) {
+    for (uint32_t x = 0; x < width_; ++x) {
+      destination[x] = source[nearest_[x]];
+    }
+    return;
+  }
+
+  const auto last = static_cast<int32_t>(source_width_) - 1;
+#if IFF_SIMD_X86
+  const bool vector = DetectSimdLevel() != SimdLevel::Scalar;
+#endif
+
+  for (uint32_t x = 0; x < width_; ++x) {
+    uint32_t taps[4];
+    for (int k = 0; k < 4; ++k) {
+      taps[k] = source[std::clamp(first_tap_[x] + k, 0, last)];
+    }
+
+#if IFF_SIMD_X86
+    if (vector) {
+      destination[x] = Blend_SSE2(taps, WeightPair(weights_[x], 0),
+                                  WeightPair(weights_[x], 2));
+      continue;
+    }
+#endif
+    destination[x] = Blend(taps, weights_[x]);
+  }
+}
+
+// Blends four whole rows into one.
+void IFFReader::AspectScaler::ScaleColumn(const uint32_t *const rows[4],
+                                          const array<int16_t, 4> &w,
+                                          uint32_t *destination) const {
+  size_t done = 0;
+#if IFF_SIMD_X86
+  if (DetectSimdLevel() != SimdLevel::Scalar) {
+    done = BlendRows_SSE2(rows, width_, WeightPair(w, 0), WeightPair(w, 2),
+                          destination);
+  }
+#endif
+
+  for (auto x = done; x < width_; ++x) {
+    const uint32_t taps[4] = {rows[0][x], rows[1][x], rows[2][x], rows[3][x]};
+    destination[x] = Blend(taps, w);
+  }
+}
+
+void IFFReader::AspectScaler::Scale(const uint32_t *source,
+                                    const size_t source_stride,
+                                    uint32_t *destination,
+                                    const size_t destination_stride) const {
+  const auto last = static_cast<int32_t>(source_height_) - 1;
+
+  ThreadPool::Shared().ParallelFor(
+      0, height_, 32, [&](const size_t first, const size_t end) {
+        for (auto y = first; y < end; ++y) {
+          auto *out = destination + y * destination_stride;
+
+          if (!Scales()) {
+            std::memcpy(out, source + y * source_stride, width_ * 4);
+          } else if (horizontal_) {
+            ScaleRow(source + y * source_stride, out);
+          } else if (filter_ == ScaleFilter::Nearest) {
+            std::memcpy(out, source + nearest_[y] * source_stride,
+                        width_ * 4);
+          } else {
+            const uint32_t *rows[4];
+            for (int k = 0; k < 4; ++k) {
+              rows[k] = source + std::clamp(first_tap_[y] + k, 0, last) *
+                                     source_stride;
+            }
+            ScaleColumn(rows, weights_[y], out);
+          }
+        }
+      });
+}
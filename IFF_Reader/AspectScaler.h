@@ -0,0 +1,82 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using std::array;
+using std::vector;
+
+/*
+ * Amiga pixels are rarely square. A PAL lores pixel is a little taller than
+ * wide (10:11), a hires pixel about half as wide as tall (5:11), and an
+ * interlaced lores one wider than tall (20:11). BMHD records the ratio;
+ * shown one to one on a modern screen, such images come out squashed.
+ *
+ * The scaler stretches one axis, never shrinking the other, so that pixels
+ * come out square. The scale factor is a ratio of small integers, so the
+ * filter's sampling positions repeat: a polyphase table holds the weights
+ * for each distinct position once, and is shared by every image with the
+ * same aspect. Tables for the common Amiga aspects are built up front.
+ */
+namespace IFFReader {
+
+enum class ScaleFilter {
+  Nearest, // Repeats pixels; keeps hard edges, and is fastest.
+  Cubic    // Catmull-Rom; smooth, slightly sharper than linear.
+};
+
+// Weights of the four source pixels around each sampling position, in
+// 1/16384ths. Output o samples source position
+//   ((2o + 1) * in - out) / (2 * out),
+// whose fraction, in steps of 1 / (2 * out), selects the phase.
+struct PolyphaseTable {
+  uint32_t in = 1;
+  uint32_t out = 1;
+  vector<array<int16_t, 4>> phases;
+};
+
+// Table for scaling in pixels to out pixels (reduced). Built on first use,
+// then shared; safe to call from any thread.
+const PolyphaseTable &GetPolyphaseTable(const uint32_t in, const uint32_t out);
+
+class AspectScaler {
+  uint32_t source_width_;
+  uint32_t source_height_;
+  uint32_t width_;
+  uint32_t height_;
+  ScaleFilter filter_;
+
+  // Per output column or row: first of the four source taps, and weights.
+  // Only the stretched axis has any.
+  vector<int32_t> first_tap_;
+  vector<array<int16_t, 4>> weights_;
+  bool horizontal_;
+
+  // Nearest source index of each output column or row.
+  vector<uint32_t> nearest_;
+
+  void ScaleRow(const uint32_t *source, uint32_t *destination) const;
+  void ScaleColumn(const uint32_t *const rows[4], const array<int16_t, 4> &w,
+                   uint32_t *destination) const;
+
+public:
+  // Pixel aspect x:y is the width of a pixel relative to its height. Zero
+  // in either means unknown, and is treated as square.
+  AspectScaler(const uint32_t width, const uint32_t height,
+               const uint32_t x_aspect, const uint32_t y_aspect,
+               const ScaleFilter filter = ScaleFilter::Cubic);
+
+  // Size after correction.
+  const uint32_t Width() const;
+  const uint32_t Height() const;
+
+  // Whether the image needs scaling at all.
+  const bool Scales() const;
+
+  // Scales a whole image, rows spread over the thread pool. Strides are in
+  // pixels.
+  void Scale(const uint32_t *source, const size_t source_stride,
+             uint32_t *destination, const size_t destination_stride) const;
+};
+} // namespace IFFReader
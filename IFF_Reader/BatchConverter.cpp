@@ -0,0 +1,332 @@
+#include "BatchConverter.h"
+#include "FileData.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+using std::unique_ptr;
+using IFFReader::ConvertStage;
+
+constexpr double MEGABYTE = 1 << 20;
+
+static const char *STAGE_NAMES[IFFReader::CONVERT_STAGES] = {
+    "read", "decode", "resolve", "encode", "write"};
+
+// An image on its way through the pipeline. Each stage frees what the
+// stages after it no longer need.
+struct Job {
+  fs::path source;
+  fs::path target;
+  bytefield contents;
+  shared_ptr<IFFReader::ILBM> image;
+  IFFReader::ResolvedImage resolved;
+  bool is_resolved = false;
+  bytefield encoded;
+};
+
+using JobQueue = IFFReader::BoundedQueue<unique_ptr<Job>>;
+
+// Whatever the stages share while a tree is converted.
+struct Pipeline {
+  const IFFReader::ConvertSettings &settings;
+  const IFFReader::ConvertFailure &report;
+  std::mutex report_lock;
+
+  std::atomic<size_t> images{0};
+  std::atomic<size_t> failed{0};
+  std::atomic<uint64_t> bytes_read{0};
+  std::atomic<uint64_t> bytes_written{0};
+  std::atomic<uint64_t> pixels{0};
+  std::array<std::atomic<uint64_t>, IFFReader::CONVERT_STAGES> nanoseconds{};
+
+  Pipeline(const IFFReader::ConvertSettings &settings,
+           const IFFReader::ConvertFailure &report)
+      : settings(settings), report(report) {}
+
+  void Fail(const Job &job, const string &reason) {
+    ++failed;
+    if (report) {
+      std::lock_guard<std::mutex> lock(report_lock);
+      report(job.source, reason);
+    }
+  }
+};
+
+// Passes a job on if it should go further; failed jobs are reported by
+// the stage itself.
+using StageBody = std::function<bool(Job &job)>;
+
+// Starts count threads taking jobs from in and handing those the body lets
+// through on to out. The last of them to finish closes out, so that the
+// next stage ends once it has drained it.
+static void StartStage(vector<std::thread> &threads, const size_t count,
+                       Pipeline &pipeline, const ConvertStage stage,
+                       JobQueue &in, JobQueue *out, const StageBody &body) {
+  const auto running =
+      std::make_shared<std::atomic<size_t>>(std::max<size_t>(count, 1));
+  auto &nanoseconds = pipeline.nanoseconds[static_cast<size_t>(stage)];
+
+  for (size_t i = 0; i < *running; ++i) {
+    threads.emplace_back([&pipeline, &in, out, body, running, &nanoseconds] {
+      unique_ptr<Job> job;
+      while (in.Pop(job)) {
+        const auto start = std::chrono::steady_clock::now();
+        auto pass = false;
+        try {
+          pass = body(*job);
+        } catch (const std::exception &error) {
+          pipeline.Fail(*job, error.what());
+        }
+        nanoseconds += static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count());
+
+        if (pass && out) {
+          out->Push(std::move(job));
+        }
+        job.reset();
+      }
+
+      if (--*running == 0 && out) {
+        out->Close();
+      }
+    });
+  }
+}
+
+static const bool ReadContents(Pipeline &pipeline, Job &job) {
+  std::ifstream stream(job.source, std::ios::binary | std::ios::ate);
+  if (!stream.is_open()) {
+    pipeline.Fail(job, "could not be opened");
+    return false;
+  }
+
+  job.contents.resize(static_cast<size_t>(stream.tellg()));
+  stream.seekg(0);
+  stream.read(reinterpret_cast<char *>(job.contents.data()),
+              static_cast<std::streamsize>(job.contents.size()));
+  if (!stream) {
+    pipeline.Fail(job, "could not be read");
+    return false;
+  }
+
+  pipeline.bytes_read += job.contents.size();
+  return true;
+}
+
+static const bool Decode(Pipeline &pipeline, Job &job) {
+  const IFFReader::File file(job.source.string(), job.contents);
+  bytefield().swap(job.contents);
+
+  job.image = file.AsILBM();
+  if (!job.image) {
+    pipeline.Fail(job, "not a readable IFF ILBM");
+    return false;
+  }
+
+  pipeline.pixels +=
+      static_cast<uint64_t>(job.image->width()) * job.image->height();
+  return true;
+}
+
+// Only images made square are resolved whole, to be scaled. The rest are
+// resolved row by row as they are encoded (see ImageExport.h), and pass
+// through untouched.
+static const bool Resolve(Pipeline &pipeline, Job &job) {
+  const auto &settings = pipeline.settings;
+  if (!settings.correct_aspect ||
+      !job.image->AspectCorrection(IFFReader::ScaleFilter::Cubic).Scales()) {
+    return true;
+  }
+
+  job.resolved = IFFReader::ResolveImage(*job.image, true);
+  job.is_resolved = true;
+  job.image.reset();
+  return true;
+}
+
+static const bool Encode(Pipeline &pipeline, Job &job) {
+  const auto &settings = pipeline.settings;
+  if (job.is_resolved) {
+    job.encoded = IFFReader::EncodeImage(job.resolved, settings.format);
+    vector<uint32_t>().swap(job.resolved.pixels);
+  } else {
+    job.encoded = IFFReader::EncodeImage(*job.image, settings.format,
+                                         settings.correct_aspect);
+    job.image.reset();
+  }
+  return true;
+}
+
+static const bool Write(Pipeline &pipeline, Job &job) {
+  std::error_code error;
+  fs::create_directories(job.target.parent_path(), error);
+
+  if (!IFFReader::WriteBytes(job.target, job.encoded)) {
+    pipeline.Fail(job, "could not write " + job.target.string());
+    return false;
+  }
+
+  pipeline.bytes_written += job.encoded.size();
+  ++pipeline.images;
+  return true;
+}
+
+// Targets as compared for collisions: case is ignored, as Windows does.
+static const string TargetKey(const fs::path &target) {
+  auto key = target.lexically_normal().generic_string();
+  std::transform(key.begin(), key.end(), key.begin(), [](const char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  });
+  return key;
+}
+
+// Queues a job for every file, in the order they are found. Waits whenever
+// the readers are behind.
+//
+// Sources differing only in extension (a.iff, a.lbm) would share a target;
+// later ones keep their source extension in the name (a.lbm.png), or failing
+// that get a number (a_2.png). An output folder inside the input tree is
+// not walked, nor are files the conversion itself writes, so that its
+// results are never converted again.
+static void QueueFiles(const fs::path &input, const fs::path &output,
+                       const IFFReader::ConvertSettings &settings,
+                       JobQueue &queue) {
+  const auto extension = settings.extension.empty()
+                             ? IFFReader::ExportExtension(settings.format)
+                             : settings.extension;
+  std::unordered_set<string> targets;
+  const auto add = [&](const fs::path &source, const fs::path &relative) {
+    auto target = output / relative;
+    target.replace_extension(extension);
+    if (targets.count(TargetKey(target)) != 0) {
+      target = output / relative;
+      target += extension;
+    }
+    const auto stem = (output / relative).replace_extension().string();
+    for (size_t n = 2; targets.count(TargetKey(target)) != 0; ++n) {
+      target = stem + "_" + std::to_string(n) + extension;
+    }
+    targets.insert(TargetKey(target));
+
+    auto job = std::make_unique<Job>();
+    job->source = source;
+    job->target = target;
+    queue.Push(std::move(job));
+  };
+
+  std::error_code error;
+  if (fs::is_regular_file(input, error)) {
+    add(input, input.filename());
+    return;
+  }
+
+  std::error_code output_error;
+  const auto skipped = fs::weakly_canonical(output, output_error);
+  for (fs::recursive_directory_iterator
+           entry(input, fs::directory_options::skip_permission_denied, error),
+       end;
+       !error && entry != end; entry.increment(error)) {
+    std::error_code entry_error;
+    if (entry->is_directory(entry_error)) {
+      if (fs::weakly_canonical(entry->path(), entry_error) == skipped) {
+        entry.disable_recursion_pending();
+      }
+      continue;
+    }
+
+    const auto relative = entry->path().lexically_relative(input);
+    if (entry->is_regular_file(entry_error) &&
+        targets.count(TargetKey(output / relative)) == 0) {
+      add(entry->path(), relative);
+    }
+  }
+}
+
+const IFFReader::ConvertStats
+IFFReader::ConvertTree(const fs::path &input, const fs::path &output,
+                       const ConvertSettings &settings,
+                       const ConvertFailure &failed) {
+  const auto start = std::chrono::steady_clock::now();
+  Pipeline pipeline(settings, failed);
+
+  const auto length = settings.queue_length;
+  JobQueue files(length), read(length), decoded(length), resolved(length),
+      encoded(length);
+
+  const auto stage = [&pipeline](const auto step) -> StageBody {
+    return [&pipeline, step](Job &job) { return step(pipeline, job); };
+  };
+
+  vector<std::thread> threads;
+  StartStage(threads, settings.io_threads, pipeline, ConvertStage::Read, files,
+             &read, stage(ReadContents));
+  StartStage(threads, settings.threads, pipeline, ConvertStage::Decode, read,
+             &decoded, stage(Decode));
+  StartStage(threads, settings.threads, pipeline, ConvertStage::Resolve,
+             decoded, &resolved, stage(Resolve));
+  StartStage(threads, settings.threads, pipeline, ConvertStage::Encode,
+             resolved, &encoded, stage(Encode));
+  StartStage(threads, settings.io_threads, pipeline, ConvertStage::Write,
+             encoded, nullptr, stage(Write));
+
+  QueueFiles(input, output, settings, files);
+  files.Close();
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  ConvertStats stats;
+  stats.images = pipeline.images;
+  stats.failed = pipeline.failed;
+  stats.bytes_read = pipeline.bytes_read;
+  stats.bytes_written = pipeline.bytes_written;
+  stats.pixels = pipeline.pixels;
+  stats.seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+  for (size_t i = 0; i < CONVERT_STAGES; ++i) {
+    stats.stage_seconds[i] = pipeline.nanoseconds[i] / 1e9;
+  }
+  return stats;
+}
+
+const double IFFReader::ConvertStats::ImagesPerSecond() const {
+  return seconds > 0 ? images / seconds : 0;
+}
+
+const double IFFReader::ConvertStats::MegabytesReadPerSecond() const {
+  return seconds > 0 ? bytes_read / MEGABYTE / seconds : 0;
+}
+
+const double IFFReader::ConvertStats::MegabytesWrittenPerSecond() const {
+  return seconds > 0 ? bytes_written / MEGABYTE / seconds : 0;
+}
+
+const string IFFReader::FormatConvertStats(const ConvertStats &stats) {
+  std::ostringstream text;
+  text << std::fixed << std::setprecision(2);
+  text << "Converted " << stats.images << " images (" << stats.failed
+       << " failed) in " << stats.seconds << " s.\n";
+  text << stats.ImagesPerSecond() << " images/s, "
+       << stats.MegabytesReadPerSecond() << " MB/s read, "
+       << stats.MegabytesWrittenPerSecond() << " MB/s written, "
+       << (stats.seconds > 0 ? stats.pixels / 1e6 / stats.seconds : 0)
+       << " Mpixels/s.\n";
+
+  text << "Time in stages (all threads):";
+  for (size_t i = 0; i < CONVERT_STAGES; ++i) {
+    text << (i > 0 ? ", " : " ") << STAGE_NAMES[i] << " "
+         << stats.stage_seconds[i] << " s";
+  }
+  text << ".\n";
+  return text.str();
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include "ImageExport.h"
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+/*
+ * Converting whole folder trees, as a pipeline of five stages: read,
+ * decode, resolve, encode and write. Every stage has threads of its own and
+ * hands images on through a queue of bounded length. A stage that gets
+ * ahead of the next one waits for room, so memory use is set by the queue
+ * lengths, not by the number of files, and slow disks hold up the encoders
+ * (and the other way round) only as far as the queues allow.
+ *
+ * Bands within an image are spread over the shared thread pool as usual, so
+ * a few images in flight per stage are enough to keep every core busy.
+ */
+namespace IFFReader {
+
+// Queue between two stages. Push waits while the queue is full, Pop while
+// it is empty; once it is closed and empty, Pop returns false.
+template <typename T> class BoundedQueue {
+  std::deque<T> items_;
+  size_t capacity_;
+  bool closed_ = false;
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+
+public:
+  explicit BoundedQueue(const size_t capacity)
+      : capacity_(capacity > 0 ? capacity : 1) {}
+
+  void Push(T item) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_full_.wait(lock, [this] { return items_.size() < capacity_; });
+      items_.push_back(std::move(item));
+    }
+    not_empty_.notify_one();
+  }
+
+  const bool Pop(T &item) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+      if (items_.empty()) {
+        return false;
+      }
+      item = std::move(items_.front());
+      items_.pop_front();
+    }
+    not_full_.notify_one();
+    return true;
+  }
+
+  // No more items will be pushed.
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    not_empty_.notify_all();
+  }
+};
+
+enum class ConvertStage { Read, Decode, Resolve, Encode, Write };
+constexpr size_t CONVERT_STAGES = 5;
+
+struct ConvertSettings {
+  ExportFormat format = ExportFormat::PPM;
+
+  // File name extension, dot included; empty for the format's own.
+  string extension;
+
+  // Make pixels square, going by BMHD.
+  bool correct_aspect = false;
+
+  // Threads reading and writing files, per stage.
+  size_t io_threads = 2;
+
+  // Threads decoding, resolving and encoding, per stage.
+  size_t threads = 2;
+
+  // Images waiting between two stages at most.
+  size_t queue_length = 4;
+};
+
+struct ConvertStats {
+  size_t images = 0; // Written.
+  size_t failed = 0; // Unreadable, not ILBM, or not written.
+  uint64_t bytes_read = 0;
+  uint64_t bytes_written = 0;
+  uint64_t pixels = 0;
+  double seconds = 0;
+
+  // Time spent in each stage, over all its threads. The stage with the
+  // most per thread is the one holding the others up.
+  std::array<double, CONVERT_STAGES> stage_seconds{};
+
+  const double ImagesPerSecond() const;
+  const double MegabytesReadPerSecond() const;
+  const double MegabytesWrittenPerSecond() const;
+};
+
+// Called with each file that could not be converted, and why.
+using ConvertFailure =
+    std::function<void(const fs::path &source, const string &reason)>;
+
+// Converts every file under input (or input itself, if a file) into output,
+// keeping the folder structure below input. Files that would be written
+// under the same name get names of their own, and an output folder inside
+// input is left out. Failures are reported one at a time, from whichever
+// stage they happen in.
+const ConvertStats ConvertTree(const fs::path &input, const fs::path &output,
+                               const ConvertSettings &settings,
+                               const ConvertFailure &failed = nullptr);
+
+// Totals, rates and time per stage, one per line.
+const string FormatConvertStats(const ConvertStats &stats);
+} // namespace IFFReader
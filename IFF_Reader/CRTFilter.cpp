@@ -0,0 +1,352 @@
+#include "CRTFilter.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+// Rows per band handed to the thread pool.
+constexpr size_t BAND_ROWS = 16;
+
+// Bloom spreads light this many image pixels in each direction.
+constexpr int32_t GLOW_RADIUS = 4;
+constexpr int32_t GLOW_AREA = (2 * GLOW_RADIUS + 1) * (2 * GLOW_RADIUS + 1);
+
+IFFReader::CRTFilter::CRTFilter(const uint32_t width, const uint32_t height,
+                                const CRTSettings &settings)
+    : source_width_(width), source_height_(height), settings_(settings) {
+  settings_.scale = std::max(settings_.scale, 1u);
+  settings_.blur = std::min<uint8_t>(settings_.blur, 85);
+
+  const auto scale = settings_.scale;
+  const auto screen_width = Width();
+
+  // The beam is brightest at the top of its scanline and fades towards the
+  // gap below, falling off with the square of the distance.
+  vector<uint16_t> scanline(scale);
+  for (uint32_t row = 0; row < scale; ++row) {
+    const auto depth = (2 * row + 1) * (2 * row + 1);
+    scanline[row] = static_cast<uint16_t>(
+        256 - settings_.scanlines * depth / (4 * scale * scale));
+  }
+
+  // A shadow mask shifts its triads by a column on every other scanline.
+  const auto variants = settings_.mask == MaskPattern::ShadowMask ? 2u : 1u;
+  const auto dim = static_cast<uint16_t>(
+      settings_.mask == MaskPattern::Flat ? 256
+                                          : 256 - settings_.mask_strength);
+
+  for (uint32_t variant = 0; variant < variants; ++variant) {
+    for (uint32_t row = 0; row < scale; ++row) {
+      vector<array<uint16_t, 4>> weights(screen_width);
+      for (uint32_t x = 0; x < screen_width; ++x) {
+        const auto phosphor = (x + variant) % 3;
+        for (uint32_t channel = 0; channel < 3; ++channel) {
+          const auto mask = channel == phosphor ? 256 : dim;
+          weights[x][channel] =
+              static_cast<uint16_t>(mask * scanline[row] >> 8);
+        }
+        weights[x][3] = 256; // Alpha.
+      }
+      weights_.push_back(std::move(weights));
+    }
+  }
+
+  const auto pixels = static_cast<size_t>(width) * height;
+  if (settings_.blur != 0) {
+    blurred_.resize(pixels);
+  }
+  if (settings_.bloom != 0) {
+    glow_rows_.resize(pixels * 4);
+    glow_.resize(pixels);
+  }
+}
+
+const uint32_t IFFReader::CRTFilter::Width() const {
+  return source_width_ * settings_.scale;
+}
+
+const uint32_t IFFReader::CRTFilter::Height() const {
+  return source_height_ * settings_.scale;
+}
+
+const uint32_t IFFReader::CRTFilter::SourceWidth() const {
+  return source_width_;
+}
+
+const uint32_t IFFReader::CRTFilter::SourceHeight() const {
+  return source_height_;
+}
+
+const IFFReader::CRTSettings &IFFReader::CRTFilter::Settings() const {
+  return settings_;
+}
+
+// Weighted sum of a pixel and its neighbours, channel by channel.
+static const uint32_t BlurPixel(const uint32_t left, const uint32_t middle,
+                                const uint32_t right, const uint32_t side) {
+  uint32_t pixel = 0;
+  for (int c = 0; c < 32; c += 8) {
+    const auto sum = side * (((left >> c) & 0xff) + ((right >> c) & 0xff)) +
+                     (256 - 2 * side) * ((middle >> c) & 0xff);
+    pixel |= (sum >> 8) << c;
+  }
+  return pixel;
+}
+
+// Scanline and mask weights applied to a pixel, with glow added on top.
+static const uint32_t ShadePixel(const uint32_t color, const uint32_t glow,
+                                 const array<uint16_t, 4> &weight) {
+  uint32_t pixel = 0;
+  for (int c = 0, k = 0; c < 32; c += 8, ++k) {
+    const auto value =
+        (((color >> c) & 0xff) * weight[k] >> 8) + ((glow >> c) & 0xff);
+    pixel |= std::min(value, 255u) << c;
+  }
+  return pixel;
+}
+
+#if IFF_SIMD_X86
+// Blurs pixels 1 to count - 1, four at a time. Returns the first pixel not
+// done.
+IFF_TARGET_SSE2 static const size_t BlurRow_SSE2(const uint32_t *source,
+                                                 const size_t count,
+                                                 const uint32_t side,
+                                                 uint32_t *destination) {
+  const auto zero = _mm_setzero_si128();
+  const auto side_weight = _mm_set1_epi16(static_cast<int16_t>(side));
+  const auto middle_weight =
+      _mm_set1_epi16(static_cast<int16_t>(256 - 2 * side));
+
+  size_t x = 1;
+  for (; x + 5 <= count; x += 4) {
+    const auto left =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + x - 1));
+    const auto middle =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + x));
+    const auto right =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + x + 1));
+
+    __m128i halves[2];
+    for (int half = 0; half < 2; ++half) {
+      const auto l = half ? _mm_unpackhi_epi8(left, zero)
+                          : _mm_unpacklo_epi8(left, zero);
+      const auto m = half ? _mm_unpackhi_epi8(middle, zero)
+                          : _mm_unpacklo_epi8(middle, zero);
+      const auto r = half ? _mm_unpackhi_epi8(right, zero)
+                          : _mm_unpacklo_epi8(right, zero);
+      const auto sum =
+          _mm_add_epi16(_mm_mullo_epi16(_mm_add_epi16(l, r), side_weight),
+                        _mm_mullo_epi16(m, middle_weight));
+      halves[half] = _mm_srli_epi16(sum, 8);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + x),
+                     _mm_packus_epi16(halves[0], halves[1]));
+  }
+  return x;
+}
+
+// Shades pixels four at a time, two in each half of the register. Returns
+// pixels done.
+IFF_TARGET_SSE2 static const size_t
+ShadeRow_SSE2(const uint32_t *color, const uint32_t *glow,
+              const array<uint16_t, 4> *weights, const size_t count,
+              uint32_t *destination) {
+  const auto zero = _mm_setzero_si128();
+  size_t x = 0;
+  for (; x + 4 <= count; x += 4) {
+    const auto pixels =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(color + x));
+    const auto glows =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(glow + x));
+
+    __m128i halves[2];
+    for (int half = 0; half < 2; ++half) {
+      const auto c = half ? _mm_unpackhi_epi8(pixels, zero)
+                          : _mm_unpacklo_epi8(pixels, zero);
+      const auto g = half ? _mm_unpackhi_epi8(glows, zero)
+                          : _mm_unpacklo_epi8(glows, zero);
+      const auto w = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(weights + x + half * 2));
+      halves[half] =
+          _mm_add_epi16(_mm_srli_epi16(_mm_mullo_epi16(c, w), 8), g);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + x),
+                     _mm_packus_epi16(halves[0], halves[1]));
+  }
+  return x;
+}
+#endif
+
+// Horizontal blur at image resolution. Edge pixels count themselves as
+// the missing neighbour.
+void IFFReader::CRTFilter::Blur(const uint32_t *source,
+                                const size_t source_stride) {
+  const auto side = settings_.blur;
+  const auto width = static_cast<size_t>(source_width_);
+
+  ThreadPool::Shared().ParallelFor(
+      0, source_height_, BAND_ROWS, [&](const size_t first, const size_t last) {
+        for (auto y = first; y < last; ++y) {
+          const auto *row = source + y * source_stride;
+          auto *out = blurred_.data() + y * width;
+
+          size_t x = 1;
+#if IFF_SIMD_X86
+          if (DetectSimdLevel() != SimdLevel::Scalar) {
+            x = BlurRow_SSE2(row, width, side, out);
+          }
+#endif
+          for (; x + 1 < width; ++x) {
+            out[x] = BlurPixel(row[x - 1], row[x], row[x + 1], side);
+          }
+          const auto next = std::min<size_t>(1, width - 1);
+          out[0] = BlurPixel(row[0], row[0], row[next], side);
+          if (width > 1) {
+            out[width - 1] =
+                BlurPixel(row[width - 2], row[width - 1], row[width - 1], side);
+          }
+        }
+      });
+}
+
+// Light above half brightness spreads over a square around its pixel. A
+// running horizontal box sum per channel is kept first, then summed down
+// the columns.
+void IFFReader::CRTFilter::Bloom(const uint32_t *source,
+                                 const size_t source_stride) {
+  const auto width = static_cast<int32_t>(source_width_);
+  const auto height = static_cast<int32_t>(source_height_);
+
+  ThreadPool::Shared().ParallelFor(
+      0, source_height_, BAND_ROWS, [&](const size_t first, const size_t last) {
+        vector<uint32_t> bright(static_cast<size_t>(width) * 4);
+        for (auto y = first; y < last; ++y) {
+          const auto *row = source + y * source_stride;
+          for (int32_t x = 0; x < width; ++x) {
+            for (int c = 0; c < 3; ++c) {
+              const auto value = (row[x] >> (c * 8)) & 0xff;
+              bright[x * 4 + c] = value > 128 ? (value - 128) * 2 : 0;
+            }
+          }
+
+          auto *sums = glow_rows_.data() + y * width * 4;
+          uint32_t running[3] = {0, 0, 0};
+          for (int32_t x = -GLOW_RADIUS; x < width; ++x) {
+            const auto entering = x + GLOW_RADIUS;
+            const auto leaving = x - GLOW_RADIUS - 1;
+            for (int c = 0; c < 3; ++c) {
+              if (entering < width) {
+                running[c] += bright[entering * 4 + c];
+              }
+              if (leaving >= 0) {
+                running[c] -= bright[leaving * 4 + c];
+              }
+              if (x >= 0) {
+                sums[x * 4 + c] = running[c];
+              }
+            }
+          }
+        }
+      });
+
+  const auto bloom = settings_.bloom;
+  ThreadPool::Shared().ParallelFor(
+      0, source_height_, BAND_ROWS, [&](const size_t first, const size_t last) {
+        // Column sums over the rows around y, slid down one row at a time.
+        vector<uint32_t> column(static_cast<size_t>(width) * 4, 0);
+        const auto add_row = [&](const int32_t row, const bool adding) {
+          if (row < 0 || row >= height) {
+            return;
+          }
+          const auto *sums = glow_rows_.data() + row * width * 4;
+          for (int32_t i = 0; i < width * 4; ++i) {
+            column[i] = adding ? column[i] + sums[i] : column[i] - sums[i];
+          }
+        };
+
+        const auto band_top = static_cast<int32_t>(first);
+        for (auto row = band_top - GLOW_RADIUS - 1;
+             row < band_top + GLOW_RADIUS; ++row) {
+          add_row(row, true);
+        }
+
+        for (auto y = band_top; y < static_cast<int32_t>(last); ++y) {
+          add_row(y + GLOW_RADIUS, true);
+          add_row(y - GLOW_RADIUS - 1, false);
+
+          auto *out = glow_.data() + y * width;
+          for (int32_t x = 0; x < width; ++x) {
+            uint32_t pixel = 0;
+            for (int c = 0; c < 3; ++c) {
+              const auto value = column[x * 4 + c] * bloom / (GLOW_AREA * 256);
+              pixel |= std::min(value, 255u) << (c * 8);
+            }
+            out[x] = pixel;
+          }
+        }
+      });
+}
+
+// Each screen row takes its image row, widened, and shades it with the
+// weights of its place within the scanline.
+void IFFReader::CRTFilter::Enlarge(const uint32_t *source,
+                                   const size_t source_stride,
+                                   uint32_t *destination,
+                                   const size_t destination_stride) const {
+  const auto scale = settings_.scale;
+  const auto screen_width = static_cast<size_t>(Width());
+
+  ThreadPool::Shared().ParallelFor(
+      0, Height(), BAND_ROWS, [&](const size_t first, const size_t last) {
+        vector<uint32_t> color(screen_width);
+        vector<uint32_t> glow(screen_width, 0);
+
+        for (auto y = first; y < last; ++y) {
+          const auto source_y = y / scale;
+          const auto *row = source + source_y * source_stride;
+          for (uint32_t x = 0; x < source_width_; ++x) {
+            std::fill_n(color.begin() + x * scale, scale, row[x]);
+          }
+          if (!glow_.empty()) {
+            const auto *glow_row = glow_.data() + source_y * source_width_;
+            for (uint32_t x = 0; x < source_width_; ++x) {
+              std::fill_n(glow.begin() + x * scale, scale, glow_row[x]);
+            }
+          }
+
+          const auto &weights = weights_[y % weights_.size()];
+          auto *out = destination + y * destination_stride;
+
+          size_t x = 0;
+#if IFF_SIMD_X86
+          if (DetectSimdLevel() != SimdLevel::Scalar) {
+            x = ShadeRow_SSE2(color.data(), glow.data(), weights.data(),
+                              screen_width, out);
+          }
+#endif
+          for (; x < screen_width; ++x) {
+            out[x] = ShadePixel(color[x], glow[x], weights[x]);
+          }
+        }
+      });
+}
+
+void IFFReader::CRTFilter::Apply(const uint32_t *source,
+                                 const size_t source_stride,
+                                 uint32_t *destination,
+                                 const size_t destination_stride) {
+  if (source_width_ == 0 || source_height_ == 0) {
+    return;
+  }
+
+  if (!glow_.empty()) {
+    Bloom(source, source_stride);
+  }
+
+  if (blurred_.empty()) {
+    Enlarge(source, source_stride, destination, destination_stride);
+  } else {
+    Blur(source, source_stride);
+    Enlarge(blurred_.data(), source_width_, destination, destination_stride);
+  }
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using std::array;
+using std::vector;
+
+/*
+ * Simulates a CRT once the image has been resolved to color. Each image
+ * pixel becomes scale x scale screen pixels. The beam blurs horizontally,
+ * the gaps between scanlines are darker, the phosphors of a shadow mask or
+ * aperture grille tint alternate columns, and bright areas glow (bloom).
+ *
+ * Each effect is a pass of its own over bands of rows, spread over the
+ * thread pool. Blur and bloom work at image resolution. The last pass
+ * enlarges the image and applies scanlines and mask together. Their weight
+ * depends only on the screen column and the row within a scanline, so a
+ * table per row holds it for every column.
+ */
+namespace IFFReader {
+
+enum class MaskPattern {
+  Flat,          // No phosphor pattern.
+  ShadowMask,    // Triads of dots, shifted on alternate lines.
+  ApertureGrille // Unbroken stripes of red, green and blue.
+};
+
+// Strengths are in 1/256ths.
+struct CRTSettings {
+  // Screen pixels per image pixel, each way.
+  uint32_t scale = 2;
+
+  // Darkening towards the gap between scanlines.
+  uint8_t scanlines = 128;
+
+  // Dimming of the two colors a phosphor column does not show.
+  MaskPattern mask = MaskPattern::ApertureGrille;
+  uint8_t mask_strength = 64;
+
+  // Weight of either horizontal neighbour; at most 85.
+  uint8_t blur = 40;
+
+  // Glow added around bright areas.
+  uint8_t bloom = 96;
+};
+
+class CRTFilter {
+  uint32_t source_width_;
+  uint32_t source_height_;
+  CRTSettings settings_;
+
+  // Scanline and mask weights per screen column, for each row within a
+  // scanline: four channels each, 256 leaving a channel as it is. Rows
+  // past the first scale repeat them shifted, for the shadow mask.
+  vector<vector<array<uint16_t, 4>>> weights_;
+
+  // Image after horizontal blur, and the glow to add, at image resolution.
+  vector<uint32_t> blurred_;
+  vector<uint32_t> glow_rows_;
+  vector<uint32_t> glow_;
+
+  void Blur(const uint32_t *source, const size_t source_stride);
+  void Bloom(const uint32_t *source, const size_t source_stride);
+  void Enlarge(const uint32_t *source, const size_t source_stride,
+               uint32_t *destination, const size_t destination_stride) const;
+
+public:
+  CRTFilter(const uint32_t width, const uint32_t height,
+            const CRTSettings &settings = CRTSettings());
+
+  // Size of the simulated screen.
+  const uint32_t Width() const;
+  const uint32_t Height() const;
+
+  // Size of the images it takes.
+  const uint32_t SourceWidth() const;
+  const uint32_t SourceHeight() const;
+
+  const CRTSettings &Settings() const;
+
+  // Renders a whole image to the screen. Strides are in pixels.
+  void Apply(const uint32_t *source, const size_t source_stride,
+             uint32_t *destination, const size_t destination_stride);
+};
+} // namespace IFFReader
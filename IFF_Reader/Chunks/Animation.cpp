@@ -0,0 +1,245 @@
+#include "Animation.h"
+#include "ILBMWriter.h"
+#include "Unknown.h"
+
+using std::make_shared;
+
+IFFReader::ANIM::ANIM(bytestream &stream) {
+  FabricateFrames(stream);
+  if (!image_) {
+    return;
+  }
+
+  // The first frame's planes, taken from its chunky indices.
+  const auto indexed = image_->GetIndexed();
+  first_ = PlanarFrame(indexed.width, indexed.height,
+                       std::min<uint16_t>(image_->bitplanes_count(), 8));
+  vector<uint8_t> row(first_.row_bytes * first_.planes);
+  for (uint32_t y = 0; y < indexed.height; ++y) {
+    ChunkyToPlanar(indexed.indices + y * indexed.stride, indexed.width,
+                   first_.planes, row.data(), first_.row_bytes);
+    for (uint16_t p = 0; p < first_.planes; ++p) {
+      std::copy(row.begin() + p * first_.row_bytes,
+                row.begin() + (p + 1) * first_.row_bytes,
+                first_.Plane(p) + y * first_.row_bytes);
+    }
+  }
+  buffers_ = {first_, first_};
+  stale_ = {DirtyRows(first_.height, 0), DirtyRows(first_.height, 0)};
+}
+
+// Every frame is a FORM ILBM of its own, read whole and parsed from memory,
+// so that chunks of one frame never run into the next.
+void IFFReader::ANIM::FabricateFrames(bytestream &stream) {
+  while (stream.good()) {
+    const string tag{read_tag(stream)};
+    const auto size = read_long(stream);
+    if (!stream.good() || size > remaining_bytes(stream)) {
+      return; // Truncated; keep the frames read so far.
+    }
+
+    bytefield contents(size);
+    stream.read(contents.data(), static_cast<std::streamsize>(size));
+    if (size % 2 != 0) {
+      stream.ignore(1); // Pad byte.
+    }
+
+    if (tag != "FORM" || size < 4) {
+      continue;
+    }
+    MemoryStream form(contents.data(), contents.size());
+    if (read_tag(form) != "ILBM") {
+      continue;
+    }
+    if (!image_) {
+      image_ = make_shared<ILBM>(form);
+    } else {
+      frames_.push_back(FabricateFrame(form));
+    }
+  }
+}
+
+const IFFReader::AnimationFrame
+IFFReader::ANIM::FabricateFrame(bytestream &stream) {
+  AnimationFrame frame;
+  while (stream.good()) {
+    const string tag{read_tag(stream)};
+    if (!stream.good()) {
+      break;
+    }
+    if (tag == "ANHD") {
+      frame.header = make_shared<ANHD>(ANHD(stream));
+    } else if (tag == "DLTA") {
+      frame.delta = make_shared<DLTA>(DLTA(stream));
+    } else {
+      const UNKNOWN skipped(stream);
+    }
+    if (static_cast<std::streamoff>(stream.tellg()) % 2 != 0) {
+      stream.ignore(1); // Pad byte.
+    }
+  }
+  return frame;
+}
+
+shared_ptr<IFFReader::ILBM> IFFReader::ANIM::Image() const { return image_; }
+
+const size_t IFFReader::ANIM::FrameCount() const {
+  return image_ ? frames_.size() + 1 : 0;
+}
+
+const size_t IFFReader::ANIM::CurrentFrame() const { return current_; }
+
+shared_ptr<const IFFReader::ANHD>
+IFFReader::ANIM::FrameHeader(const size_t n) const {
+  if (n == 0 || n > frames_.size()) {
+    return shared_ptr<const ANHD>();
+  }
+  return frames_[n - 1].header;
+}
+
+const uint32_t IFFReader::ANIM::DisplayJiffies(const size_t n) const {
+  const auto next = FrameHeader(n + 1 < FrameCount() ? n + 1 : 1);
+  return next ? next->RelativeTime() : 0;
+}
+
+shared_ptr<const IFFReader::DLTA>
+IFFReader::ANIM::FrameDelta(const size_t n) const {
+  if (n == 0 || n > frames_.size()) {
+    return shared_ptr<const DLTA>();
+  }
+  return frames_[n - 1].delta;
+}
+
+const IFFReader::PlanarFrame &IFFReader::ANIM::FirstPlanes() const {
+  return first_;
+}
+
+const bool IFFReader::ANIM::NextFrame() {
+  if (!image_) {
+    return false;
+  }
+  if (current_ + 1 >= FrameCount()) {
+    Rewind();
+    return true;
+  }
+
+  const auto valid = Step();
+  Present(shown_);
+  return valid;
+}
+
+const bool IFFReader::ANIM::Step() {
+  const auto &frame = frames_[current_];
+  ++current_;
+  if (!frame.header || !frame.delta) {
+    return false;
+  }
+
+  // Interleave 2 plays into the other buffer, which holds the frame before
+  // last; interleave 1 into the one shown.
+  const auto target = frame.header->Interleave() == 1 ? shown_ : 1 - shown_;
+  const auto valid = ApplyDelta(*frame.header, frame.delta->GetData(),
+                                buffers_[target], stale_[target]);
+  shown_ = target;
+  return valid;
+}
+
+void IFFReader::ANIM::Restore(const size_t k) {
+  if (k == 0) {
+    buffers_ = {first_, first_};
+    shown_ = 0;
+  } else {
+    buffers_ = keyframes_[k - 1].buffers;
+    shown_ = keyframes_[k - 1].shown;
+  }
+  current_ = k * keyframe_interval_;
+  std::fill(stale_[0].begin(), stale_[0].end(), 1);
+  std::fill(stale_[1].begin(), stale_[1].end(), 1);
+}
+
+void IFFReader::ANIM::Present(const size_t buffer) {
+  auto &stale = stale_[buffer];
+  auto &other = stale_[1 - buffer];
+  changed_rows_.clear();
+  for (uint32_t y = 0; y < stale.size(); ++y) {
+    if (stale[y]) {
+      changed_rows_.push_back(y);
+      other[y] = 1; // The other buffer still has the rows as they were.
+      stale[y] = 0;
+    }
+  }
+
+  if (!changed_rows_.empty()) {
+    PlanarRowsToChunky(buffers_[buffer], changed_rows_,
+                       image_->MutableIndices());
+    image_->IndicesChanged();
+  }
+  shown_ = buffer;
+}
+
+// Both buffers start over from the first frame. Rows are not tracked back
+// that far, so all of them are converted again.
+void IFFReader::ANIM::Rewind() {
+  if (!image_) {
+    return;
+  }
+  buffers_ = {first_, first_};
+  std::fill(stale_[0].begin(), stale_[0].end(), 1);
+  current_ = 0;
+  Present(0);
+
+  // The other buffer holds the first frame as well.
+  std::fill(stale_[1].begin(), stale_[1].end(), 0);
+}
+
+// Frames are stepped through without presenting any; the image keeps
+// showing the frame it did until Seek brings it back.
+const bool IFFReader::ANIM::IndexKeyframes(const size_t interval) {
+  keyframes_.clear();
+  keyframe_interval_ = interval;
+  if (!image_ || interval == 0) {
+    return true;
+  }
+
+  const auto resume = current_;
+  Restore(0);
+  bool valid = true;
+  while (current_ + 1 < FrameCount()) {
+    valid = Step() && valid;
+    if (current_ % interval == 0) {
+      keyframes_.push_back({buffers_, shown_});
+    }
+  }
+  return Seek(resume) && valid;
+}
+
+const size_t IFFReader::ANIM::KeyframeCount() const {
+  return keyframes_.size();
+}
+
+// Going back always restores a keyframe; going forward only does if one
+// lies past the current frame.
+const bool IFFReader::ANIM::Seek(const size_t n) {
+  if (!image_ || n >= FrameCount()) {
+    return false;
+  }
+
+  const auto k =
+      keyframe_interval_ == 0
+          ? 0
+          : std::min(n / keyframe_interval_, keyframes_.size());
+  if (n < current_ || k * keyframe_interval_ > current_) {
+    Restore(k);
+  }
+
+  bool valid = true;
+  while (current_ < n) {
+    valid = Step() && valid;
+  }
+  Present(shown_);
+  return valid;
+}
+
+const vector<uint32_t> &IFFReader::ANIM::ChangedRows() const {
+  return changed_rows_;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include "AnimDelta.h"
+#include "AnimationHeader.h"
+#include "Delta.h"
+#include "InterleavedBitmap.h"
+
+namespace IFFReader {
+
+// Frames between keyframes kept for seeking, unless asked otherwise.
+constexpr size_t ANIM_KEYFRAME_INTERVAL = 32;
+
+// A frame after the first: how it is encoded, and its changes.
+struct AnimationFrame {
+  shared_ptr<ANHD> header;
+  shared_ptr<DLTA> delta;
+};
+
+// Both buffers as they were at some frame, and which of them held it.
+struct AnimationKeyframe {
+  array<PlanarFrame, 2> buffers;
+  size_t shown = 0;
+};
+
+// FORM ANIM: a FORM ILBM for the first frame, then one per frame holding
+// ANHD and DLTA. Frames are played into the first frame's image, whose
+// indices always show the current frame.
+//
+// Deltas usually apply to the frame before last, so two planar frames are
+// kept, as on the Amiga, and played into by turns. Each keeps the rows
+// where it differs from the image shown; presenting a frame converts only
+// those to chunky indices.
+//
+// Deltas only go forward, so reaching a frame means playing every delta
+// before it. Indexing keeps both buffers every so many frames, which seeking
+// starts from instead: frame 5000 is then at most an interval of deltas
+// away, at the cost of two planar frames per keyframe.
+class ANIM : public CHUNK {
+  shared_ptr<ILBM> image_;
+  vector<AnimationFrame> frames_;
+
+  // Planes of the first frame, for rewinding.
+  PlanarFrame first_;
+
+  array<PlanarFrame, 2> buffers_;
+
+  // Rows where each buffer differs from the image shown.
+  array<DirtyRows, 2> stale_;
+
+  size_t current_ = 0; // Frame shown.
+  size_t shown_ = 0;   // Buffer shown.
+  vector<uint32_t> changed_rows_;
+
+  // Frames between keyframes; keyframe k holds frame (k + 1) * interval.
+  size_t keyframe_interval_ = 0;
+  vector<AnimationKeyframe> keyframes_;
+
+  // Reads the FORM ILBMs inside the FORM ANIM.
+  void FabricateFrames(bytestream &stream);
+
+  // Reads ANHD and DLTA from a FORM ILBM after the first.
+  static const AnimationFrame FabricateFrame(bytestream &stream);
+
+  // Applies the next frame's delta to the buffer it belongs in, which then
+  // holds the current frame. Nothing is presented. False as NextFrame.
+  const bool Step();
+
+  // Makes keyframe k current, 0 being the first frame. Every row of both
+  // buffers is taken to differ from the image shown.
+  void Restore(const size_t k);
+
+  // Converts the buffer's stale rows into the image and shows it.
+  void Present(const size_t buffer);
+
+public:
+  ANIM(bytestream &stream);
+
+  // The current frame. Empty if the first frame could not be read.
+  shared_ptr<ILBM> Image() const;
+
+  // Frames in the file, the first included.
+  const size_t FrameCount() const;
+
+  // Frame currently in Image().
+  const size_t CurrentFrame() const;
+
+  // Header of frame n (from 1); empty for the first.
+  shared_ptr<const ANHD> FrameHeader(const size_t n) const;
+
+  // Jiffies (1/60 s) frame n stays up before the next is shown. The last
+  // frame is followed by the first.
+  const uint32_t DisplayJiffies(const size_t n) const;
+
+  // Delta of frame n (from 1); empty for the first.
+  shared_ptr<const DLTA> FrameDelta(const size_t n) const;
+
+  // Planes of the first frame, which deltas start from.
+  const PlanarFrame &FirstPlanes() const;
+
+  // Applies the next frame's delta and shows it; after the last frame,
+  // rewinds to the first. False if the delta was damaged or of an
+  // operation not supported (see AnimDelta.h), in which case the frame may
+  // be incomplete.
+  const bool NextFrame();
+
+  // Shows the first frame again.
+  void Rewind();
+
+  // Plays the animation through once, keeping a keyframe every interval
+  // frames (none if 0), then shows the current frame again. False if any
+  // delta on the way was damaged.
+  const bool IndexKeyframes(const size_t interval = ANIM_KEYFRAME_INTERVAL);
+
+  // Keyframes kept by IndexKeyframes, the first frame not counted.
+  const size_t KeyframeCount() const;
+
+  // Shows frame n, starting from the nearest keyframe before it or from the
+  // current frame, whichever is closer, and presenting only the frame
+  // reached. False if n is out of range or a delta on the way was damaged.
+  const bool Seek(const size_t n);
+
+  // Rows of Image() that changed with the last frame shown, top to bottom.
+  const vector<uint32_t> &ChangedRows() const;
+};
+} // namespace IFFReader
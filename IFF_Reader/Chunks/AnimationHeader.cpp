@@ -0,0 +1,37 @@
+#include "AnimationHeader.h"
+
+constexpr uint32_t BIT_LONG_DATA = 0x1;
+constexpr uint32_t BIT_XOR = 0x2;
+
+IFFReader::ANHD::ANHD()
+    : operation_{0}, mask_{0}, width_{0}, height_{0}, x_{0}, y_{0},
+      abstime_{0}, reltime_{0}, interleave_{0}, bits_{0} {}
+
+IFFReader::ANHD::ANHD(bytestream &stream) : CHUNK(stream) {
+  operation_ = read_byte(stream);
+  mask_ = read_byte(stream);
+  width_ = read_word(stream);
+  height_ = read_word(stream);
+  x_ = static_cast<int16_t>(read_word(stream));
+  y_ = static_cast<int16_t>(read_word(stream));
+  abstime_ = read_long(stream);
+  reltime_ = read_long(stream);
+  interleave_ = read_byte(stream);
+  stream.ignore(1); // 1 byte padding
+  bits_ = read_long(stream);
+  stream.ignore(GetSize() > 24 ? GetSize() - 24 : 0); // Reserved
+}
+
+const uint8_t IFFReader::ANHD::Operation() const { return operation_; }
+
+const uint32_t IFFReader::ANHD::RelativeTime() const { return reltime_; }
+
+const uint8_t IFFReader::ANHD::Interleave() const {
+  return interleave_ == 1 ? 1 : 2;
+}
+
+const bool IFFReader::ANHD::UsesXOR() const { return bits_ & BIT_XOR; }
+
+const bool IFFReader::ANHD::LongData() const { return bits_ & BIT_LONG_DATA; }
+
+const uint32_t IFFReader::ANHD::Bits() const { return bits_; }
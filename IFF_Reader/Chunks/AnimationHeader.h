@@ -0,0 +1,43 @@
+#pragma once
+#include "Chunk.h"
+#include "utility.h"
+
+namespace IFFReader {
+
+// Animation header, one per frame after the first. Says how the frame's
+// DLTA is encoded and how long the frame stays up.
+// [http://wiki.amigaos.net/wiki/ANIM_IFF_CEL_Animations]
+class ANHD : public CHUNK {
+  uint8_t operation_;   // Delta encoding (see AnimDelta.h)
+  uint8_t mask_;        // Planes the delta touches (XOR mode only)
+  uint16_t width_;      // Changed area (XOR mode only)
+  uint16_t height_;
+  int16_t x_;
+  int16_t y_;
+  uint32_t abstime_;    // Jiffies since the first frame (unused)
+  uint32_t reltime_;    // Jiffies since the previous frame
+  uint8_t interleave_;  // Frames back the delta applies to; 0 means 2
+  uint32_t bits_;       // Options for operations 4, 5, 7 and 8
+
+public:
+  ANHD();
+  ANHD(bytestream &stream);
+
+  const uint8_t Operation() const;
+
+  // Jiffies (1/60 s) the previous frame is shown before this one.
+  const uint32_t RelativeTime() const;
+
+  // Frames back the delta applies to: 1 or 2.
+  const uint8_t Interleave() const;
+
+  // Whether data is XORed with the frame rather than stored over it.
+  const bool UsesXOR() const;
+
+  // Whether operation 7 and 8 data are longwords rather than words.
+  const bool LongData() const;
+
+  // Option flags as stored.
+  const uint32_t Bits() const;
+};
+} // namespace IFFReader
@@ -35,3 +35,11 @@ const uint8_t IFFReader::BMHD::CompressionMethod() const {
 }
 
 const uint8_t IFFReader::BMHD::MaskUsed() const { return masking_; }
+
+const uint8_t IFFReader::BMHD::GetXAspect() const { return x_aspect_ratio_; }
+
+const uint8_t IFFReader::BMHD::GetYAspect() const { return y_aspect_ratio_; }
+
+const uint16_t IFFReader::BMHD::GetPageWidth() const { return page_width_; }
+
+const uint16_t IFFReader::BMHD::GetPageHeight() const { return page_height_; }
@@ -38,5 +38,13 @@ public:
 
   // Is a mask in play, and which?
   const uint8_t MaskUsed() const;
+
+  // Pixel width relative to pixel height, as x:y. Zero if not given.
+  const uint8_t GetXAspect() const;
+  const uint8_t GetYAspect() const;
+
+  // Size of the screen the image was made for, in pixels.
+  const uint16_t GetPageWidth() const;
+  const uint16_t GetPageHeight() const;
 };
 } // namespace IFFReader
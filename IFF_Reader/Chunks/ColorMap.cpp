@@ -46,6 +46,10 @@ const size_t IFFReader::CMAP::DefinedColorsCount() const {
   return palette_.size();
 }
 
+const vector<uint32_t> &IFFReader::CMAP::GetPalette() const {
+  return palette_;
+}
+
 void IFFReader::CMAP::CorrectOCSBrightness() {
   if (palette_.size() > 32) {
     return;
@@ -32,6 +32,9 @@ public:
   // Counts the number of uniquely specified colors.
   const size_t DefinedColorsCount() const;
 
+  // Palette as stored, in 0xAABBGGRR format.
+  const vector<uint32_t> &GetPalette() const;
+
   // Corrects missing color information (use for potential OCS IFF images only)
   void CorrectOCSBrightness();
 
@@ -0,0 +1,30 @@
+#include "ColorTable.h"
+
+IFFReader::CTBL::CTBL() {}
+
+IFFReader::CTBL::CTBL(bytestream &stream) : CHUNK(stream) {
+  const auto color_count = GetSize() / 2;
+  for (uint32_t i = 0; i < color_count; ++i) {
+    colors_.push_back(expand_rgb4(read_word(stream)));
+  }
+
+  // Skip remainder, including the pad byte of odd-sized chunks.
+  stream.ignore((GetSize() % 2) * 2);
+}
+
+const vector<vector<uint32_t>>
+IFFReader::CTBL::GetLinePalettes(const size_t colors_per_line) const {
+  vector<vector<uint32_t>> palettes;
+  if (colors_per_line == 0) {
+    return palettes;
+  }
+
+  for (size_t i = 0; i + colors_per_line <= colors_.size();
+       i += colors_per_line) {
+    palettes.emplace_back(begin(colors_) + i,
+                          begin(colors_) + i + colors_per_line);
+  }
+  return palettes;
+}
+
+const size_t IFFReader::CTBL::ColorCount() const { return colors_.size(); }
@@ -0,0 +1,24 @@
+#pragma once
+#include "Chunk.h"
+#include "utility.h"
+
+namespace IFFReader {
+
+// Color table, as written by Digi-View for Dynamic HiRes and Dynamic HAM.
+// Holds a run of color registers (0x0RGB) for every scanline. How many
+// registers belong to a line depends on the image, so the table is kept flat.
+class CTBL : public CHUNK {
+  vector<uint32_t> colors_;
+
+public:
+  CTBL();
+  CTBL(bytestream &stream);
+
+  // Splits the table into per-line palettes of the given size.
+  const vector<vector<uint32_t>>
+  GetLinePalettes(const size_t colors_per_line) const;
+
+  // Number of color registers stored, across all lines.
+  const size_t ColorCount() const;
+};
+} // namespace IFFReader
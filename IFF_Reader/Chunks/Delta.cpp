@@ -0,0 +1,14 @@
+#include "Delta.h"
+#include <algorithm>
+
+IFFReader::DLTA::DLTA() {}
+
+// Kept as stored; decoded when the frame is reached. A size claiming more
+// than the frame holds is cut to what is there.
+IFFReader::DLTA::DLTA(bytestream &stream) : CHUNK(stream) {
+  data_.resize(static_cast<size_t>(
+      std::min<uint64_t>(GetSize(), remaining_bytes(stream))));
+  stream.read(data_.data(), static_cast<std::streamsize>(data_.size()));
+}
+
+const bytefield &IFFReader::DLTA::GetData() const { return data_; }
@@ -0,0 +1,18 @@
+#pragma once
+#include "Chunk.h"
+#include "utility.h"
+
+namespace IFFReader {
+
+// Changes from an earlier frame to this one, encoded as the frame's ANHD
+// says (see AnimDelta.h).
+class DLTA : public CHUNK {
+  bytefield data_;
+
+public:
+  DLTA();
+  DLTA(bytestream &stream);
+
+  const bytefield &GetData() const;
+};
+} // namespace IFFReader
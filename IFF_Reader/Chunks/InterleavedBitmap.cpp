@@ -1,4 +1,5 @@
 #include "InterleavedBitmap.h"
+#include "ThreadPool.h"
 #include "Unknown.h"
 #include <array>
 #include <iostream>
@@ -8,6 +9,7 @@
 using std::array;
 using std::make_shared;
 using std::map;
+using std::max;
 using std::min;
 using std::shared_ptr;
 using std::stringstream;
@@ -16,6 +18,17 @@ IFFReader::ILBM::ILBM(bytestream &stream) {
   FabricateChunks(stream);
   ComputeInterleavedBitplanes();
   color_lookup_ = ColorLookupFactory();
+  color_cycler_ = ColorCyclerFactory();
+  color_lookup_->SetColorCycler(color_cycler_);
+}
+
+IFFReader::ILBM::ILBM(bytestream &stream, vector<uint8_t> screen_data)
+    : screen_data_(std::move(screen_data)) {
+  FabricateChunks(stream);
+  screen_data_.resize(static_cast<size_t>(width()) * height(), 0);
+  color_lookup_ = ColorLookupFactory();
+  color_cycler_ = ColorCyclerFactory();
+  color_lookup_->SetColorCycler(color_cycler_);
 }
 
 // ILBM consists of multiple chunks, fabricated here.
@@ -28,7 +41,9 @@ void IFFReader::ILBM::FabricateChunks(bytestream &stream) {
     const map<string, CHUNK_T> chunks = {
         {"BMHD", CHUNK_T::BMHD}, {"CMAP", CHUNK_T::CMAP},
         {"CAMG", CHUNK_T::CAMG}, {"BODY", CHUNK_T::BODY},
-        {"CRNG", CHUNK_T::CRNG}, {"DRNG", CHUNK_T::DRNG} };
+        {"CRNG", CHUNK_T::CRNG}, {"DRNG", CHUNK_T::DRNG},
+        {"SHAM", CHUNK_T::SHAM}, {"CTBL", CHUNK_T::CTBL},
+        {"PCHG", CHUNK_T::PCHG}, {"CCRT", CHUNK_T::CCRT} };
 
     // Identify chunk.
     const auto found_chunk =
@@ -52,11 +67,23 @@ void IFFReader::ILBM::FabricateChunks(bytestream &stream) {
     case CHUNK_T::BODY: // Body header (i.e. pixel data)
       body_ = make_shared<BODY>(BODY(stream));
       break;
-    case CHUNK_T::CRNG: // Color range (optional)
-      crng_ = make_shared<CRNG>(CRNG(stream));
+    case CHUNK_T::CRNG: // Color range (optional, may repeat)
+      crng_.push_back(make_shared<CRNG>(CRNG(stream)));
+      break;
+    case CHUNK_T::DRNG: // Dynamic color range (optional, may repeat)
+      drng_.push_back(make_shared<DRNG>(DRNG(stream)));
+      break;
+    case CHUNK_T::CCRT: // Graphicraft color cycling (optional, may repeat)
+      ccrt_.push_back(make_shared<CCRT>(CCRT(stream)));
+      break;
+    case CHUNK_T::SHAM: // Sliced HAM palettes (optional)
+      sham_ = make_shared<SHAM>(SHAM(stream));
       break;
-    case CHUNK_T::DRNG: // Dynamic color range (optional)
-      drng_ = make_shared<DRNG>(DRNG(stream));
+    case CHUNK_T::CTBL: // Dynamic HiRes color table (optional)
+      ctbl_ = make_shared<CTBL>(CTBL(stream));
+      break;
+    case CHUNK_T::PCHG: // Palette changes (optional)
+      pchg_ = make_shared<PCHG>(PCHG(stream));
       break;
     case CHUNK_T::UNKNOWN: // Unrecognized chunk
     default:
@@ -151,20 +178,144 @@ shared_ptr<IFFReader::ColorLookup> IFFReader::ILBM::ColorLookupFactory() {
   const auto chipset =
     InferChipset() == Chipset::OCS ? BasicChipset::OCS : BasicChipset::AGA;
 
+  shared_ptr<IFFReader::ColorLookup> lookup;
+
   switch (InferScreenMode()) {
   case ScreenMode::Plain:
   default:
-    return move(make_shared<IFFReader::ColorLookup>(
-      cmap_->GetColors(screen_data_, width(), bitplanes_count(), chipset)));
+    lookup = make_shared<IFFReader::ColorLookup>(
+      cmap_->GetColors(screen_data_, width(), bitplanes_count(), chipset));
+    break;
   case ScreenMode::EHB:
   case ScreenMode::EHB_Sliced:
-    return move(make_shared<IFFReader::ColorLookupEHB>(cmap_->GetColorsEHB(
-      screen_data_, width(), bitplanes_count(), chipset)));
+    lookup = make_shared<IFFReader::ColorLookupEHB>(cmap_->GetColorsEHB(
+      screen_data_, width(), bitplanes_count(), chipset));
+    break;
   case ScreenMode::HAM6:
   case ScreenMode::HAM8:
-    return move(make_shared<IFFReader::ColorLookupHAM>(cmap_->GetColorsHAM(
-      screen_data_, width(), bitplanes_count(), chipset)));
+  case ScreenMode::SHAM:
+    lookup = make_shared<IFFReader::ColorLookupHAM>(cmap_->GetColorsHAM(
+      screen_data_, width(), bitplanes_count(), chipset));
+    break;
+  }
+
+  // Sliced images resolve through the same lookups, one palette per line.
+  lookup->SetPaletteTimeline(PaletteTimelineFactory());
+
+  return lookup;
+}
+
+const bool IFFReader::ILBM::HasPaletteChanges() const {
+  return sham_ || ctbl_ || pchg_;
+}
+
+// SHAM and CTBL give full palettes per line; for interlaced images, one
+// palette may cover several lines. PCHG lists changes only. The timeline
+// keeps just the registers that differ from the line above either way.
+shared_ptr<const IFFReader::PaletteTimeline>
+IFFReader::ILBM::PaletteTimelineFactory() const {
+  if (!HasPaletteChanges()) {
+    return shared_ptr<const PaletteTimeline>();
+  }
+
+  auto timeline = make_shared<PaletteTimeline>(cmap_->GetPalette(), height());
+
+  const auto record_line_palettes =
+    [&](const vector<vector<uint32_t>> &palettes) {
+    if (palettes.empty()) {
+      return;
+    }
+    const auto lines_per_palette =
+      max(1u, height() / static_cast<uint32_t>(palettes.size()));
+
+    for (uint32_t y = 0; y < height(); ++y) {
+      const auto &palette = palettes.at(
+        min<size_t>(y / lines_per_palette, palettes.size() - 1));
+
+      vector<ColorChange> changes;
+      for (uint16_t i = 0; i < palette.size(); ++i) {
+        changes.push_back({ i, palette.at(i) });
+      }
+      timeline->Record(y, changes);
+    }
+  };
+
+  if (sham_) {
+    record_line_palettes(sham_->GetLinePalettes());
+  } else if (ctbl_) {
+    // Dynamic HiRes uses 16 registers per line, unless the table is
+    // exactly large enough for 32.
+    const auto per_line =
+      (ctbl_->ColorCount() == static_cast<size_t>(height()) * 32) ? 32 : 16;
+    record_line_palettes(ctbl_->GetLinePalettes(per_line));
+  } else if (pchg_) {
+    for (const auto &[line, changes] : pchg_->GetLineChanges()) {
+      if (line >= 0) {
+        timeline->Record(static_cast<uint32_t>(line), changes);
+      }
+    }
   }
+
+  return timeline;
+}
+
+shared_ptr<IFFReader::ColorCycler>
+IFFReader::ILBM::ColorCyclerFactory() const {
+  vector<CycleRange> ranges;
+
+  for (const auto &crng : crng_) {
+    ranges.push_back(crng->GetRange());
+  }
+  for (const auto &drng : drng_) {
+    ranges.push_back(drng->GetRange());
+  }
+  for (const auto &ccrt : ccrt_) {
+    ranges.push_back(ccrt->GetRange());
+  }
+
+  return make_shared<ColorCycler>(ranges);
+}
+
+const bool IFFReader::ILBM::HasColorCycling() const {
+  return color_cycler_->HasActiveRanges();
+}
+
+const bool
+IFFReader::ILBM::AdvanceColorCycling(const uint64_t microseconds) {
+  if (!color_cycler_->Advance(microseconds)) {
+    return false;
+  }
+
+  color_lookup_->RefreshPalette();
+  InvalidateStatistics();
+  return true;
+}
+
+void IFFReader::ILBM::ResetColorCycling() {
+  color_cycler_->Reset();
+  color_lookup_->RefreshPalette();
+  InvalidateStatistics();
+}
+
+// Halfbrite colors follow their full brightness counterparts.
+const array<bool, 256> IFFReader::ILBM::CyclingRegisters() const {
+  auto registers = color_cycler_->ActiveRegisters();
+
+  const auto mode = InferScreenMode();
+  if (mode == ScreenMode::EHB || mode == ScreenMode::EHB_Sliced) {
+    for (int r = 0; r < 32; ++r) {
+      registers[r + 32] = registers[r + 32] || registers[r];
+    }
+  }
+  return registers;
+}
+
+const IFFReader::PixelRunIndex &IFFReader::ILBM::CyclingRuns() {
+  if (!cycling_runs_) {
+    cycling_runs_ =
+        make_shared<const PixelRunIndex>(GetIndexed(), CyclingRegisters());
+  }
+  return *cycling_runs_;
 }
 
 // Counts number of defined palette colors (32 for EHB, 16 for HAM...)
@@ -191,15 +342,21 @@ const IFFReader::Chipset IFFReader::ILBM::InferChipset() const {
 const IFFReader::ScreenMode IFFReader::ILBM::InferScreenMode() const {
   if (camg_) {
     if (camg_->GetModes().ExtraHalfBrite) {
-      return ScreenMode::EHB;
+      return HasPaletteChanges() ? ScreenMode::EHB_Sliced : ScreenMode::EHB;
     }
     if (camg_->GetModes().HoldAndModify) {
+      if (HasPaletteChanges()) {
+        return ScreenMode::SHAM;
+      }
       return DefinedColorsCount() <= 16 ? ScreenMode::HAM6 : ScreenMode::HAM8;
     }
     return ScreenMode::Plain;
   }
 
   // For want of a CAMG chunk, we need to infer which OCS mode this is.
+  if (sham_) {
+    return ScreenMode::SHAM;
+  }
   if (bitplanes_count() == 6) {
     return DefinedColorsCount() == 16 ? ScreenMode::EHB : ScreenMode::HAM6;
   }
@@ -214,11 +371,90 @@ const uint16_t IFFReader::ILBM::bitplanes_count() const {
   return header_->GetBitplanesCount();
 }
 
+const uint8_t IFFReader::ILBM::x_aspect() const {
+  return header_->GetXAspect();
+}
+
+const uint8_t IFFReader::ILBM::y_aspect() const {
+  return header_->GetYAspect();
+}
+
+const bool IFFReader::ILBM::Interlaced() const {
+  return camg_ && camg_->GetModes().Interlace;
+}
+
+const uint32_t IFFReader::ILBM::ViewModes() const {
+  return camg_ ? camg_->GetModes().contents : 0;
+}
+
+const IFFReader::AspectScaler
+IFFReader::ILBM::AspectCorrection(const ScaleFilter filter) const {
+  return AspectScaler(width(), height(), x_aspect(), y_aspect(), filter);
+}
+
 const uint32_t IFFReader::ILBM::color_at(const unsigned int x,
   const unsigned int y) const {
   return color_lookup_->at(x, y);
 }
 
+void IFFReader::ILBM::ResolveRows(const uint32_t first, const uint32_t last,
+  uint32_t *destination,
+  const size_t stride) const {
+  color_lookup_->ResolveRows(first, min(last, height()), destination, stride);
+}
+
+// Rows are resolved a batch at a time into a small scratch buffer, then
+// converted; the full image is never held as 0xAABBGGRR.
+void IFFReader::ILBM::ResolveRows(const uint32_t first, const uint32_t last,
+                                  const PixelFormat format,
+                                  uint8_t *destination,
+                                  const size_t stride) const {
+  constexpr uint32_t batch = 16;
+  const auto end = min(last, height());
+  vector<uint32_t> scratch(static_cast<size_t>(width()) * batch);
+
+  for (auto y = first; y < end; y += batch) {
+    const auto rows = min(batch, end - y);
+    color_lookup_->ResolveRows(y, y + rows, scratch.data(), width());
+    ConvertRows(scratch.data(), width(), rows, width(), format,
+                destination + static_cast<size_t>(y - first) * stride, stride);
+  }
+}
+
+const bool IFFReader::ILBM::HasIndexedOutput() const {
+  switch (InferScreenMode()) {
+  case ScreenMode::HAM6:
+  case ScreenMode::HAM8:
+  case ScreenMode::SHAM:
+    return false;
+  default:
+    return true;
+  }
+}
+
+const IFFReader::IndexedImage IFFReader::ILBM::GetIndexed() const {
+  IndexedImage image;
+  image.indices = screen_data_.data();
+  image.width = width();
+  image.height = height();
+  image.stride = width();
+  image.palette = EffectivePalette(0);
+  image.sliced = color_lookup_->Sliced();
+  return image;
+}
+
+uint8_t *IFFReader::ILBM::MutableIndices() { return screen_data_.data(); }
+
+void IFFReader::ILBM::IndicesChanged() {
+  cycling_runs_.reset();
+  InvalidateStatistics();
+}
+
+const vector<uint32_t>
+IFFReader::ILBM::EffectivePalette(const uint32_t y) const {
+  return color_lookup_->EffectivePalette(y);
+}
+
 const bool IFFReader::ILBM::allows_ocs_correction() const {
   return color_lookup_->IsOCSCorrectible();
 }
@@ -229,6 +465,7 @@ const bool IFFReader::ILBM::using_ocs_correction() const {
 
 void IFFReader::ILBM::color_correction(const bool enable) {
   color_lookup_->AdjustForOCS(enable);
+  InvalidateStatistics();
 }
 
 const bytefield IFFReader::ILBM::FetchData(const uint8_t compression) const {
@@ -275,21 +512,77 @@ const string IFFReader::ILBM::GetImageInfo() const {
   case ScreenMode::HAM8:
     ss << "HAM8 (Hold and Modify for AGA)";
     break;
+  case ScreenMode::EHB_Sliced:
+    ss << "sliced EHB (Extra Halfbrite, palette changes per line)";
+    break;
+  case ScreenMode::SHAM:
+    ss << "sliced HAM (Hold and Modify, palette changes per line)";
+    break;
   default:
     break;
   }
   ss << ")\n";
 
+  const auto statistics = Statistics();
+  if (statistics->palette_entries > 0) {
+    ss << "Palette entries used: " << statistics->used_entries << " of "
+      << statistics->palette_entries << "\n";
+  }
+
+  if (HasColorCycling()) {
+    ss << "Color cycling: " << color_cycler_->GetRanges().size()
+      << " ranges\n";
+  }
+
   return ss.str();
 }
 
 // Counts number of unique colors shown on screen.
 const size_t IFFReader::ILBM::ColorCount() const {
-  map<uint32_t, bool> colors;
-  for (unsigned int y = 0; y < height(); ++y) {
-    for (unsigned int x = 0; x < width(); ++x) {
-      colors[color_at(x, y)] = true;
-    }
+  return Statistics()->unique_colors;
+}
+
+shared_ptr<const IFFReader::ImageStatistics>
+IFFReader::ILBM::Statistics() const {
+  auto statistics = std::atomic_load(&statistics_);
+  if (!statistics) {
+    statistics = make_shared<const ImageStatistics>(ComputeStatistics());
+    std::atomic_store(&statistics_, statistics);
+  }
+  return statistics;
+}
+
+void IFFReader::ILBM::InvalidateStatistics() {
+  std::atomic_store(&statistics_, shared_ptr<const ImageStatistics>());
+}
+
+// Indexed images are summed up from their histogram. HAM and sliced images
+// are resolved a band at a time and their colors gathered in a bitset.
+const IFFReader::ImageStatistics IFFReader::ILBM::ComputeStatistics() const {
+  ImageStatistics statistics;
+  bool count_pixels = true;
+
+  if (HasIndexedOutput()) {
+    const auto indexed = GetIndexed();
+    const auto planes = min<uint16_t>(bitplanes_count(), 8);
+    const auto entries = min(indexed.palette.size(), size_t(1) << planes);
+
+    statistics.histogram = IndexHistogram(indexed);
+    SummarizeIndexed(indexed.palette, entries, statistics);
+    count_pixels = indexed.sliced;
   }
-  return colors.size();
+
+  if (count_pixels) {
+    ColorSet colors;
+    ThreadPool::Shared().ParallelFor(
+        0, height(), 16, [&](const size_t first, const size_t last) {
+          vector<uint32_t> band(width() * (last - first));
+          ResolveRows(static_cast<uint32_t>(first),
+                      static_cast<uint32_t>(last), band.data(), width());
+          colors.Add(band.data(), band.size());
+        });
+    statistics.unique_colors = colors.Count();
+  }
+
+  return statistics;
 }
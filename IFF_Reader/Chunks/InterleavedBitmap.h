@@ -1,11 +1,22 @@
 #pragma once
+#include "AspectScaler.h"
 #include "BitmapHeader.h"
 #include "Body.h"
 #include "Chunk.h"
+#include "ColorCycleTiming.h"
+#include "ColorCycler.h"
 #include "ColorMap.h"
 #include "ColorRange.h"
+#include "ColorTable.h"
 #include "CommodoreAmiga.h"
 #include "DynamicColorRange.h"
+#include "ImageStatistics.h"
+#include "IndexedImage.h"
+#include "PaletteChange.h"
+#include "PaletteTimeline.h"
+#include "PixelFormat.h"
+#include "PixelRunIndex.h"
+#include "SlicedHAM.h"
 #include "utility.h"
 
 #include <map>
@@ -16,7 +27,19 @@ using std::shared_ptr;
 namespace IFFReader {
 
 // List of recognized chunk types.
-enum class CHUNK_T { BMHD, CMAP, CAMG, BODY, CRNG, DRNG, UNKNOWN };
+enum class CHUNK_T {
+  BMHD,
+  CMAP,
+  CAMG,
+  BODY,
+  CRNG,
+  DRNG,
+  SHAM,
+  CTBL,
+  PCHG,
+  CCRT,
+  UNKNOWN
+};
 
 class ILBM : public CHUNK {
 private:
@@ -35,8 +58,12 @@ private:
   shared_ptr<CMAP> cmap_;
   shared_ptr<CAMG> camg_;
   shared_ptr<BODY> body_;
-  shared_ptr<CRNG> crng_;
-  shared_ptr<DRNG> drng_;
+  vector<shared_ptr<CRNG>> crng_;
+  vector<shared_ptr<DRNG>> drng_;
+  vector<shared_ptr<CCRT>> ccrt_;
+  shared_ptr<SHAM> sham_;
+  shared_ptr<CTBL> ctbl_;
+  shared_ptr<PCHG> pchg_;
 
   // Constructs supported ILBM chunks from stream.
   void FabricateChunks(bytestream &stream);
@@ -62,9 +89,39 @@ private:
   // Fabricates correct palette lookup table.
   shared_ptr<IFFReader::ColorLookup> ColorLookupFactory();
 
+  // Builds per-scanline palettes from SHAM, CTBL or PCHG (empty if none).
+  shared_ptr<const PaletteTimeline> PaletteTimelineFactory() const;
+
+  // Whether any chunk changes the palette down the screen.
+  const bool HasPaletteChanges() const;
+
+  // Collects cycling ranges from CRNG, DRNG and CCRT chunks.
+  shared_ptr<ColorCycler> ColorCyclerFactory() const;
+
+  // Color cycling state, shared with the color lookup.
+  shared_ptr<ColorCycler> color_cycler_;
+
+  // Pixel runs of cycling registers, built on first request.
+  shared_ptr<const PixelRunIndex> cycling_runs_;
+
+  // Statistics of the image as currently displayed, computed on request.
+  // Only accessed through atomic loads and stores.
+  mutable shared_ptr<const ImageStatistics> statistics_;
+
+  // Counts colors and palette usage in one pass over the image.
+  const ImageStatistics ComputeStatistics() const;
+
+  // Drops cached statistics after the palette changed.
+  void InvalidateStatistics();
+
 public:
   ILBM(bytestream &stream);
 
+  // Rebuilds an image from its chunks, BODY left empty, and the chunky
+  // indices decoded from it earlier (see DecodeCache.h). Indices missing
+  // for the size BMHD gives are taken as zero.
+  ILBM(bytestream &stream, vector<uint8_t> screen_data);
+
   // ILBM graphics functions. Replace with Displayable API, allowing
   // all image formats to display in the same way.
 
@@ -86,9 +143,68 @@ public:
   // Number of bitplanes, not including mask.
   const uint16_t bitplanes_count() const;
 
+  // Pixel width relative to pixel height, as x_aspect:y_aspect. Zero if the
+  // file does not say.
+  const uint8_t x_aspect() const;
+  const uint8_t y_aspect() const;
+
+  // Whether the image was drawn for an interlaced screen, going by CAMG.
+  const bool Interlaced() const;
+
+  // CAMG contents, or zero if the file has none.
+  const uint32_t ViewModes() const;
+
+  // Scaler that makes this image's pixels square.
+  const AspectScaler AspectCorrection(const ScaleFilter filter) const;
+
   // Access pixels.
   const uint32_t color_at(const unsigned int x, const unsigned int y) const;
 
+  // Resolves scanlines [first, last) into 0xAABBGGRR pixels, one row every
+  // stride pixels. Much faster than color_at for whole images.
+  void ResolveRows(const uint32_t first, const uint32_t last,
+                   uint32_t *destination, const size_t stride) const;
+
+  // As above, converted to the given format. Stride is in bytes.
+  void ResolveRows(const uint32_t first, const uint32_t last,
+                   const PixelFormat format, uint8_t *destination,
+                   const size_t stride) const;
+
+  // Whether pixels are palette indices. Not so for HAM, where most pixels
+  // modify the color to their left.
+  const bool HasIndexedOutput() const;
+
+  // Chunky indices and the palette they refer to, without expanding to
+  // colors. Indices stay valid for the lifetime of this object.
+  const IndexedImage GetIndexed() const;
+
+  // Chunky indices to draw into, width per row, as animations do for each
+  // frame. Call IndicesChanged once done.
+  uint8_t *MutableIndices();
+
+  // Drops what was built from the indices: statistics and cycling runs.
+  void IndicesChanged();
+
+  // Palette that indices on the given scanline refer to.
+  const vector<uint32_t> EffectivePalette(const uint32_t y) const;
+
+  // Whether the image has color ranges that actually cycle.
+  const bool HasColorCycling() const;
+
+  // Advances color cycling by the given time. Returns whether the palette
+  // changed; pixel indices never do.
+  const bool AdvanceColorCycling(const uint64_t microseconds);
+
+  // Returns cycled colors to where they started.
+  void ResetColorCycling();
+
+  // Flags palette registers whose colors may change while cycling.
+  const array<bool, 256> CyclingRegisters() const;
+
+  // Where the cycling registers are used in the image, as pixel runs. Built
+  // from the chunky indices the first time it is asked for.
+  const PixelRunIndex &CyclingRuns();
+
   // Whether OCS color correction is relevant.
   const bool allows_ocs_correction() const;
 
@@ -103,5 +219,9 @@ public:
 
   // Gets the number of colors currently displayed.
   const size_t ColorCount() const;
+
+  // Color count, index histogram and palette usage. Computed once and kept
+  // until the palette changes.
+  shared_ptr<const ImageStatistics> Statistics() const;
 };
 } // namespace IFFReader
@@ -0,0 +1,178 @@
+#include "PaletteChange.h"
+
+constexpr uint16_t PCHG_COMP_NONE = 0;
+constexpr uint16_t PCHG_COMP_HUFFMAN = 1;
+constexpr uint16_t PCHGF_12BIT = 0x1;
+constexpr uint16_t PCHGF_32BIT = 0x2;
+constexpr uint32_t PCHG_HEADER_SIZE = 20;
+
+// Big endian reads from an in-memory buffer. Out of range reads yield zero,
+// so truncated chunks decode as far as they go.
+static const uint32_t buffer_byte(const bytefield &data, const size_t pos) {
+  return pos < data.size() ? data[pos] : 0;
+}
+
+static const uint32_t buffer_word(const bytefield &data, const size_t pos) {
+  return (buffer_byte(data, pos) << 8) | buffer_byte(data, pos + 1);
+}
+
+static const uint32_t buffer_long(const bytefield &data, const size_t pos) {
+  return (buffer_word(data, pos) << 16) | buffer_word(data, pos + 2);
+}
+
+IFFReader::PCHG::PCHG()
+    : compression_(0), flags_(0), start_line_(0), line_count_(0),
+      changed_lines_(0), min_register_(0), max_register_(0), max_changes_(0),
+      total_changes_(0) {}
+
+IFFReader::PCHG::PCHG(bytestream &stream) : CHUNK(stream) {
+  compression_ = read_word(stream);
+  flags_ = read_word(stream);
+  start_line_ = static_cast<int16_t>(read_word(stream));
+  line_count_ = read_word(stream);
+  changed_lines_ = read_word(stream);
+  min_register_ = read_word(stream);
+  max_register_ = read_word(stream);
+  max_changes_ = read_word(stream);
+  total_changes_ = read_long(stream);
+
+  const auto body_size =
+      GetSize() > PCHG_HEADER_SIZE ? GetSize() - PCHG_HEADER_SIZE : 0;
+
+  bytefield body;
+  body.reserve(body_size);
+  for (uint32_t i = 0; i < body_size; ++i) {
+    body.emplace_back(read_byte(stream));
+  }
+  stream.ignore(GetSize() & 1); // Pad byte.
+
+  switch (compression_) {
+  case PCHG_COMP_NONE:
+    ParseChanges(body);
+    break;
+  case PCHG_COMP_HUFFMAN:
+    ParseChanges(Decompress(body));
+    break;
+  default:
+    break; // Unknown compression; leave the palette alone.
+  }
+}
+
+// The compressed form starts with the size of the tree and the size of the
+// unpacked data, followed by the tree (signed words) and the bit stream.
+// Decoding walks the tree from its last word; a set bit follows the
+// (negative) offset stored there, a clear bit steps one word back.
+const bytefield IFFReader::PCHG::Decompress(const bytefield &packed) const {
+  const auto tree_size = buffer_long(packed, 0);
+  const auto original_size = buffer_long(packed, 4);
+
+  bytefield unpacked;
+  if (tree_size < 2 || 8 + static_cast<uint64_t>(tree_size) > packed.size()) {
+    return unpacked;
+  }
+
+  vector<int16_t> tree(tree_size / 2);
+  for (size_t i = 0; i < tree.size(); ++i) {
+    tree[i] = static_cast<int16_t>(buffer_word(packed, 8 + i * 2));
+  }
+
+  const auto root = static_cast<int64_t>(tree.size()) - 1;
+  auto node = root;
+  auto source = 8 + static_cast<size_t>(tree_size);
+  uint8_t current_byte{0};
+  int bits_left{0};
+
+  unpacked.reserve(original_size);
+  while (unpacked.size() < original_size) {
+    if (bits_left == 0) {
+      if (source >= packed.size()) {
+        break; // Ran out of data.
+      }
+      current_byte = packed[source++];
+      bits_left = 8;
+    }
+
+    if (current_byte & 0x80) {
+      if (tree[node] >= 0) {
+        unpacked.push_back(static_cast<uint8_t>(tree[node]));
+        node = root;
+      } else {
+        node += tree[node] / 2;
+      }
+    } else {
+      --node;
+      if (node >= 0 && tree[node] > 0 && (tree[node] & 0x100)) {
+        unpacked.push_back(static_cast<uint8_t>(tree[node]));
+        node = root;
+      }
+    }
+
+    if (node < 0 || node > root) {
+      break; // Malformed tree.
+    }
+
+    current_byte <<= 1;
+    --bits_left;
+  }
+
+  return unpacked;
+}
+
+// Body starts with a bit mask (one bit per line, MSB first, padded to
+// longwords) telling which lines carry changes. Each such line then lists
+// its changes, either as 12-bit register words or as 32-bit entries.
+void IFFReader::PCHG::ParseChanges(const bytefield &data) {
+  const size_t mask_longs = (static_cast<size_t>(line_count_) + 31) / 32;
+  size_t pos = mask_longs * 4;
+
+  for (uint32_t line = 0; line < line_count_; ++line) {
+    const auto mask = buffer_long(data, (line / 32) * 4);
+    if (!(mask & (0x80000000u >> (line % 32)))) {
+      continue;
+    }
+
+    vector<ColorChange> changes;
+
+    if (flags_ & PCHGF_12BIT) {
+      // Changes to registers 0-15, then to registers 16-31.
+      const auto count16 = buffer_byte(data, pos);
+      const auto count32 = buffer_byte(data, pos + 1);
+      pos += 2;
+
+      for (uint32_t i = 0; i < count16 + count32; ++i) {
+        const auto word = buffer_word(data, pos);
+        pos += 2;
+
+        const auto bank = (i < count16) ? 0 : 16;
+        changes.push_back({static_cast<uint16_t>(bank + (word >> 12)),
+                           expand_rgb4(word & 0xfff)});
+      }
+    } else if (flags_ & PCHGF_32BIT) {
+      // Register word, then alpha, red, blue, green (sic).
+      const auto count = buffer_word(data, pos);
+      pos += 2;
+
+      for (uint32_t i = 0; i < count; ++i) {
+        const auto reg = buffer_word(data, pos);
+        const auto red = buffer_byte(data, pos + 3);
+        const auto blue = buffer_byte(data, pos + 4);
+        const auto green = buffer_byte(data, pos + 5);
+        pos += 6;
+
+        changes.push_back({static_cast<uint16_t>(reg),
+                           0xff000000 | (blue << 16) | (green << 8) | red});
+      }
+    }
+
+    if (pos > data.size()) {
+      return; // Truncated; the line we were reading is incomplete.
+    }
+
+    line_changes_[start_line_ + static_cast<int32_t>(line)] = move(changes);
+  }
+}
+
+const map<int32_t, vector<IFFReader::ColorChange>> &
+IFFReader::PCHG::GetLineChanges() const {
+  return line_changes_;
+}
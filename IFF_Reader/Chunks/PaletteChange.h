@@ -0,0 +1,42 @@
+#pragma once
+#include "Chunk.h"
+#include "PaletteTimeline.h"
+#include "utility.h"
+
+#include <map>
+
+using std::map;
+
+namespace IFFReader {
+
+// Palette change chunk. Lists, for each scanline that has any, the color
+// registers the copper should rewrite before that line is displayed.
+// [http://wiki.amigaos.net/wiki/ILBM_IFF_Interleaved_Bitmap#PCHG]
+class PCHG : public CHUNK {
+  uint16_t compression_; // 0 = none, 1 = Huffman
+  uint16_t flags_;       // 1 = 12 bit changes, 2 = 32 bit changes
+  int16_t start_line_;   // May be negative (above the image)
+  uint16_t line_count_;
+  uint16_t changed_lines_;
+  uint16_t min_register_;
+  uint16_t max_register_;
+  uint16_t max_changes_;
+  uint32_t total_changes_;
+
+  // Register changes, keyed by scanline.
+  map<int32_t, vector<ColorChange>> line_changes_;
+
+  // Undoes PCHG Huffman compression; tree is read as signed words.
+  const bytefield Decompress(const bytefield &packed) const;
+
+  // Reads line mask and changes from the (decompressed) chunk body.
+  void ParseChanges(const bytefield &data);
+
+public:
+  PCHG();
+  PCHG(bytestream &stream);
+
+  // Register changes, keyed by scanline. Colors are 0xAABBGGRR.
+  const map<int32_t, vector<ColorChange>> &GetLineChanges() const;
+};
+} // namespace IFFReader
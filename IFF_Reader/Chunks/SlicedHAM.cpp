@@ -0,0 +1,33 @@
+#include "SlicedHAM.h"
+#include <algorithm>
+
+IFFReader::SHAM::SHAM() : version_(0) {}
+
+// Layout is a version word, then 16 color words (0x0RGB) per line.
+// Sizes too short for the version word, or longer than the stream, are
+// read as far as they go.
+IFFReader::SHAM::SHAM(bytestream &stream) : CHUNK(stream), version_(0) {
+  if (GetSize() < 2) {
+    stream.ignore(GetSize() + (GetSize() & 1));
+    return;
+  }
+  version_ = read_word(stream);
+
+  const auto body_size = GetSize() - 2;
+  const auto line_count =
+      std::min<uint64_t>(body_size, remaining_bytes(stream)) / 32;
+  for (uint32_t line = 0; line < line_count; ++line) {
+    vector<uint32_t> palette;
+    for (int i = 0; i < 16; ++i) {
+      palette.push_back(expand_rgb4(read_word(stream)));
+    }
+    line_palettes_.emplace_back(move(palette));
+  }
+
+  // Skip remainder, including the pad byte of odd-sized chunks.
+  stream.ignore(body_size - line_count * 32 + (GetSize() & 1));
+}
+
+const vector<vector<uint32_t>> &IFFReader::SHAM::GetLinePalettes() const {
+  return line_palettes_;
+}
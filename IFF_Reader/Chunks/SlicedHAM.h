@@ -0,0 +1,20 @@
+#pragma once
+#include "Chunk.h"
+#include "utility.h"
+
+namespace IFFReader {
+
+// Sliced HAM. Holds a 16-color palette for every scanline (or, for
+// interlaced images, every other scanline), replacing the HAM base colors.
+class SHAM : public CHUNK {
+  uint16_t version_;
+  vector<vector<uint32_t>> line_palettes_;
+
+public:
+  SHAM();
+  SHAM(bytestream &stream);
+
+  // One palette per line, in 0xAABBGGRR format.
+  const vector<vector<uint32_t>> &GetLinePalettes() const;
+};
+} // namespace IFFReader
@@ -0,0 +1,45 @@
+#include "ColorCycleTiming.h"
+#include <algorithm>
+
+using std::min;
+
+CCRT::CCRT()
+    : direction_(0), start_(0), end_(0), seconds_(0), microseconds_(0) {}
+
+// A chunk too short for the fields is skipped whole, leaving cycling off.
+CCRT::CCRT(bytestream &stream)
+    : CHUNK(stream), direction_(0), start_(0), end_(0), seconds_(0),
+      microseconds_(0) {
+  if (GetSize() < 12) {
+    stream.ignore(GetSize() + (GetSize() & 1));
+    return;
+  }
+
+  direction_ = static_cast<int16_t>(IFFReader::read_word(stream));
+  start_ = IFFReader::read_byte(stream);
+  end_ = IFFReader::read_byte(stream);
+  seconds_ = IFFReader::read_long(stream);
+  microseconds_ = IFFReader::read_long(stream);
+
+  // Remainder is padding.
+  if (GetSize() > 12) {
+    stream.ignore(GetSize() - 12 + (GetSize() & 1));
+  }
+}
+
+const IFFReader::CycleRange CCRT::GetRange() const {
+  IFFReader::CycleRange range;
+
+  for (int r = start_; r <= end_; ++r) {
+    range.registers.push_back(static_cast<uint8_t>(r));
+  }
+
+  const auto duration =
+      static_cast<uint64_t>(seconds_) * 1000000 + microseconds_;
+  range.step_duration = static_cast<uint32_t>(
+      min<uint64_t>(duration, UINT32_MAX));
+  range.reverse = direction_ < 0;
+  range.active = direction_ != 0;
+
+  return range;
+}
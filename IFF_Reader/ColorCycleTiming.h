@@ -0,0 +1,19 @@
+#pragma once
+#include "Chunk.h"
+#include "ColorCycler.h"
+
+// Color cycling range and timing, as written by Graphicraft.
+class CCRT : public IFFReader::CHUNK {
+  int16_t direction_;      // 0 = don't cycle, 1 = forward, -1 = backward
+  uint8_t start_;          // First register of range
+  uint8_t end_;            // Last register of range
+  uint32_t seconds_;       // Time between steps...
+  uint32_t microseconds_;  // ...plus this
+
+public:
+  CCRT();
+  CCRT(bytestream &stream);
+
+  // Normalized cycling range.
+  const IFFReader::CycleRange GetRange() const;
+};
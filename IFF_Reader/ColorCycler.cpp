@@ -0,0 +1,93 @@
+#include "ColorCycler.h"
+
+IFFReader::ColorCycler::ColorCycler(const vector<CycleRange> &ranges)
+    : ranges_(ranges), pending_(ranges.size(), 0), steps_(ranges.size(), 0) {
+}
+
+// A range that is inactive, has no rate or fewer than two registers stays
+// put. Long pauses step several times at once.
+const bool IFFReader::ColorCycler::Advance(const uint64_t microseconds) {
+  bool stepped = false;
+
+  for (size_t i = 0; i < ranges_.size(); ++i) {
+    const auto &range = ranges_[i];
+    if (!range.active || range.step_duration == 0 ||
+        range.registers.size() < 2) {
+      continue;
+    }
+
+    pending_[i] += microseconds;
+    const auto steps = pending_[i] / range.step_duration;
+    if (steps == 0) {
+      continue;
+    }
+
+    pending_[i] %= range.step_duration;
+    steps_[i] = (steps_[i] + steps) % range.registers.size();
+    stepped = true;
+  }
+
+  return stepped;
+}
+
+void IFFReader::ColorCycler::Reset() {
+  pending_.assign(ranges_.size(), 0);
+  steps_.assign(ranges_.size(), 0);
+}
+
+// Forward cycling moves each color one register up, the last one wrapping
+// around to the first; after n steps, the color of register i shows in
+// register i + n. Reverse cycling does the opposite.
+void IFFReader::ColorCycler::Apply(vector<uint32_t> &palette) const {
+  vector<uint32_t> original;
+
+  for (size_t i = 0; i < ranges_.size(); ++i) {
+    const auto &registers = ranges_[i].registers;
+    const auto count = registers.size();
+    if (steps_[i] == 0 || count < 2) {
+      continue;
+    }
+
+    original.clear();
+    for (const auto r : registers) {
+      original.push_back(r < palette.size() ? palette[r] : 0xff000000);
+    }
+
+    const auto shift = ranges_[i].reverse ? count - steps_[i] : steps_[i];
+    for (size_t n = 0; n < count; ++n) {
+      const auto target = registers[(n + shift) % count];
+      if (target < palette.size()) {
+        palette[target] = original[n];
+      }
+    }
+  }
+}
+
+const bool IFFReader::ColorCycler::HasActiveRanges() const {
+  for (const auto &range : ranges_) {
+    if (range.active && range.step_duration != 0 &&
+        range.registers.size() > 1) {
+      return true;
+    }
+  }
+  return false;
+}
+
+const array<bool, 256> IFFReader::ColorCycler::ActiveRegisters() const {
+  array<bool, 256> active{false};
+
+  for (const auto &range : ranges_) {
+    if (range.active && range.step_duration != 0 &&
+        range.registers.size() > 1) {
+      for (const auto r : range.registers) {
+        active[r] = true;
+      }
+    }
+  }
+  return active;
+}
+
+const vector<IFFReader::CycleRange> &
+IFFReader::ColorCycler::GetRanges() const {
+  return ranges_;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using std::array;
+using std::vector;
+
+/*
+ * Color cycling animates an image without touching its pixels. A range of
+ * color registers is rotated at a fixed rate, so that whatever is drawn in
+ * those colors appears to move: waterfalls, fire, blinking lights.
+ *
+ * DPaint stores ranges as CRNG (or DRNG, for DPaint IV) chunks, Graphicraft
+ * as CCRT. All of them are normalized into CycleRange descriptors here.
+ */
+namespace IFFReader {
+
+// One cycling range: which registers rotate, how often and which way.
+struct CycleRange {
+  // Registers taking part, in cycling order.
+  vector<uint8_t> registers;
+
+  // Time between steps, in microseconds.
+  uint32_t step_duration = 0;
+
+  // Colors move towards lower registers, rather than higher ones.
+  bool reverse = false;
+
+  // Range is switched on in the file.
+  bool active = false;
+};
+
+// Keeps track of the rotation of every range as time passes, and applies
+// it to palettes on request. Rotation never changes pixel indices, only the
+// colors behind them.
+class ColorCycler {
+  vector<CycleRange> ranges_;
+
+  // Time accumulated towards the next step, per range.
+  vector<uint64_t> pending_;
+
+  // Steps taken so far, per range (modulo range length).
+  vector<size_t> steps_;
+
+public:
+  ColorCycler(const vector<CycleRange> &ranges);
+
+  // Lets time pass. Returns whether any range stepped.
+  const bool Advance(const uint64_t microseconds);
+
+  // Returns all ranges to their initial position.
+  void Reset();
+
+  // Rotates palette entries according to the current position.
+  void Apply(vector<uint32_t> &palette) const;
+
+  // Whether any range would actually move.
+  const bool HasActiveRanges() const;
+
+  // Flags every register that belongs to an active range.
+  const array<bool, 256> ActiveRegisters() const;
+
+  // Ranges as read from the file.
+  const vector<CycleRange> &GetRanges() const;
+};
+} // namespace IFFReader
@@ -3,6 +3,11 @@
 
 using std::all_of;
 using std::for_each;
+using std::max;
+using std::min;
+
+// Resolvers index palettes without bounds checks; palettes are padded to this.
+constexpr size_t PADDED_PALETTE_SIZE = 256;
 
 IFFReader::ColorLookup::ColorLookup(const vector<uint32_t> &colors,
   const vector<uint8_t> &data,
@@ -12,7 +17,7 @@ IFFReader::ColorLookup::ColorLookup(const vector<uint32_t> &colors,
   : colors_(colors), colors_scratch_(colors), data_(data),
   scanline_width_(width), bitplane_count_(bitplanes),
   lower_nibble_zero_(false), color_correction_enabled_(false),
-  chipset_(chipset)
+  chipset_(chipset), row_colors_y_(0)
 {
   // Some OCS files are saved incorrectly, with only the high nibble set.
   // If that's detected (i.e. all low nibbles are 0), then we offer
@@ -22,6 +27,8 @@ IFFReader::ColorLookup::ColorLookup(const vector<uint32_t> &colors,
     [](uint32_t c) { return (0x000f0f0f & c) == 0; });
 }
 
+IFFReader::ColorLookup::~ColorLookup() {}
+
 // Yields the base palette.
 const vector<uint32_t> &IFFReader::ColorLookup::GetColors() const
 {
@@ -46,7 +53,103 @@ const uint32_t IFFReader::ColorLookup::at(const uint32_t x, const uint32_t y) {
     (static_cast<uint64_t>(y) * static_cast<uint64_t>(Width())) +
     static_cast<uint64_t>(x));
 
-  return colors_scratch_.at(GetData().at(index));
+  return RowColors(y).at(GetData().at(index));
+}
+
+// Without slicing, every scanline shares the base palette. Otherwise the
+// palette of the last scanline looked up is kept, and stepping to the next
+// one only applies that line's changes.
+const vector<uint32_t> &IFFReader::ColorLookup::RowColors(const uint32_t y) {
+  if (!timeline_) {
+    return colors_scratch_;
+  }
+
+  if (row_colors_.empty() || y != row_colors_y_) {
+    if (!row_colors_.empty() && y == row_colors_y_ + 1) {
+      timeline_->Advance(y, row_colors_);
+    } else {
+      row_colors_ = timeline_->PaletteAt(y);
+    }
+    row_colors_y_ = y;
+    row_colors_scratch_ = row_colors_;
+
+    if (cycler_) {
+      cycler_->Apply(row_colors_scratch_);
+    }
+
+    if (color_correction_enabled_) {
+      for (auto &c : row_colors_scratch_) {
+        c |= ((c & 0x00f0f0f0) >> 4);
+      }
+    }
+  }
+  return row_colors_scratch_;
+}
+
+void IFFReader::ColorLookup::PreparePalette(vector<uint32_t> &palette) const {
+  if (cycler_) {
+    cycler_->Apply(palette);
+  }
+
+  if (color_correction_enabled_) {
+    for (auto &c : palette) {
+      c |= ((c & 0x00f0f0f0) >> 4);
+    }
+  }
+
+  ExpandPalette(palette);
+}
+
+void IFFReader::ColorLookup::FinishPalette(vector<uint32_t> &palette) const {
+  PreparePalette(palette);
+
+  if (palette.size() < PADDED_PALETTE_SIZE) {
+    palette.resize(PADDED_PALETTE_SIZE, 0xff000000);
+  }
+}
+
+// Plain images show the palette as is.
+void IFFReader::ColorLookup::ExpandPalette(vector<uint32_t> &palette) const {}
+
+// Plain images map each index straight to its palette entry.
+void IFFReader::ColorLookup::ResolveRow(const uint32_t y,
+                                        const vector<uint32_t> &palette,
+                                        uint32_t *destination) const {
+  const auto &data = GetData();
+  const auto offset = static_cast<size_t>(y) * Width();
+  if (offset >= data.size()) {
+    return;
+  }
+
+  const auto count = min(static_cast<size_t>(Width()), data.size() - offset);
+  const auto *row = data.data() + offset;
+  const auto *colors = palette.data();
+
+  for (size_t x = 0; x < count; ++x) {
+    destination[x] = colors[row[x]];
+  }
+}
+
+// Palette is rebuilt once for the first row; after that, each row costs
+// only the register changes the copper made on that line.
+void IFFReader::ColorLookup::ResolveRows(const uint32_t first,
+                                         const uint32_t last,
+                                         uint32_t *destination,
+                                         const size_t stride) const {
+  vector<uint32_t> raw = timeline_ ? timeline_->PaletteAt(first) : colors_;
+  vector<uint32_t> palette(raw);
+  FinishPalette(palette);
+
+  for (auto y = first; y < last; ++y) {
+    if (timeline_ && y != first) {
+      timeline_->Advance(y, raw);
+      palette.assign(begin(raw), end(raw));
+      FinishPalette(palette);
+    }
+
+    ResolveRow(y, palette,
+      destination + static_cast<size_t>(y - first) * stride);
+  }
 }
 
 // OCS images are sometimes stored incorrectly, with the low nibbles
@@ -54,9 +157,19 @@ const uint32_t IFFReader::ColorLookup::at(const uint32_t x, const uint32_t y) {
 // high nibbles to low nibbles. If not, we use the unmodified list.
 void IFFReader::ColorLookup::AdjustForOCS(const bool adjust) {
   color_correction_enabled_ = adjust; // Store choice.
-  colors_scratch_ = colors_;          // Restore original palette.
+  RefreshPalette();
+}
+
+// Rebuilds the palette used by at() from the original one.
+void IFFReader::ColorLookup::RefreshPalette() {
+  colors_scratch_ = colors_; // Restore original palette.
+  row_colors_.clear();       // Sliced palettes are rebuilt on next lookup.
 
-  if (adjust == false) {
+  if (cycler_) {
+    cycler_->Apply(colors_scratch_);
+  }
+
+  if (color_correction_enabled_ == false) {
     return;
   }
 
@@ -81,6 +194,29 @@ const IFFReader::BasicChipset IFFReader::ColorLookup::Chipset() const {
   return chipset_;
 }
 
+void IFFReader::ColorLookup::SetPaletteTimeline(
+  const shared_ptr<const PaletteTimeline> &timeline) {
+  timeline_ = timeline;
+  row_colors_.clear();
+}
+
+const bool IFFReader::ColorLookup::Sliced() const {
+  return timeline_ != nullptr;
+}
+
+void IFFReader::ColorLookup::SetColorCycler(
+  const shared_ptr<const ColorCycler> &cycler) {
+  cycler_ = cycler;
+  RefreshPalette();
+}
+
+const vector<uint32_t>
+IFFReader::ColorLookup::EffectivePalette(const uint32_t y) const {
+  vector<uint32_t> palette = timeline_ ? timeline_->PaletteAt(y) : colors_;
+  PreparePalette(palette);
+  return palette;
+}
+
 IFFReader::ColorLookupEHB::ColorLookupEHB(const vector<uint32_t> &colors,
   const vector<uint8_t> &data,
   const uint32_t width,
@@ -91,8 +227,12 @@ IFFReader::ColorLookupEHB::ColorLookupEHB(const vector<uint32_t> &colors,
 // Looks up a color at the given pixel position.
 const uint32_t IFFReader::ColorLookupEHB::at(const uint32_t x,
   const uint32_t y) {
-  const auto value = GetData().at(Width());
-  const auto &colors = GetColors();
+  const auto index = static_cast<uint32_t>(
+    (static_cast<uint64_t>(y) * static_cast<uint64_t>(Width())) +
+    static_cast<uint64_t>(x));
+
+  const auto value = GetData().at(index);
+  const auto &colors = RowColors(y);
 
   // For colors 32-63, halve each regular color value.
   return (value < colors.size())
@@ -100,6 +240,19 @@ const uint32_t IFFReader::ColorLookupEHB::at(const uint32_t x,
     : ((colors.at(value - 32) >> 1) | 0xFF000000) & 0xFF777777;
 }
 
+// Entries past the defined colors become halved copies of the first 32.
+void IFFReader::ColorLookupEHB::ExpandPalette(vector<uint32_t> &palette) const {
+  const auto defined = palette.size();
+  if (defined >= 64) {
+    return;
+  }
+
+  palette.resize(64, 0xff000000);
+  for (auto i = max(defined, static_cast<size_t>(32)); i < 64; ++i) {
+    palette[i] = ((palette[i - 32] >> 1) | 0xFF000000) & 0xFF777777;
+  }
+}
+
 IFFReader::ColorLookupHAM::ColorLookupHAM(const vector<uint32_t> &colors,
   const vector<uint8_t> &data,
   const uint16_t width_of_scanline,
@@ -132,7 +285,7 @@ const uint32_t IFFReader::ColorLookupHAM::at(const uint32_t x,
   // If the first pixel of a scan line, assume previous colour
   // is equal to palette index 0.
   if (HAM_flag != HAMmode::AsRegularColor && x == 0) {
-    previous_color_ = GetColors().at(0);
+    previous_color_ = RowColors(y).at(0);
   }
 
   // This is the new color value for the modified bit. This works slightly
@@ -149,7 +302,7 @@ const uint32_t IFFReader::ColorLookupHAM::at(const uint32_t x,
 
   switch (HAM_flag) {
   case HAMmode::AsRegularColor:
-    previous_color_ = GetColors().at(given_value);
+    previous_color_ = RowColors(y).at(given_value);
     break;
   case HAMmode::ModifyBlue: // modify blue (hold red and green)
     previous_color_ = ((previous_color_ & 0xff00ffff) | (modify_value << 16));
@@ -164,3 +317,54 @@ const uint32_t IFFReader::ColorLookupHAM::at(const uint32_t x,
 
   return previous_color_;
 }
+
+// Same rules as at(), but walking the whole scanline at once with the
+// held color in a register.
+void IFFReader::ColorLookupHAM::ResolveRow(const uint32_t y,
+  const vector<uint32_t> &palette,
+  uint32_t *destination) const
+{
+  const auto &data = GetData();
+  const auto offset = static_cast<size_t>(y) * Width();
+  if (offset >= data.size()) {
+    return;
+  }
+
+  const auto count = min(static_cast<size_t>(Width()), data.size() - offset);
+  const auto *row = data.data() + offset;
+  const auto *colors = palette.data();
+
+  const auto is_aga = Chipset() == BasicChipset::AGA;
+  const auto flag_shift = is_aga ? 6 : 4;
+  const uint8_t modify_mask = is_aga ? 0x3f : 0xf;
+
+  // Scanlines start out holding palette index 0.
+  uint32_t held = colors[0];
+
+  for (size_t x = 0; x < count; ++x) {
+    const auto given_value = row[x];
+    const uint32_t modify_part = given_value & modify_mask;
+    const uint32_t modify_value = is_aga
+      ? (modify_part << 2) | (modify_part >> 4)
+      : modify_part | (modify_part << 4);
+
+    switch (given_value >> flag_shift) {
+    case 0: // Regular color
+      held = colors[given_value];
+      break;
+    case 1: // Modify blue
+      held = (held & 0xff00ffff) | (modify_value << 16);
+      break;
+    case 2: // Modify red
+      held = (held & 0xffffff00) | modify_value;
+      break;
+    case 3: // Modify green
+      held = (held & 0xffff00ff) | (modify_value << 8);
+      break;
+    default:
+      break;
+    }
+
+    destination[x] = held;
+  }
+}
@@ -1,8 +1,12 @@
 #pragma once
+#include "ColorCycler.h"
+#include "PaletteTimeline.h"
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 using std::reference_wrapper;
+using std::shared_ptr;
 using std::vector;
 
 /*
@@ -54,10 +58,43 @@ class ColorLookup {
 
   uint32_t scanline_width_;
 
+  // Per-scanline palette changes (SHAM, CTBL, PCHG), if any.
+  shared_ptr<const PaletteTimeline> timeline_;
+
+  // Color cycling state, if any.
+  shared_ptr<const ColorCycler> cycler_;
+
+  // Palette of the scanline most recently looked up through at(), before
+  // and after OCS correction.
+  vector<uint32_t> row_colors_;
+  vector<uint32_t> row_colors_scratch_;
+  uint32_t row_colors_y_;
+
+  // Applies color cycling, OCS correction if enabled, and mode specific
+  // expansion.
+  void PreparePalette(vector<uint32_t> &palette) const;
+
+  // As PreparePalette, then pads the palette for unchecked lookups.
+  void FinishPalette(vector<uint32_t> &palette) const;
+
+protected:
+  // Palette in effect on the given scanline, OCS correction included.
+  const vector<uint32_t> &RowColors(const uint32_t y);
+
+  // Turns the raw palette of a scanline into the colors actually shown.
+  // The palette is padded to 256 entries afterwards, so resolvers need
+  // no bounds checks.
+  virtual void ExpandPalette(vector<uint32_t> &palette) const;
+
+  // Resolves one scanline of indices to colors, using the given palette.
+  virtual void ResolveRow(const uint32_t y, const vector<uint32_t> &palette,
+                          uint32_t *destination) const;
+
 public:
   ColorLookup(const vector<uint32_t> &colors, const vector<uint8_t> &data,
               const uint32_t width, const uint16_t bitplanes,
               const BasicChipset chipset);
+  virtual ~ColorLookup();
 
   // Yields base palette.
   const vector<uint32_t> &GetColors() const;
@@ -83,6 +120,27 @@ public:
   const uint32_t Width() const;
 
   const BasicChipset Chipset() const;
+
+  // Lets the palette change from one scanline to the next.
+  void SetPaletteTimeline(const shared_ptr<const PaletteTimeline> &timeline);
+
+  // Whether the palette changes down the screen.
+  const bool Sliced() const;
+
+  // Rotates palette entries as the cycler says.
+  void SetColorCycler(const shared_ptr<const ColorCycler> &cycler);
+
+  // Picks up palette changes made by the cycler since the last call.
+  void RefreshPalette();
+
+  // Colors the indices of the given scanline refer to: OCS corrected if
+  // enabled, EHB expanded to 64 entries. Same for every line unless sliced.
+  const vector<uint32_t> EffectivePalette(const uint32_t y) const;
+
+  // Resolves scanlines [first, last) to colors (0xAABBGGRR), writing one row
+  // every stride pixels. Safe to call from several threads at once.
+  void ResolveRows(const uint32_t first, const uint32_t last,
+                   uint32_t *destination, const size_t stride) const;
 };
 
 // Extra halfbrite does color in a weird way. It uses 32 colors, and one
@@ -90,6 +148,10 @@ public:
 // with each color being a repeat of the one in the previous series,
 // only at halved brightness.
 class ColorLookupEHB : public ColorLookup {
+protected:
+  // Adds the 32 halfbrite colors.
+  void ExpandPalette(vector<uint32_t> &palette) const override;
+
 public:
   ColorLookupEHB(const vector<uint32_t> &colors, const vector<uint8_t> &data,
                  const uint32_t width_of_scanline, const uint16_t bitplanes,
@@ -108,6 +170,11 @@ class ColorLookupHAM : public ColorLookup {
   uint32_t previous_color_;
   uint32_t scanline_length_;
 
+protected:
+  // Resolves one scanline, holding and modifying from left to right.
+  void ResolveRow(const uint32_t y, const vector<uint32_t> &palette,
+                  uint32_t *destination) const override;
+
 public:
   ColorLookupHAM(const vector<uint32_t> &colors, const vector<uint8_t> &data,
                  const uint16_t width_of_scanline, const uint16_t bitplanes,
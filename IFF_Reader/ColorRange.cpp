@@ -1,7 +1,41 @@
 #include "ColorRange.h"
 
-CRNG::CRNG() {}
+constexpr uint16_t RNG_ACTIVE = 0x1;
+constexpr uint16_t RNG_REVERSE = 0x2;
+
+// Rates are given in steps per 1/60 seconds, times 16384.
+constexpr uint64_t RNG_NORM = 16384;
+constexpr uint64_t JIFFIES_PER_SECOND = 60;
+
+CRNG::CRNG() : rate_(0), flags_(0), low_(0), high_(0) {}
 
 CRNG::CRNG(bytestream &stream) : CHUNK(stream) {
-	stream.ignore(GetSize()); // Not yet implemented.
+  stream.ignore(2); // Padding
+  rate_ = IFFReader::read_word(stream);
+  flags_ = IFFReader::read_word(stream);
+  low_ = IFFReader::read_byte(stream);
+  high_ = IFFReader::read_byte(stream);
+
+  if (GetSize() > 8) {
+    stream.ignore(GetSize() - 8 + (GetSize() & 1));
+  }
+}
+
+const IFFReader::CycleRange CRNG::GetRange() const {
+  IFFReader::CycleRange range;
+
+  for (int r = low_; r <= high_; ++r) {
+    range.registers.push_back(static_cast<uint8_t>(r));
+  }
+
+  if (rate_ != 0) {
+    range.step_duration = static_cast<uint32_t>(
+        (RNG_NORM * 1000000) /
+        (static_cast<uint64_t>(rate_) * JIFFIES_PER_SECOND));
+  }
+
+  range.reverse = flags_ & RNG_REVERSE;
+  range.active = flags_ & RNG_ACTIVE;
+
+  return range;
 }
@@ -1,9 +1,18 @@
 #pragma once
 #include "Chunk.h"
+#include "ColorCycler.h"
 
+// Color range, as written by DPaint.
 class CRNG : public IFFReader::CHUNK {
+  uint16_t rate_;  // 16384 = 60 steps per second
+  uint16_t flags_; // 1 = active, 2 = reverse
+  uint8_t low_;    // First register of range
+  uint8_t high_;   // Last register of range
 
 public:
   CRNG();
   CRNG(bytestream &stream);
+
+  // Normalized cycling range.
+  const IFFReader::CycleRange GetRange() const;
 };
@@ -0,0 +1,412 @@
+#include "DecodeCache.h"
+#include "FileData.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+using std::make_shared;
+
+constexpr char SIDECAR_MAGIC[8] = {'I', 'F', 'F', 'C', 'A', 'C', 'H', 'E'};
+constexpr uint32_t SIDECAR_VERSION = 2;
+
+// Fixed part at the start of a sidecar, in the machine's byte order.
+// Offsets are from the start of the file; sizes are in bytes.
+struct SidecarHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t reserved;
+  uint64_t source_size;
+  int64_t source_time;
+  uint64_t source_hash;
+  uint64_t path_offset;
+  uint64_t path_size;
+  uint64_t chunks_offset;
+  uint64_t chunks_size;
+  uint64_t indices_offset;
+  uint64_t indices_size;
+};
+
+// 64-bit hash, eight bytes at a time. Not cryptographic; it only has to
+// notice files changed behind the cache's back.
+static const uint64_t Hash64(const uint8_t *data, const size_t size) {
+  uint64_t hash = 0x9e3779b97f4a7c15ull ^ size;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+    hash ^= hash >> 32;
+  }
+
+  uint64_t tail = 0;
+  std::memcpy(&tail, data + i, size - i);
+  hash = (hash ^ tail) * 0xc4ceb9fe1a85ec53ull;
+  return hash ^ (hash >> 29);
+}
+
+static const uint32_t BigEndianLong(const uint8_t *bytes) {
+  return static_cast<uint32_t>(bytes[0]) << 24 |
+         static_cast<uint32_t>(bytes[1]) << 16 |
+         static_cast<uint32_t>(bytes[2]) << 8 | bytes[3];
+}
+
+// Calls visit(chunk, end) for every chunk in [data, data + size), chunk
+// pointing at its tag and end past its pad byte. A chunk running past the
+// end is cut short.
+template <typename Visit>
+static void ForEachChunk(const uint8_t *data, const size_t size,
+                         const Visit &visit) {
+  size_t position = 0;
+  while (position + 8 <= size) {
+    const uint64_t length = BigEndianLong(data + position + 4);
+    const auto end = static_cast<size_t>(
+        std::min<uint64_t>(size, position + 8 + length + (length & 1)));
+    visit(data + position, data + end);
+    position = end;
+  }
+}
+
+// Whether the bytes start a FORM ILBM, going by the first twelve.
+static const bool IsFormILBM(const uint8_t *data, const size_t size) {
+  return size >= 12 && std::memcmp(data, "FORM", 4) == 0 &&
+         std::memcmp(data + 8, "ILBM", 4) == 0;
+}
+
+// The chunks of a FORM ILBM in the order found, but with BODY emptied and
+// moved last, where parsing stops. Empty if contents are not a FORM ILBM.
+static const bytefield ChunksWithoutBody(const bytefield &contents) {
+  if (!IsFormILBM(contents.data(), contents.size())) {
+    return bytefield();
+  }
+
+  bytefield chunks;
+  ForEachChunk(contents.data() + 12, contents.size() - 12,
+               [&](const uint8_t *chunk, const uint8_t *end) {
+                 if (std::memcmp(chunk, "BODY", 4) != 0) {
+                   chunks.insert(chunks.end(), chunk, end);
+                 }
+               });
+
+  const char body[] = {'B', 'O', 'D', 'Y', 0, 0, 0, 0};
+  chunks.insert(chunks.end(), body, body + sizeof(body));
+  return chunks;
+}
+
+// The first twelve bytes are enough to tell other forms (ANIM, 8SVX...)
+// apart, which are neither stored nor hashed.
+static const bool IsILBMFile(const fs::path &path) {
+  std::ifstream stream(path, std::ios::binary);
+  char head[12];
+  stream.read(head, sizeof(head));
+  return stream && IsFormILBM(reinterpret_cast<const uint8_t *>(head),
+                              sizeof(head));
+}
+
+static const bool ReadContents(const fs::path &path, bytefield &contents) {
+  std::ifstream stream(path, std::ios::binary | std::ios::ate);
+  if (!stream.is_open()) {
+    return false;
+  }
+
+  contents.resize(static_cast<size_t>(stream.tellg()));
+  stream.seekg(0);
+  stream.read(reinterpret_cast<char *>(contents.data()),
+              static_cast<std::streamsize>(contents.size()));
+  return static_cast<bool>(stream);
+}
+
+// Absolute, so that the same file is found the same way from anywhere.
+static const string SourceName(const fs::path &source) {
+  return fs::absolute(source).lexically_normal().generic_string();
+}
+
+static const int64_t SourceTime(const fs::path &source,
+                                std::error_code &error) {
+  return static_cast<int64_t>(
+      fs::last_write_time(source, error).time_since_epoch().count());
+}
+
+static const bool InFile(const uint64_t offset, const uint64_t size,
+                         const uintmax_t file_size) {
+  return offset <= file_size && size <= file_size - offset;
+}
+
+// Everything that can be checked without reading more than the header.
+static const bool Matches(const SidecarHeader &header,
+                          const uintmax_t file_size, const fs::path &source) {
+  if (std::memcmp(header.magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC)) != 0 ||
+      header.version != SIDECAR_VERSION ||
+      header.indices_size !=
+          static_cast<uint64_t>(header.width) * header.height ||
+      !InFile(header.path_offset, header.path_size, file_size) ||
+      !InFile(header.chunks_offset, header.chunks_size, file_size) ||
+      !InFile(header.indices_offset, header.indices_size, file_size)) {
+    return false;
+  }
+
+  std::error_code error;
+  const auto size = fs::file_size(source, error);
+  if (error || size != header.source_size) {
+    return false;
+  }
+  const auto time = SourceTime(source, error);
+  return !error && time == header.source_time;
+}
+
+static const bool ReadAt(std::ifstream &stream, const uint64_t offset,
+                         const uint64_t size, void *out) {
+  stream.seekg(static_cast<std::streamoff>(offset));
+  stream.read(static_cast<char *>(out), static_cast<std::streamsize>(size));
+  return static_cast<bool>(stream);
+}
+
+// The image stored in the sidecar, if it is one for the source as its
+// contents are now. The indices are read straight into the image's own.
+static shared_ptr<IFFReader::ILBM> LoadSidecar(const fs::path &sidecar,
+                                               const fs::path &source,
+                                               const bytefield &contents) {
+  std::error_code error;
+  const auto file_size = fs::file_size(sidecar, error);
+  std::ifstream stream(sidecar, std::ios::binary);
+  SidecarHeader header;
+  if (error || file_size < sizeof(header) || !stream.is_open() ||
+      !ReadAt(stream, 0, sizeof(header), &header) ||
+      !Matches(header, file_size, source)) {
+    return nullptr;
+  }
+
+  const auto path = SourceName(source);
+  string stored_path(static_cast<size_t>(header.path_size), '\0');
+  if (!ReadAt(stream, header.path_offset, header.path_size,
+              stored_path.data()) ||
+      stored_path != path) {
+    return nullptr;
+  }
+
+  // Contents are hashed last, as the only check that reads the whole source.
+  if (Hash64(contents.data(), contents.size()) != header.source_hash) {
+    return nullptr;
+  }
+
+  bytefield chunks(static_cast<size_t>(header.chunks_size));
+  vector<uint8_t> indices(static_cast<size_t>(header.indices_size));
+  if (!ReadAt(stream, header.chunks_offset, header.chunks_size,
+              chunks.data()) ||
+      !ReadAt(stream, header.indices_offset, header.indices_size,
+              indices.data())) {
+    return nullptr;
+  }
+
+  auto has_header = false;
+  ForEachChunk(chunks.data(), chunks.size(),
+               [&](const uint8_t *chunk, const uint8_t *) {
+                 has_header |= std::memcmp(chunk, "BMHD", 4) == 0;
+               });
+  if (!has_header) {
+    return nullptr;
+  }
+
+  try {
+    IFFReader::MemoryStream chunk_stream(chunks.data(), chunks.size());
+    auto image =
+        make_shared<IFFReader::ILBM>(chunk_stream, std::move(indices));
+    if (image->width() != header.width || image->height() != header.height) {
+      return nullptr;
+    }
+
+    // Sidecars in use are the last to be pruned.
+    fs::last_write_time(sidecar, fs::file_time_type::clock::now(), error);
+    return image;
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+struct Sidecar {
+  fs::path path;
+  fs::file_time_type time;
+  uintmax_t size;
+};
+
+// Sidecars in the folder, and their total size. Sidecars removed while
+// counting are left out.
+static const uintmax_t ListSidecars(const fs::path &folder,
+                                    vector<Sidecar> *sidecars) {
+  uintmax_t total = 0;
+  std::error_code error;
+  for (fs::directory_iterator it(folder, error), end; !error && it != end;
+       it.increment(error)) {
+    if (it->path().extension() != ".iffcache") {
+      continue;
+    }
+    std::error_code entry_error;
+    const auto size = it->file_size(entry_error);
+    if (entry_error) {
+      continue;
+    }
+    if (sidecars) {
+      const auto time = it->last_write_time(entry_error);
+      if (entry_error) {
+        continue;
+      }
+      sidecars->push_back({it->path(), time, size});
+    }
+    total += size;
+  }
+  return total;
+}
+
+IFFReader::DecodeCache::DecodeCache(const fs::path &folder,
+                                    const uintmax_t limit)
+    : folder_(folder), limit_(limit), total_(ListSidecars(folder, nullptr)) {}
+
+const fs::path IFFReader::DecodeCache::DefaultFolder() {
+  std::error_code error;
+  const auto temporary = fs::temp_directory_path(error);
+  return (error ? fs::current_path() : temporary) / "IFF_Reader cache";
+}
+
+const fs::path IFFReader::DecodeCache::Folder() const { return folder_; }
+
+const fs::path
+IFFReader::DecodeCache::SidecarPath(const fs::path &source) const {
+  const auto name = SourceName(source);
+  const auto hash = Hash64(reinterpret_cast<const uint8_t *>(name.data()),
+                           name.size());
+
+  static const char digits[] = "0123456789abcdef";
+  string file_name(16, '0');
+  for (size_t i = 0; i < 16; ++i) {
+    file_name[i] = digits[(hash >> (60 - 4 * i)) & 0xf];
+  }
+  return folder_ / (file_name + ".iffcache");
+}
+
+shared_ptr<IFFReader::ILBM>
+IFFReader::DecodeCache::Load(const fs::path &source) const {
+  bytefield contents;
+  if (!ReadContents(source, contents)) {
+    return nullptr;
+  }
+  return LoadSidecar(SidecarPath(source), source, contents);
+}
+
+// Written under a name of its own, then renamed, so that a sidecar is never
+// seen half written by another thread or program.
+const bool IFFReader::DecodeCache::Store(const fs::path &source,
+                                         const bytefield &contents,
+                                         const ILBM &image) const {
+  const auto chunks = ChunksWithoutBody(contents);
+  if (chunks.empty()) {
+    return false;
+  }
+
+  std::error_code error;
+  SidecarHeader header{};
+  std::memcpy(header.magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC));
+  header.version = SIDECAR_VERSION;
+  header.width = image.width();
+  header.height = image.height();
+  header.source_size = contents.size();
+  header.source_time = SourceTime(source, error);
+  header.source_hash = Hash64(contents.data(), contents.size());
+  if (error) {
+    return false;
+  }
+
+  const auto path = SourceName(source);
+  const auto indexed = image.GetIndexed();
+
+  header.path_offset = sizeof(header);
+  header.path_size = path.size();
+  header.chunks_offset = header.path_offset + header.path_size;
+  header.chunks_size = chunks.size();
+  header.indices_offset = header.chunks_offset + header.chunks_size;
+  header.indices_size = static_cast<uint64_t>(header.width) * header.height;
+
+  bytefield file(
+      static_cast<size_t>(header.indices_offset + header.indices_size), 0);
+  std::memcpy(file.data(), &header, sizeof(header));
+  std::memcpy(file.data() + header.path_offset, path.data(), path.size());
+  std::memcpy(file.data() + header.chunks_offset, chunks.data(),
+              chunks.size());
+  for (uint32_t y = 0; y < header.height; ++y) {
+    std::memcpy(file.data() + header.indices_offset +
+                    static_cast<size_t>(y) * header.width,
+                indexed.indices + y * indexed.stride, header.width);
+  }
+
+  fs::create_directories(folder_, error);
+  const auto target = SidecarPath(source);
+  auto temporary = target;
+  temporary += "." +
+               std::to_string(
+                   std::hash<std::thread::id>()(std::this_thread::get_id())) +
+               ".tmp";
+
+  std::ofstream stream(temporary, std::ios::binary);
+  stream.write(reinterpret_cast<const char *>(file.data()),
+               static_cast<std::streamsize>(file.size()));
+  stream.close();
+  if (!stream) {
+    fs::remove(temporary, error);
+    return false;
+  }
+
+  // A sidecar written over takes its predecessor's place in the total.
+  const auto replaced = fs::file_size(target, error);
+  const auto previous = error ? 0 : replaced;
+  fs::rename(temporary, target, error);
+  if (error) {
+    fs::remove(temporary, error);
+    return false;
+  }
+
+  // Should the count have gone below zero, the total wraps round to huge
+  // and pruning counts afresh.
+  if ((total_ += file.size() - previous) > limit_) {
+    Prune();
+  }
+  return true;
+}
+
+// Other threads may prune at the same time; a sidecar already gone is
+// simply not counted.
+void IFFReader::DecodeCache::Prune() const {
+  vector<Sidecar> sidecars;
+  auto total = ListSidecars(folder_, &sidecars);
+
+  std::sort(sidecars.begin(), sidecars.end(),
+            [](const Sidecar &a, const Sidecar &b) { return a.time < b.time; });
+  std::error_code error;
+  for (const auto &sidecar : sidecars) {
+    if (total <= limit_) {
+      break;
+    }
+    fs::remove(sidecar.path, error);
+    total -= sidecar.size;
+  }
+  total_ = total;
+}
+
+shared_ptr<IFFReader::ILBM>
+IFFReader::DecodeCache::Open(const fs::path &source) const {
+  bytefield contents;
+  if (!IsILBMFile(source) || !ReadContents(source, contents)) {
+    return nullptr;
+  }
+
+  if (auto image = LoadSidecar(SidecarPath(source), source, contents)) {
+    return image;
+  }
+
+  const File file(source.string(), contents);
+  auto image = file.AsILBM();
+  if (image) {
+    Store(source, contents, *image);
+  }
+  return image;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "InterleavedBitmap.h"
+#include "utility.h"
+
+#include <atomic>
+
+/*
+ * Sidecar files of decoded images, so that folders seen before open without
+ * unpacking ByteRun1 and converting planes to chunky pixels all over again.
+ *
+ * A sidecar holds a fixed header, the source path, the image's chunks as in
+ * the file with BODY left empty, and the chunky indices; the palette and
+ * everything else are rebuilt from the chunks. Sidecars are named after a
+ * hash of the source path, and are only used while the source's path, size,
+ * modification time and contents hash all match what was stored.
+ *
+ * This is a plain read cache, not a format to be mapped and used in place:
+ * the image and its color lookup keep the indices in a vector of their
+ * own, so a hit reads the source (to hash it) and the sidecar into memory.
+ * What it saves is the ByteRun1 and planar to chunky work, not the reads.
+ *
+ * The folder is kept to a size limit. The cache keeps a running total of
+ * sidecar bytes, counted once when it is made; only when a write takes the
+ * total over the limit is the folder walked, and the sidecars used longest
+ * ago removed until the rest fit.
+ */
+namespace IFFReader {
+
+// Space sidecars may take, unless told otherwise.
+constexpr uintmax_t DECODE_CACHE_BYTES = uintmax_t(256) << 20;
+
+class DecodeCache {
+  fs::path folder_;
+  uintmax_t limit_;
+
+  // Bytes of sidecars in the folder, as far as this cache knows. Other
+  // programs writing there are noticed when pruning counts afresh.
+  mutable std::atomic<uintmax_t> total_;
+
+  // Removes the sidecars used longest ago until the folder is within limit,
+  // and sets the total to what is left.
+  void Prune() const;
+
+public:
+  // Keeps sidecars in folder, which is created when first written to, up
+  // to limit bytes of them.
+  explicit DecodeCache(const fs::path &folder,
+                       const uintmax_t limit = DECODE_CACHE_BYTES);
+
+  // Folder under the system's temporary folder.
+  static const fs::path DefaultFolder();
+
+  const fs::path Folder() const;
+
+  // Sidecar file for an image file, whether it exists or not.
+  const fs::path SidecarPath(const fs::path &source) const;
+
+  // The image as stored, if the sidecar is valid for the source as it is
+  // now; empty otherwise.
+  shared_ptr<ILBM> Load(const fs::path &source) const;
+
+  // Writes the sidecar for an image decoded from contents, the source
+  // file's bytes, then prunes. Returns false if it could not be written.
+  const bool Store(const fs::path &source, const bytefield &contents,
+                   const ILBM &image) const;
+
+  // Loads the image from its sidecar if valid; otherwise decodes it and
+  // writes the sidecar for next time. Empty if it is not a readable ILBM;
+  // files of other forms are not read past their first twelve bytes.
+  shared_ptr<ILBM> Open(const fs::path &source) const;
+};
+} // namespace IFFReader
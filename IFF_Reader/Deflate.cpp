@@ -0,0 +1,464 @@
+#include "Deflate.h"
+
+#include <algorithm>
+#include <array>
+#include <queue>
+
+using std::array;
+
+constexpr size_t WINDOW = 32768;
+constexpr uint32_t HASH_BITS = 15;
+constexpr uint32_t MIN_MATCH = 3;
+constexpr uint32_t MAX_MATCH = 258;
+
+// How hard to look for matches: candidates tried per position, and a match
+// long enough to stop looking. Short matches far back cost more than the
+// literals they replace.
+constexpr uint32_t MAX_CHAIN = 32;
+constexpr uint32_t NICE_MATCH = 128;
+constexpr size_t FAR_SHORT_MATCH = 4096;
+
+// Symbols per block; each block gets its own Huffman codes.
+constexpr size_t BLOCK_SYMBOLS = 16384;
+
+constexpr uint32_t MAX_CODE_LENGTH = 15;
+constexpr uint32_t MAX_CODE_LENGTH_LENGTH = 7;
+
+static constexpr uint16_t LENGTH_BASE[29] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static constexpr uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                             1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                             4, 4, 4, 4, 5, 5, 5, 5, 0};
+static constexpr uint16_t DISTANCE_BASE[30] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145,  8193, 12289, 16385, 24577};
+static constexpr uint8_t DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Order in which code length code lengths are stored.
+static constexpr uint8_t CODE_LENGTH_ORDER[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// A literal byte, or a match of length bytes at distance back.
+struct Symbol {
+  uint16_t length;
+  uint16_t distance;
+};
+
+// Bits go out least significant first, as deflate wants them.
+class BitWriter {
+  bytefield &out_;
+  uint64_t bits_ = 0;
+  uint32_t count_ = 0;
+
+public:
+  explicit BitWriter(bytefield &out) : out_(out) {}
+
+  void Put(const uint32_t value, const uint32_t length) {
+    bits_ |= static_cast<uint64_t>(value) << count_;
+    count_ += length;
+    while (count_ >= 8) {
+      out_.push_back(static_cast<uint8_t>(bits_));
+      bits_ >>= 8;
+      count_ -= 8;
+    }
+  }
+
+  // Pads with zeros to the next byte.
+  void Align() {
+    if (count_ > 0) {
+      out_.push_back(static_cast<uint8_t>(bits_));
+      bits_ = 0;
+      count_ = 0;
+    }
+  }
+};
+
+static const uint32_t LengthCode(const uint32_t length) {
+  return static_cast<uint32_t>(
+      std::upper_bound(LENGTH_BASE, LENGTH_BASE + 29, length) - LENGTH_BASE -
+      1);
+}
+
+static const uint32_t DistanceCode(const uint32_t distance) {
+  return static_cast<uint32_t>(
+      std::upper_bound(DISTANCE_BASE, DISTANCE_BASE + 30, distance) -
+      DISTANCE_BASE - 1);
+}
+
+// Huffman code lengths for the given frequencies, none over limit. Trees
+// too deep are built again from flattened frequencies, which seldom takes
+// more than one retry.
+static const vector<uint8_t> CodeLengths(vector<uint32_t> frequencies,
+                                         const uint32_t limit) {
+  const auto count = frequencies.size();
+  vector<uint8_t> lengths(count, 0);
+
+  for (;;) {
+    // Leaves are nodes [0, count); inner nodes follow as they are made.
+    using Node = std::pair<uint64_t, size_t>;
+    std::priority_queue<Node, vector<Node>, std::greater<Node>> queue;
+    for (size_t symbol = 0; symbol < count; ++symbol) {
+      if (frequencies[symbol] > 0) {
+        queue.emplace(frequencies[symbol], symbol);
+      }
+    }
+    if (queue.empty()) {
+      return lengths;
+    }
+    if (queue.size() == 1) {
+      lengths[queue.top().second] = 1;
+      return lengths;
+    }
+
+    vector<size_t> parent(count, 0);
+    while (queue.size() > 1) {
+      const auto a = queue.top();
+      queue.pop();
+      const auto b = queue.top();
+      queue.pop();
+      const auto node = parent.size();
+      parent.push_back(0);
+      parent[a.second] = node;
+      parent[b.second] = node;
+      queue.emplace(a.first + b.first, node);
+    }
+    const auto root = queue.top().second;
+
+    // Inner nodes come after their children, so depths resolve downwards.
+    vector<uint32_t> depth(parent.size(), 0);
+    for (auto node = root; node-- > count;) {
+      depth[node] = depth[parent[node]] + 1;
+    }
+
+    uint32_t deepest = 0;
+    for (size_t symbol = 0; symbol < count; ++symbol) {
+      if (frequencies[symbol] > 0) {
+        const auto length = depth[parent[symbol]] + 1;
+        lengths[symbol] = static_cast<uint8_t>(std::min(length, 255u));
+        deepest = std::max(deepest, length);
+      }
+    }
+    if (deepest <= limit) {
+      return lengths;
+    }
+
+    for (auto &frequency : frequencies) {
+      frequency = frequency > 0 ? (frequency >> 1) | 1 : 0;
+    }
+  }
+}
+
+// Canonical codes for the given lengths, bit reversed for writing.
+static const vector<uint16_t> CanonicalCodes(const vector<uint8_t> &lengths) {
+  array<uint16_t, MAX_CODE_LENGTH + 1> counts{};
+  for (const auto length : lengths) {
+    ++counts[length];
+  }
+  counts[0] = 0;
+
+  array<uint16_t, MAX_CODE_LENGTH + 1> next{};
+  uint32_t code = 0;
+  for (uint32_t bits = 1; bits <= MAX_CODE_LENGTH; ++bits) {
+    code = (code + counts[bits - 1]) << 1;
+    next[bits] = static_cast<uint16_t>(code);
+  }
+
+  vector<uint16_t> codes(lengths.size(), 0);
+  for (size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+    const auto length = lengths[symbol];
+    if (length == 0) {
+      continue;
+    }
+    uint32_t value = next[length]++;
+    uint32_t reversed = 0;
+    for (uint32_t bit = 0; bit < length; ++bit) {
+      reversed = (reversed << 1) | (value & 1);
+      value >>= 1;
+    }
+    codes[symbol] = static_cast<uint16_t>(reversed);
+  }
+  return codes;
+}
+
+// Code lengths of both alphabets, run length coded with symbols 16 (repeat
+// the previous length), 17 and 18 (runs of zeros). Each entry holds the
+// symbol and its extra bits.
+static const vector<std::pair<uint8_t, uint8_t>>
+RunLengths(const vector<uint8_t> &lengths) {
+  vector<std::pair<uint8_t, uint8_t>> runs;
+  size_t i = 0;
+  while (i < lengths.size()) {
+    const auto length = lengths[i];
+    size_t run = 1;
+    while (i + run < lengths.size() && lengths[i + run] == length) {
+      ++run;
+    }
+
+    if (length == 0 && run >= 3) {
+      const auto take = std::min<size_t>(run, 138);
+      if (take >= 11) {
+        runs.emplace_back(18, static_cast<uint8_t>(take - 11));
+      } else {
+        runs.emplace_back(17, static_cast<uint8_t>(take - 3));
+      }
+      i += take;
+    } else if (length != 0 && run >= 4) {
+      const auto take = std::min<size_t>(run - 1, 6);
+      runs.emplace_back(length, 0);
+      runs.emplace_back(16, static_cast<uint8_t>(take - 3));
+      i += take + 1;
+    } else {
+      runs.emplace_back(length, 0);
+      ++i;
+    }
+  }
+  return runs;
+}
+
+// Writes the symbols as a block with codes made for them.
+static void WriteBlock(BitWriter &bits, const vector<Symbol> &symbols,
+                       const bool final) {
+  vector<uint32_t> literal_counts(286, 0);
+  vector<uint32_t> distance_counts(30, 0);
+  literal_counts[256] = 1; // End of block.
+  for (const auto &symbol : symbols) {
+    if (symbol.distance == 0) {
+      ++literal_counts[symbol.length];
+    } else {
+      ++literal_counts[257 + LengthCode(symbol.length)];
+      ++distance_counts[DistanceCode(symbol.distance)];
+    }
+  }
+  // Some decoders insist on at least one distance code.
+  if (std::all_of(distance_counts.begin(), distance_counts.end(),
+                  [](const uint32_t n) { return n == 0; })) {
+    distance_counts[0] = 1;
+  }
+
+  const auto literal_lengths = CodeLengths(literal_counts, MAX_CODE_LENGTH);
+  const auto distance_lengths = CodeLengths(distance_counts, MAX_CODE_LENGTH);
+  const auto literal_codes = CanonicalCodes(literal_lengths);
+  const auto distance_codes = CanonicalCodes(distance_lengths);
+
+  size_t literals = 286;
+  while (literals > 257 && literal_lengths[literals - 1] == 0) {
+    --literals;
+  }
+  size_t distances = 30;
+  while (distances > 1 && distance_lengths[distances - 1] == 0) {
+    --distances;
+  }
+
+  vector<uint8_t> lengths(literal_lengths.begin(),
+                          literal_lengths.begin() + literals);
+  lengths.insert(lengths.end(), distance_lengths.begin(),
+                 distance_lengths.begin() + distances);
+  const auto runs = RunLengths(lengths);
+
+  vector<uint32_t> length_counts(19, 0);
+  for (const auto &run : runs) {
+    ++length_counts[run.first];
+  }
+  const auto length_lengths =
+      CodeLengths(length_counts, MAX_CODE_LENGTH_LENGTH);
+  const auto length_codes = CanonicalCodes(length_lengths);
+
+  size_t stored_lengths = 19;
+  while (stored_lengths > 4 &&
+         length_lengths[CODE_LENGTH_ORDER[stored_lengths - 1]] == 0) {
+    --stored_lengths;
+  }
+
+  bits.Put(final ? 1 : 0, 1);
+  bits.Put(2, 2); // Dynamic Huffman codes.
+  bits.Put(static_cast<uint32_t>(literals - 257), 5);
+  bits.Put(static_cast<uint32_t>(distances - 1), 5);
+  bits.Put(static_cast<uint32_t>(stored_lengths - 4), 4);
+  for (size_t i = 0; i < stored_lengths; ++i) {
+    bits.Put(length_lengths[CODE_LENGTH_ORDER[i]], 3);
+  }
+
+  static constexpr uint8_t RUN_EXTRA[3] = {2, 3, 7};
+  for (const auto &run : runs) {
+    bits.Put(length_codes[run.first], length_lengths[run.first]);
+    if (run.first >= 16) {
+      bits.Put(run.second, RUN_EXTRA[run.first - 16]);
+    }
+  }
+
+  for (const auto &symbol : symbols) {
+    if (symbol.distance == 0) {
+      bits.Put(literal_codes[symbol.length], literal_lengths[symbol.length]);
+      continue;
+    }
+    const auto length_code = LengthCode(symbol.length);
+    bits.Put(literal_codes[257 + length_code],
+             literal_lengths[257 + length_code]);
+    bits.Put(symbol.length - LENGTH_BASE[length_code],
+             LENGTH_EXTRA[length_code]);
+
+    const auto distance_code = DistanceCode(symbol.distance);
+    bits.Put(distance_codes[distance_code], distance_lengths[distance_code]);
+    bits.Put(symbol.distance - DISTANCE_BASE[distance_code],
+             DISTANCE_EXTRA[distance_code]);
+  }
+  bits.Put(literal_codes[256], literal_lengths[256]);
+}
+
+static const uint32_t Hash(const uint8_t *p) {
+  const uint32_t bytes = p[0] | (p[1] << 8) | (p[2] << 16);
+  return (bytes * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Greedy matching over hash chains of three byte prefixes.
+const bytefield IFFReader::Deflate(const uint8_t *data, const size_t size,
+                                   const bool last) {
+  bytefield out;
+  out.reserve(size / 2 + 64);
+  BitWriter bits(out);
+
+  vector<int64_t> head(size_t(1) << HASH_BITS, -1);
+  vector<int64_t> previous(WINDOW, -1);
+  const auto insert = [&](const size_t position) {
+    const auto hash = Hash(data + position);
+    previous[position & (WINDOW - 1)] = head[hash];
+    head[hash] = static_cast<int64_t>(position);
+  };
+
+  vector<Symbol> symbols;
+  symbols.reserve(BLOCK_SYMBOLS);
+
+  size_t position = 0;
+  while (position < size) {
+    uint32_t best_length = 0;
+    size_t best_distance = 0;
+
+    if (position + MIN_MATCH <= size) {
+      const auto longest =
+          static_cast<uint32_t>(std::min<size_t>(MAX_MATCH, size - position));
+      auto candidate = head[Hash(data + position)];
+      for (uint32_t chain = 0; chain < MAX_CHAIN && candidate >= 0; ++chain) {
+        const auto distance = position - static_cast<size_t>(candidate);
+        if (distance > WINDOW) {
+          break;
+        }
+
+        const auto *a = data + candidate;
+        const auto *b = data + position;
+        if (a[best_length] == b[best_length]) {
+          uint32_t length = 0;
+          while (length < longest && a[length] == b[length]) {
+            ++length;
+          }
+          if (length > best_length) {
+            best_length = length;
+            best_distance = distance;
+            if (length >= NICE_MATCH || length == longest) {
+              break;
+            }
+          }
+        }
+        candidate = previous[static_cast<size_t>(candidate) & (WINDOW - 1)];
+      }
+      insert(position);
+    }
+
+    if (best_length == MIN_MATCH && best_distance > FAR_SHORT_MATCH) {
+      best_length = 0;
+    }
+
+    if (best_length >= MIN_MATCH) {
+      symbols.push_back({static_cast<uint16_t>(best_length),
+                         static_cast<uint16_t>(best_distance)});
+      for (size_t skipped = position + 1;
+           skipped < position + best_length && skipped + MIN_MATCH <= size;
+           ++skipped) {
+        insert(skipped);
+      }
+      position += best_length;
+    } else {
+      symbols.push_back({data[position], 0});
+      ++position;
+    }
+
+    if (symbols.size() == BLOCK_SYMBOLS) {
+      WriteBlock(bits, symbols, last && position == size);
+      symbols.clear();
+    }
+  }
+
+  if (!symbols.empty() || size == 0) {
+    WriteBlock(bits, symbols, last);
+  }
+
+  if (last) {
+    bits.Align();
+  } else {
+    // Empty stored block: header bits, then zero length and its complement.
+    bits.Put(0, 3);
+    bits.Align();
+    out.insert(out.end(), {0x00, 0x00, 0xff, 0xff});
+  }
+  return out;
+}
+
+constexpr uint32_t ADLER_BASE = 65521;
+
+// Most bytes that can be summed before the sums may overflow 32 bits.
+constexpr size_t ADLER_RUN = 5552;
+
+const uint32_t IFFReader::Adler32(const uint8_t *data, const size_t size,
+                                  const uint32_t adler) {
+  uint32_t a = adler & 0xffff;
+  uint32_t b = adler >> 16;
+  for (size_t start = 0; start < size; start += ADLER_RUN) {
+    const auto end = std::min(size, start + ADLER_RUN);
+    for (auto i = start; i < end; ++i) {
+      a += data[i];
+      b += a;
+    }
+    a %= ADLER_BASE;
+    b %= ADLER_BASE;
+  }
+  return (b << 16) | a;
+}
+
+// As zlib's adler32_combine: the second piece's sums shifted by the first
+// piece's, as though its bytes had followed them.
+const uint32_t IFFReader::CombineAdler32(const uint32_t first,
+                                         const uint32_t second,
+                                         const size_t second_size) {
+  const auto remainder = static_cast<uint32_t>(second_size % ADLER_BASE);
+  uint64_t a = first & 0xffff;
+  uint64_t b = (remainder * a) % ADLER_BASE;
+  a += (second & 0xffff) + ADLER_BASE - 1;
+  b += (first >> 16) + (second >> 16) + ADLER_BASE - remainder;
+  a %= ADLER_BASE;
+  b %= ADLER_BASE;
+  return static_cast<uint32_t>((b << 16) | a);
+}
+
+static const array<uint32_t, 256> CRC_TABLE = [] {
+  array<uint32_t, 256> table{};
+  for (uint32_t n = 0; n < 256; ++n) {
+    auto c = n;
+    for (int k = 0; k < 8; ++k) {
+      c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+    }
+    table[n] = c;
+  }
+  return table;
+}();
+
+const uint32_t IFFReader::Crc32(const uint8_t *data, const size_t size,
+                                const uint32_t crc) {
+  auto c = ~crc;
+  for (size_t i = 0; i < size; ++i) {
+    c = CRC_TABLE[(c ^ data[i]) & 0xff] ^ (c >> 8);
+  }
+  return ~c;
+}
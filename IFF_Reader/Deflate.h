@@ -0,0 +1,33 @@
+#pragma once
+#include "utility.h"
+
+/*
+ * Deflate (RFC 1951) and the checksums that go with it, so that PNG files
+ * can be written without depending on zlib.
+ *
+ * Pieces of data can be compressed independently, on separate threads, and
+ * joined end to end: every piece but the last ends in an empty stored
+ * block, which brings the stream to a byte boundary without ending it. Each
+ * piece has its own 32 kB window, so matches never cross into another.
+ */
+namespace IFFReader {
+
+// Compresses data as one or more dynamic Huffman blocks. Only with last is
+// the final block marked as such.
+const bytefield Deflate(const uint8_t *data, const size_t size,
+                        const bool last);
+
+// Adler-32 of data, continuing from a previous checksum (1 to start).
+const uint32_t Adler32(const uint8_t *data, const size_t size,
+                       const uint32_t adler = 1);
+
+// Adler-32 of two pieces joined, from the checksums of each and the size of
+// the second.
+const uint32_t CombineAdler32(const uint32_t first, const uint32_t second,
+                              const size_t second_size);
+
+// CRC-32 as used by PNG and zlib, continuing from a previous CRC (0 to
+// start).
+const uint32_t Crc32(const uint8_t *data, const size_t size,
+                     const uint32_t crc = 0);
+} // namespace IFFReader
@@ -0,0 +1,116 @@
+#include "Downscale.h"
+
+#include <algorithm>
+
+#if IFF_SIMD_X86
+// Four pixels widen to sixteen 32-bit sums.
+IFF_TARGET_SSE2 static const size_t Accumulate_SSE2(const uint32_t *pixels,
+                                                    const size_t count,
+                                                    uint32_t *sums) {
+  const auto zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const auto p =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+    const auto lo = _mm_unpacklo_epi8(p, zero);
+    const auto hi = _mm_unpackhi_epi8(p, zero);
+    const __m128i parts[4] = {
+        _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+        _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)};
+
+    auto *out = reinterpret_cast<__m128i *>(sums + i * 4);
+    for (int k = 0; k < 4; ++k) {
+      _mm_storeu_si128(out + k,
+                       _mm_add_epi32(_mm_loadu_si128(out + k), parts[k]));
+    }
+  }
+  return i;
+}
+
+// Two pixels widen to eight 32-bit sums at a time.
+IFF_TARGET_AVX2 static const size_t Accumulate_AVX2(const uint32_t *pixels,
+                                                    const size_t count,
+                                                    uint32_t *sums) {
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const auto p = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixels + i)));
+    auto *out = reinterpret_cast<__m256i *>(sums + i * 4);
+    _mm256_storeu_si256(out, _mm256_add_epi32(_mm256_loadu_si256(out), p));
+  }
+  return i;
+}
+#endif
+
+void IFFReader::AccumulatePixels(const uint32_t *pixels, const size_t count,
+                                 uint32_t *sums, const SimdLevel level) {
+  size_t done = 0;
+
+#if IFF_SIMD_X86
+  if (level == SimdLevel::AVX2) {
+    done = Accumulate_AVX2(pixels, count, sums);
+  } else if (level == SimdLevel::SSE2) {
+    done = Accumulate_SSE2(pixels, count, sums);
+  }
+#endif
+
+  for (auto i = done; i < count; ++i) {
+    const auto p = pixels[i];
+    sums[i * 4] += p & 0xff;
+    sums[i * 4 + 1] += (p >> 8) & 0xff;
+    sums[i * 4 + 2] += (p >> 16) & 0xff;
+    sums[i * 4 + 3] += p >> 24;
+  }
+}
+
+// Blocks along the right and bottom edges may be cut short; they are
+// averaged over the pixels they do have.
+const IFFReader::Thumbnail IFFReader::MakeThumbnail(const ILBM &image,
+                                                    const uint32_t size) {
+  const auto width = image.width();
+  const auto height = image.height();
+  const auto longest = std::max(width, height);
+  const auto target = std::max<uint32_t>(size, 1);
+  const auto factor = std::max<uint32_t>(1, (longest + target - 1) / target);
+
+  Thumbnail thumbnail;
+  thumbnail.width = (width + factor - 1) / factor;
+  thumbnail.height = (height + factor - 1) / factor;
+  thumbnail.pixels.resize(static_cast<size_t>(thumbnail.width) *
+                          thumbnail.height);
+
+  vector<uint32_t> band(static_cast<size_t>(width) * factor);
+  vector<uint32_t> sums(static_cast<size_t>(width) * 4);
+
+  for (uint32_t ty = 0; ty < thumbnail.height; ++ty) {
+    const auto first = ty * factor;
+    const auto rows = std::min(factor, height - first);
+    image.ResolveRows(first, first + rows, band.data(), width);
+
+    std::fill(begin(sums), end(sums), 0);
+    for (uint32_t r = 0; r < rows; ++r) {
+      AccumulatePixels(band.data() + static_cast<size_t>(r) * width, width,
+                       sums.data());
+    }
+
+    auto *out = thumbnail.pixels.data() +
+                static_cast<size_t>(ty) * thumbnail.width;
+    for (uint32_t tx = 0; tx < thumbnail.width; ++tx) {
+      const auto left = tx * factor;
+      const auto columns = std::min(factor, width - left);
+      const auto area = rows * columns;
+
+      uint32_t pixel = 0;
+      for (int c = 0; c < 4; ++c) {
+        uint64_t total = 0;
+        for (uint32_t x = left; x < left + columns; ++x) {
+          total += sums[static_cast<size_t>(x) * 4 + c];
+        }
+        pixel |= static_cast<uint32_t>((total + area / 2) / area) << (c * 8);
+      }
+      out[tx] = pixel;
+    }
+  }
+
+  return thumbnail;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "InterleavedBitmap.h"
+#include "Simd.h"
+
+/*
+ * Thumbnails are made by averaging square blocks of pixels (a box filter).
+ * Rows are resolved a block's height at a time and summed into per-channel
+ * accumulators, so the full-resolution image is never held as 32-bit
+ * color; HAM and sliced images resolve their rows as usual on the way.
+ */
+namespace IFFReader {
+
+struct Thumbnail {
+  uint32_t width = 0;
+  uint32_t height = 0;
+
+  // 0xAABBGGRR, width pixels per row.
+  vector<uint32_t> pixels;
+};
+
+// Adds each byte of count 0xAABBGGRR pixels to its own sum: channel c of
+// pixel i goes to sums[i * 4 + c].
+void AccumulatePixels(const uint32_t *pixels, const size_t count,
+                      uint32_t *sums,
+                      const SimdLevel level = DetectSimdLevel());
+
+// Shrinks the image to fit within size x size pixels, keeping its shape.
+// Images already small enough are copied as they are.
+const Thumbnail MakeThumbnail(const ILBM &image, const uint32_t size);
+} // namespace IFFReader
@@ -1,7 +1,63 @@
 #include "DynamicColorRange.h"
+#include <algorithm>
 
-DRNG::DRNG() {}
+using std::sort;
+
+constexpr uint16_t DRNG_ACTIVE = 0x1;
+
+// Rates are given in steps per 1/60 seconds, times 16384.
+constexpr uint64_t DRNG_NORM = 16384;
+constexpr uint64_t JIFFIES_PER_SECOND = 60;
+
+DRNG::DRNG() : min_(0), max_(0), rate_(0), flags_(0) {}
 
 DRNG::DRNG(bytestream &stream) : CHUNK(stream) {
-  stream.ignore(GetSize()); // Not yet implemented.
+  min_ = IFFReader::read_byte(stream);
+  max_ = IFFReader::read_byte(stream);
+  rate_ = IFFReader::read_word(stream);
+  flags_ = IFFReader::read_word(stream);
+  const auto true_count = IFFReader::read_byte(stream);
+  const auto register_count = IFFReader::read_byte(stream);
+
+  for (int i = 0; i < true_count; ++i) {
+    const auto cell = IFFReader::read_byte(stream);
+    const uint32_t r = IFFReader::read_byte(stream);
+    const uint32_t g = IFFReader::read_byte(stream);
+    const uint32_t b = IFFReader::read_byte(stream);
+    true_colors_.emplace_back(cell, 0xff000000 | (b << 16) | (g << 8) | r);
+  }
+
+  for (int i = 0; i < register_count; ++i) {
+    const auto cell = IFFReader::read_byte(stream);
+    const auto index = IFFReader::read_byte(stream);
+    registers_.emplace_back(cell, index);
+  }
+
+  const uint32_t consumed = 8 + true_count * 4 + register_count * 2;
+  if (GetSize() > consumed) {
+    stream.ignore(GetSize() - consumed);
+  }
+  stream.ignore(GetSize() & 1); // Pad byte.
+}
+
+const IFFReader::CycleRange DRNG::GetRange() const {
+  IFFReader::CycleRange range;
+
+  auto cells = registers_;
+  sort(begin(cells), end(cells));
+  for (const auto &[cell, index] : cells) {
+    if (cell >= min_ && cell <= max_) {
+      range.registers.push_back(index);
+    }
+  }
+
+  if (rate_ != 0) {
+    range.step_duration = static_cast<uint32_t>(
+        (DRNG_NORM * 1000000) /
+        (static_cast<uint64_t>(rate_) * JIFFIES_PER_SECOND));
+  }
+
+  range.active = flags_ & DRNG_ACTIVE;
+
+  return range;
 }
@@ -1,7 +1,26 @@
 #pragma once
 #include "Chunk.h"
+#include "ColorCycler.h"
+
+// Dynamic color range, as written by DPaint IV. A range is made up of cells,
+// each of which holds either a fixed color or a color register.
 class DRNG : public IFFReader::CHUNK {
+  uint8_t min_;    // First cell
+  uint8_t max_;    // Last cell
+  uint16_t rate_;  // 16384 = 60 steps per second
+  uint16_t flags_; // 1 = active
+
+  // Cells holding a true color, stored as 0xAABBGGRR.
+  vector<std::pair<uint8_t, uint32_t>> true_colors_;
+
+  // Cells holding a color register.
+  vector<std::pair<uint8_t, uint8_t>> registers_;
+
 public:
   DRNG();
   DRNG(bytestream &stream);
+
+  // Normalized cycling range. Only register cells take part; fixed colors
+  // have no register to rotate into.
+  const IFFReader::CycleRange GetRange() const;
 };
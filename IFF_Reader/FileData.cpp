@@ -11,19 +11,38 @@ IFFReader::File::File(const string &path)
     return; // Automatically returns file not found.
   }
 
+  Parse(stream_);
+}
+
+IFFReader::File::File(const string &path, const bytefield &contents)
+    : path_(path), type_(IFF_T::UNKNOWN_FORMAT),
+      error_code_(IFF_ERRCODE::COULD_NOT_PARSE_AS_IFF), size_(0) {
+  MemoryStream stream(contents.data(), contents.size());
+  Parse(stream);
+}
+
+void IFFReader::File::Parse(bytestream &stream) {
   try {
-    if (read_tag(stream_) != "FORM") {
+    if (read_tag(stream) != "FORM") {
       error_code_ = IFF_ERRCODE::COULD_NOT_PARSE_AS_IFF;
       return;
     }
 
-    size_ = read_long(stream_);
-    const string tag = read_tag(stream_);
+    size_ = read_long(stream);
+    const string tag = read_tag(stream);
 
     if (tag == "ILBM") {
-      asILBM_ = shared_ptr<ILBM>(new ILBM(stream_));
+      asILBM_ = shared_ptr<ILBM>(new ILBM(stream));
       type_ = IFF_T::ILBM;
       error_code_ = IFF_ERRCODE::NO_ERROR;
+    } else if (tag == "ANIM") {
+      asANIM_ = shared_ptr<ANIM>(new ANIM(stream));
+      if (!asANIM_->Image()) {
+        error_code_ = IFF_ERRCODE::COULD_NOT_PARSE_HEAD;
+        return;
+      }
+      type_ = IFF_T::ANIM;
+      error_code_ = IFF_ERRCODE::NO_ERROR;
     }
   } catch (...) { // Consider refactoring this part.
     // Abort if file malformed or missing.
@@ -39,6 +58,13 @@ shared_ptr<IFFReader::ILBM> IFFReader::File::AsILBM() const {
   return asILBM_;
 }
 
+shared_ptr<IFFReader::ANIM> IFFReader::File::AsANIM() const {
+  if (type_ != IFF_T::ANIM) {
+    return shared_ptr<IFFReader::ANIM>();
+  }
+  return asANIM_;
+}
+
 // Yields identified subtype of IFF (ILBM, etc) that the reader can currently
 // parse.
 const IFFReader::IFF_T IFFReader::File::GetType() const { return type_; }
@@ -1,8 +1,9 @@
 #pragma once
+#include "Animation.h"
 #include "InterleavedBitmap.h"
 
 namespace IFFReader { // List of recognized IFF formats.
-enum class IFF_T { ILBM, UNKNOWN_FORMAT };
+enum class IFF_T { ILBM, ANIM, UNKNOWN_FORMAT };
 enum class IFF_ERRCODE {
   NO_ERROR,
   FILE_NOT_FOUND,
@@ -16,16 +17,26 @@ private:
   string path_;
   IFF_T type_;
   IFF_ERRCODE error_code_;
-  bytestream stream_;
+  bytefilestream stream_;
   uint32_t size_;
   shared_ptr<ILBM> asILBM_;
+  shared_ptr<ANIM> asANIM_;
+
+  // Reads the FORM header and the form inside it.
+  void Parse(bytestream &stream);
 
 public:
   File(const string &path);
 
+  // Parses file contents read earlier; path is kept for reference only.
+  File(const string &path, const bytefield &contents);
+
   // Returns ILBM object to display or manipulate (empty if invalid).
   shared_ptr<ILBM> AsILBM() const;
 
+  // Returns ANIM object to play (empty if not an animation).
+  shared_ptr<ANIM> AsANIM() const;
+
   // Returns type of IFF file that was successfully parsed, if any.
   const IFF_T GetType() const;
 
@@ -0,0 +1,93 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using std::chrono::duration_cast;
+
+// Sleeping is only trusted to within this much of the deadline; the rest
+// of the wait yields instead. Timer resolution on Windows is coarse.
+constexpr microseconds SPIN_MARGIN(1500);
+
+FramePacer::FramePacer(const microseconds period) : period_(period) {}
+
+void FramePacer::SetPeriod(const microseconds period) {
+  period_ = std::max(period, microseconds(1));
+}
+
+const microseconds FramePacer::Period() const { return period_; }
+
+void FramePacer::BeginFrame() {
+  const auto now = steady_clock::now();
+
+  if (started_) {
+    const auto interval = duration_cast<microseconds>(now - frame_start_);
+    intervals_[interval_samples_++ % HISTORY] =
+        static_cast<uint32_t>(interval.count());
+  } else {
+    deadline_ = now;
+    started_ = true;
+  }
+  frame_start_ = now;
+}
+
+void FramePacer::EndFrame() {
+  const auto now = steady_clock::now();
+  const auto work = duration_cast<microseconds>(now - frame_start_);
+  work_[work_samples_++ % HISTORY] = static_cast<uint32_t>(work.count());
+  ++frames_;
+
+  // Overruns skip the deadlines that went by, keeping to the grid.
+  deadline_ += period_;
+  if (now >= deadline_) {
+    const auto missed = (now - deadline_) / period_ + 1;
+    dropped_ += static_cast<uint64_t>(missed);
+    deadline_ += period_ * missed;
+  }
+
+  const auto wake = deadline_ - SPIN_MARGIN;
+  if (steady_clock::now() < wake) {
+    std::this_thread::sleep_until(wake);
+  }
+  while (steady_clock::now() < deadline_) {
+    std::this_thread::yield();
+  }
+}
+
+// Mean and 99th percentile of the first count samples.
+static void Summarize(const uint32_t *ring, const size_t count,
+                      microseconds &mean, microseconds &p99) {
+  if (count == 0) {
+    return;
+  }
+
+  std::vector<uint32_t> samples(ring, ring + count);
+  const auto total =
+      std::accumulate(samples.begin(), samples.end(), uint64_t(0));
+  mean = microseconds(total / count);
+
+  const auto rank = std::min(count - 1, count * 99 / 100);
+  std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+  p99 = microseconds(samples[rank]);
+}
+
+const FrameStats FramePacer::Stats() const {
+  FrameStats stats;
+  stats.frames = frames_;
+  stats.dropped = dropped_;
+  Summarize(intervals_.data(), std::min(interval_samples_, HISTORY),
+            stats.mean_interval, stats.p99_interval);
+  Summarize(work_.data(), std::min(work_samples_, HISTORY), stats.mean_work,
+            stats.p99_work);
+  return stats;
+}
+
+void FramePacer::Reset() {
+  started_ = false;
+  interval_samples_ = 0;
+  work_samples_ = 0;
+  frames_ = 0;
+  dropped_ = 0;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+using std::array;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+// Frame timing over the most recent frames.
+struct FrameStats {
+  // Time from one frame's start to the next.
+  microseconds mean_interval{0};
+  microseconds p99_interval{0};
+
+  // Time spent working, before waiting for the deadline.
+  microseconds mean_work{0};
+  microseconds p99_work{0};
+
+  // Frames run since the last reset, and frame deadlines missed.
+  uint64_t frames = 0;
+  uint64_t dropped = 0;
+};
+
+/*
+ * Holds the viewer to a fixed frame rate. Frames start on a grid of
+ * deadlines, one period apart, measured on the steady clock so that changes
+ * to the wall clock do not disturb it. Waiting aims for the deadline itself
+ * rather than for a period after the work ended, so time lost to a slow
+ * sleep is not carried over into the next frame.
+ *
+ * A frame that overruns its deadline counts each deadline it missed as a
+ * dropped frame, and the next frame starts on the following grid point.
+ */
+class FramePacer {
+  static constexpr size_t HISTORY = 512;
+
+  microseconds period_;
+  steady_clock::time_point deadline_;
+  steady_clock::time_point frame_start_;
+  bool started_ = false;
+
+  // Most recent frame intervals and work times, as a ring.
+  array<uint32_t, HISTORY> intervals_{};
+  array<uint32_t, HISTORY> work_{};
+  size_t interval_samples_ = 0;
+  size_t work_samples_ = 0;
+
+  uint64_t frames_ = 0;
+  uint64_t dropped_ = 0;
+
+public:
+  explicit FramePacer(const microseconds period);
+
+  // Changes the frame period from the next frame on.
+  void SetPeriod(const microseconds period);
+  const microseconds Period() const;
+
+  // Marks the start of a frame's work.
+  void BeginFrame();
+
+  // Marks the end of a frame's work and waits for the next deadline.
+  void EndFrame();
+
+  const FrameStats Stats() const;
+
+  // Clears history and counts, as after a pause.
+  void Reset();
+};
@@ -0,0 +1,279 @@
+#include "ILBMWriter.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+using std::array;
+
+constexpr uint32_t CAMG_EHB = 0x80;
+constexpr uint32_t CAMG_HAM = 0x800;
+
+// Longest run either kind of ByteRun1 code can hold.
+constexpr size_t MAX_RUN = 128;
+
+// Scalar kernel. It defines the result; vector kernels below do the bulk of
+// a row, eight pixels at a time, and leave the rest to it.
+static void ToPlanar(const uint8_t *indices, const uint32_t first,
+                     const uint32_t width, const uint16_t planes,
+                     uint8_t *planar, const size_t row_bytes) {
+  for (auto x = first; x < width; x += 8) {
+    const auto count = std::min(8u, width - x);
+    for (uint16_t p = 0; p < planes; ++p) {
+      uint8_t byte = 0;
+      for (uint32_t k = 0; k < count; ++k) {
+        byte |= static_cast<uint8_t>(((indices[x + k] >> p) & 1) << (7 - k));
+      }
+      planar[p * row_bytes + x / 8] = byte;
+    }
+  }
+}
+
+#if IFF_SIMD_X86
+// Bits of a byte in reverse order. Movemask puts the leftmost pixel in the
+// lowest bit, where planar bytes want it in the highest.
+static const array<uint8_t, 256> REVERSED = [] {
+  array<uint8_t, 256> table{};
+  for (uint32_t n = 0; n < 256; ++n) {
+    uint32_t reversed = 0;
+    for (uint32_t bit = 0; bit < 8; ++bit) {
+      reversed |= ((n >> bit) & 1) << (7 - bit);
+    }
+    table[n] = static_cast<uint8_t>(reversed);
+  }
+  return table;
+}();
+
+// Each plane's bit is shifted to the top of its byte and gathered with
+// movemask. Shifting 16-bit lanes lets bits of the low byte into the high
+// one, but never as far as its top bit. Returns the pixels done.
+IFF_TARGET_SSE2 static const uint32_t
+ToPlanar_SSE2(const uint8_t *indices, const uint32_t width,
+              const uint16_t planes, uint8_t *planar, const size_t row_bytes) {
+  uint32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const auto pixels =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(indices + x));
+    for (uint16_t p = 0; p < planes; ++p) {
+      const auto bits = _mm_movemask_epi8(_mm_slli_epi16(pixels, 7 - p));
+      auto *out = planar + p * row_bytes + x / 8;
+      out[0] = REVERSED[bits & 0xff];
+      out[1] = REVERSED[(bits >> 8) & 0xff];
+    }
+  }
+  return x;
+}
+
+// Bytes are reversed within each group of eight first, so that movemask
+// yields planar bytes as they are.
+IFF_TARGET_AVX2 static const uint32_t
+ToPlanar_AVX2(const uint8_t *indices, const uint32_t width,
+              const uint16_t planes, uint8_t *planar, const size_t row_bytes) {
+  const auto order = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12,
+                                      11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 15,
+                                      14, 13, 12, 11, 10, 9, 8);
+  uint32_t x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const auto pixels = _mm256_shuffle_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indices + x)),
+        order);
+    for (uint16_t p = 0; p < planes; ++p) {
+      const auto bits = static_cast<uint32_t>(
+          _mm256_movemask_epi8(_mm256_slli_epi16(pixels, 7 - p)));
+      std::memcpy(planar + p * row_bytes + x / 8, &bits, 4);
+    }
+  }
+  return x;
+}
+#endif
+
+void IFFReader::ChunkyToPlanar(const uint8_t *indices, const uint32_t width,
+                               const uint16_t planes, uint8_t *planar,
+                               const size_t row_bytes, const SimdLevel level) {
+  for (uint16_t p = 0; p < planes; ++p) {
+    std::fill(planar + p * row_bytes + width / 8,
+              planar + (p + 1) * row_bytes, 0);
+  }
+
+  uint32_t done = 0;
+#if IFF_SIMD_X86
+  if (level == SimdLevel::AVX2) {
+    done = ToPlanar_AVX2(indices, width, planes, planar, row_bytes);
+  } else if (level == SimdLevel::SSE2) {
+    done = ToPlanar_SSE2(indices, width, planes, planar, row_bytes);
+  }
+#endif
+  ToPlanar(indices, done, width, planes, planar, row_bytes);
+}
+
+// Fewest bytes for the first i bytes, found for every i in turn. The last
+// code either repeats one byte 2 to 128 times (two bytes), or copies 1 to
+// 128 bytes as they are (one byte more than it copies).
+void IFFReader::PackByteRun1(const uint8_t *bytes, const size_t size,
+                             bytefield &out) {
+  vector<size_t> cost(size + 1, 0);
+  vector<uint8_t> length(size + 1, 0);
+  vector<bool> repeat(size + 1, false);
+
+  size_t same = 0; // Equal bytes ending at i - 1.
+  for (size_t i = 1; i <= size; ++i) {
+    same = i > 1 && bytes[i - 1] == bytes[i - 2] ? same + 1 : 1;
+
+    cost[i] = SIZE_MAX;
+    for (size_t run = 1; run <= std::min(i, MAX_RUN); ++run) {
+      const auto literal = cost[i - run] + 1 + run;
+      if (literal < cost[i]) {
+        cost[i] = literal;
+        length[i] = static_cast<uint8_t>(run - 1);
+        repeat[i] = false;
+      }
+      if (run >= 2 && run <= same && cost[i - run] + 2 < cost[i]) {
+        cost[i] = cost[i - run] + 2;
+        length[i] = static_cast<uint8_t>(run - 1);
+        repeat[i] = true;
+      }
+    }
+  }
+
+  // Codes are found last to first, then written first to last.
+  vector<size_t> ends;
+  for (auto i = size; i > 0; i -= length[i] + size_t(1)) {
+    ends.push_back(i);
+  }
+
+  out.reserve(out.size() + cost[size]);
+  for (auto end = ends.rbegin(); end != ends.rend(); ++end) {
+    const auto run = length[*end] + size_t(1);
+    const auto *start = bytes + *end - run;
+    if (repeat[*end]) {
+      out.push_back(static_cast<uint8_t>(1 - static_cast<int>(run)));
+      out.push_back(*start);
+    } else {
+      out.push_back(static_cast<uint8_t>(run - 1));
+      out.insert(out.end(), start, start + run);
+    }
+  }
+}
+
+static void PutWord(bytefield &out, const uint32_t value) {
+  out.push_back(static_cast<uint8_t>(value >> 8));
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+static void PutLong(bytefield &out, const uint32_t value) {
+  PutWord(out, value >> 16);
+  PutWord(out, value & 0xffff);
+}
+
+// Tag, big endian size, data, and a pad byte if the size is odd.
+static void PutChunk(bytefield &out, const char *tag, const bytefield &data) {
+  out.insert(out.end(), tag, tag + 4);
+  PutLong(out, static_cast<uint32_t>(data.size()));
+  out.insert(out.end(), data.begin(), data.end());
+  if (data.size() % 2 != 0) {
+    out.push_back(0);
+  }
+}
+
+const bytefield IFFReader::EncodeILBM(const IndexedImage &image,
+                                      const ILBMSettings &settings) {
+  // Indices are bytes, so eight planes at most.
+  auto planes = std::min<uint16_t>(settings.planes, 8);
+  if (planes == 0) {
+    planes = 1;
+    while (planes < 8 && image.palette.size() > 1u << planes) {
+      ++planes;
+    }
+  }
+
+  const auto width = image.width;
+  const auto height = image.height;
+  const size_t row_bytes = (width + 15) / 16 * 2;
+
+  // Rows are packed in parallel into a buffer each, then joined.
+  vector<bytefield> rows(height);
+  ThreadPool::Shared().ParallelFor(
+      0, height, 16, [&](const size_t first, const size_t last) {
+        vector<uint8_t> planar(row_bytes * planes);
+        for (auto y = first; y < last; ++y) {
+          ChunkyToPlanar(image.indices + y * image.stride, width, planes,
+                         planar.data(), row_bytes);
+          if (!settings.compress) {
+            rows[y].assign(planar.begin(), planar.end());
+            continue;
+          }
+          for (uint16_t p = 0; p < planes; ++p) {
+            PackByteRun1(planar.data() + p * row_bytes, row_bytes, rows[y]);
+          }
+        }
+      });
+
+  bytefield header;
+  PutWord(header, width);
+  PutWord(header, height);
+  PutLong(header, 0); // Position.
+  header.push_back(static_cast<uint8_t>(planes));
+  header.push_back(0); // No mask.
+  header.push_back(settings.compress ? 1 : 0);
+  header.push_back(0); // Padding.
+  PutWord(header, 0);  // Transparent color.
+  header.push_back(settings.x_aspect);
+  header.push_back(settings.y_aspect);
+  PutWord(header, settings.page_width ? settings.page_width : width);
+  PutWord(header, settings.page_height ? settings.page_height : height);
+
+  // EHB halves the stored colors, HAM keeps two planes for its controls.
+  auto colors = size_t(1) << planes;
+  if (settings.view_modes & CAMG_HAM) {
+    colors = size_t(1) << std::max(planes - 2, 1);
+  } else if (settings.view_modes & CAMG_EHB) {
+    colors = size_t(1) << std::max(planes - 1, 1);
+  }
+
+  bytefield palette;
+  for (size_t i = 0; i < colors; ++i) {
+    const auto color = i < image.palette.size() ? image.palette[i] : 0;
+    palette.push_back(static_cast<uint8_t>(color));
+    palette.push_back(static_cast<uint8_t>(color >> 8));
+    palette.push_back(static_cast<uint8_t>(color >> 16));
+  }
+
+  bytefield body;
+  size_t body_size = 0;
+  for (const auto &row : rows) {
+    body_size += row.size();
+  }
+  body.reserve(body_size);
+  for (auto &row : rows) {
+    body.insert(body.end(), row.begin(), row.end());
+    bytefield().swap(row);
+  }
+
+  bytefield form = {'I', 'L', 'B', 'M'};
+  PutChunk(form, "BMHD", header);
+  PutChunk(form, "CMAP", palette);
+  if (settings.view_modes != 0) {
+    bytefield modes;
+    PutLong(modes, settings.view_modes);
+    PutChunk(form, "CAMG", modes);
+  }
+  PutChunk(form, "BODY", body);
+
+  bytefield file;
+  file.reserve(form.size() + 8);
+  PutChunk(file, "FORM", form);
+  return file;
+}
+
+const bytefield IFFReader::EncodeILBM(const ILBM &image, const bool compress) {
+  ILBMSettings settings;
+  settings.planes = image.bitplanes_count();
+  settings.view_modes = image.ViewModes();
+  settings.compress = compress;
+  if (image.x_aspect() != 0 && image.y_aspect() != 0) {
+    settings.x_aspect = image.x_aspect();
+    settings.y_aspect = image.y_aspect();
+  }
+  return EncodeILBM(image.GetIndexed(), settings);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "IndexedImage.h"
+#include "InterleavedBitmap.h"
+#include "Simd.h"
+#include "utility.h"
+
+/*
+ * Writing ILBM files: FORM, BMHD, CMAP, CAMG and BODY, from chunky indices
+ * and a palette. Each row of indices is split into bitplanes and every
+ * plane's row packed with ByteRun1 on its own, as the format requires; rows
+ * are done in parallel and joined in order.
+ *
+ * Packing is optimal rather than greedy: a row is split into literal and
+ * repeat runs by dynamic programming, giving the fewest bytes ByteRun1 can
+ * hold that row in. Rows are padded to whole words, as the format says.
+ */
+namespace IFFReader {
+
+// What BMHD and CAMG say about an image beyond its size.
+struct ILBMSettings {
+  // Bitplanes; zero for as many as the palette needs.
+  uint16_t planes = 0;
+
+  // CAMG contents (HAM, EHB, LACE, HIRES...); no CAMG chunk if zero.
+  uint32_t view_modes = 0;
+
+  // ByteRun1 if set, uncompressed rows otherwise.
+  bool compress = true;
+
+  // Pixel aspect as x:y, and the screen the image was made for (zero for
+  // the image's own size).
+  uint8_t x_aspect = 1;
+  uint8_t y_aspect = 1;
+  uint16_t page_width = 0;
+  uint16_t page_height = 0;
+};
+
+// Splits a row of chunky indices into planes, each row_bytes long; plane p
+// starts at planar + p * row_bytes. Bits past width are cleared.
+void ChunkyToPlanar(const uint8_t *indices, const uint32_t width,
+                    const uint16_t planes, uint8_t *planar,
+                    const size_t row_bytes,
+                    const SimdLevel level = DetectSimdLevel());
+
+// Appends size bytes packed with ByteRun1, in as few bytes as possible.
+void PackByteRun1(const uint8_t *bytes, const size_t size, bytefield &out);
+
+// The complete FORM ILBM. CMAP holds one color per index the planes can
+// hold, or the base colors only for EHB and HAM.
+const bytefield EncodeILBM(const IndexedImage &image,
+                           const ILBMSettings &settings = ILBMSettings());
+
+// Writes an image read earlier back out, keeping its planes, modes and
+// aspect. Palette changes down the screen and color ranges are not kept.
+const bytefield EncodeILBM(const ILBM &image, const bool compress = true);
+} // namespace IFFReader
@@ -0,0 +1,197 @@
+#include "ImageCache.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+using std::lock_guard;
+using std::make_shared;
+using std::mutex;
+using std::unique_lock;
+
+ImageCache::ImageCache(const size_t budget, const size_t neighbours)
+    : budget_(budget), neighbours_(neighbours) {}
+
+ImageCache::~ImageCache() {
+  unique_lock<mutex> lock(mutex_);
+  stopping_ = true;
+  decoded_.wait(lock, [this] { return pending_ == 0; });
+}
+
+const size_t ImageCache::Distance(const size_t a, const size_t b) const {
+  const auto d = a > b ? a - b : b - a;
+  return std::min(d, entries_.size() - d);
+}
+
+void ImageCache::Schedule(const size_t n) {
+  auto &entry = entries_[n];
+  if (entry.image || entry.decoding || entry.failed || stopping_) {
+    return;
+  }
+
+  entry.decoding = true;
+  ++pending_;
+  IFFReader::ThreadPool::Shared().Submit([this, n] { Decode(n); });
+}
+
+// Decoding happens outside the lock. An image the viewer has moved far
+// away from by the time it is decoded is still kept, if the budget allows.
+void ImageCache::Decode(const size_t n) {
+  fs::path path;
+  shared_ptr<const IFFReader::DecodeCache> decode_cache;
+  bool stopping;
+  {
+    lock_guard<mutex> lock(mutex_);
+    path = entries_[n].path;
+    decode_cache = decode_cache_;
+    stopping = stopping_;
+  }
+
+  shared_ptr<ImageFile> image;
+  if (!stopping) {
+    image = make_shared<ImageFile>(path, decode_cache.get());
+  }
+
+  lock_guard<mutex> lock(mutex_);
+  auto &entry = entries_[n];
+  entry.decoding = false;
+
+  if (image && image->IsLoaded()) {
+    entry.image = image;
+    entry.bytes = IFFReader::DecodedSize(entry.probe);
+    // Animations also hold the two buffers being played into, and two
+    // more at every keyframe, none of which the probe can know about.
+    if (const auto anim = image->GetAnimation()) {
+      const auto planar = anim->FirstPlanes().bytes.size();
+      entry.bytes += (anim->KeyframeCount() + 1) * 2 * planar;
+    }
+    resident_bytes_ += entry.bytes;
+    Evict();
+  } else if (!stopping) {
+    entry.failed = true;
+    entry.error = image ? image->Error() : string();
+    if (entry.error.empty()) {
+      entry.error = "Could not be opened.\n";
+    }
+  }
+
+  --pending_;
+  decoded_.notify_all();
+}
+
+void ImageCache::Evict() {
+  while (resident_bytes_ > budget_) {
+    Entry *oldest = nullptr;
+
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      auto &entry = entries_[i];
+      if (!entry.image || Distance(i, current_) <= neighbours_) {
+        continue;
+      }
+      if (!oldest || entry.last_viewed < oldest->last_viewed) {
+        oldest = &entry;
+      }
+    }
+
+    if (!oldest) {
+      return; // Only the neighbourhood is left; it stays, budget or not.
+    }
+
+    oldest->image.reset();
+    resident_bytes_ -= oldest->bytes;
+    oldest->bytes = 0;
+  }
+}
+
+void ImageCache::SetLimits(const size_t budget, const size_t neighbours) {
+  lock_guard<mutex> lock(mutex_);
+  budget_ = budget;
+  neighbours_ = neighbours;
+  Evict();
+}
+
+void ImageCache::SetDecodeCache(
+    shared_ptr<const IFFReader::DecodeCache> decode_cache) {
+  lock_guard<mutex> lock(mutex_);
+  decode_cache_ = std::move(decode_cache);
+}
+
+const bool ImageCache::Add(const fs::path &path) {
+  const auto probe = IFFReader::Probe(path);
+  if (!probe.valid) {
+    return false;
+  }
+
+  lock_guard<mutex> lock(mutex_);
+  Entry entry;
+  entry.path = path;
+  entry.probe = probe;
+  entries_.emplace_back(std::move(entry));
+
+  // Images arriving within reach of the current one are decoded right away.
+  const auto n = entries_.size() - 1;
+  if (Distance(n, current_) <= neighbours_) {
+    Schedule(n);
+  }
+  return true;
+}
+
+const size_t ImageCache::Size() const {
+  lock_guard<mutex> lock(mutex_);
+  return entries_.size();
+}
+
+const fs::path ImageCache::Path(const size_t n) const {
+  lock_guard<mutex> lock(mutex_);
+  return entries_.at(n).path;
+}
+
+const IFFReader::ImageProbe ImageCache::Probe(const size_t n) const {
+  lock_guard<mutex> lock(mutex_);
+  return entries_.at(n).probe;
+}
+
+// The current image is decoded first, then neighbours from nearest to
+// farthest, forward before back.
+void ImageCache::View(const size_t n) {
+  lock_guard<mutex> lock(mutex_);
+  if (n >= entries_.size()) {
+    return;
+  }
+
+  current_ = n;
+  entries_[n].last_viewed = ++clock_;
+
+  const auto count = entries_.size();
+  const auto reach = std::min(neighbours_, count / 2);
+  Schedule(n);
+  for (size_t d = 1; d <= reach; ++d) {
+    Schedule((n + d) % count);
+    Schedule((n + count - d) % count);
+  }
+}
+
+shared_ptr<ImageFile> ImageCache::Get(const size_t n) const {
+  lock_guard<mutex> lock(mutex_);
+  return n < entries_.size() ? entries_[n].image : shared_ptr<ImageFile>();
+}
+
+const bool ImageCache::Failed(const size_t n) const {
+  lock_guard<mutex> lock(mutex_);
+  return n < entries_.size() && entries_[n].failed;
+}
+
+const string ImageCache::Error(const size_t n) const {
+  lock_guard<mutex> lock(mutex_);
+  return n < entries_.size() ? entries_[n].error : string();
+}
+
+const size_t ImageCache::ResidentBytes() const {
+  lock_guard<mutex> lock(mutex_);
+  return resident_bytes_;
+}
+
+const size_t ImageCache::ResidentCount() const {
+  lock_guard<mutex> lock(mutex_);
+  return std::count_if(begin(entries_), end(entries_),
+                       [](const Entry &e) { return e.image != nullptr; });
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "ImageFile.h"
+#include "ImageProbe.h"
+
+#include <condition_variable>
+#include <mutex>
+
+using std::shared_ptr;
+using std::vector;
+
+/*
+ * Keeps decoded images for a folder of any size. Every file is probed when
+ * added, which is cheap; only the image being viewed and a few neighbours
+ * on either side are decoded, on the thread pool, ahead of the viewer
+ * getting to them. Once decoded images exceed the memory budget, those
+ * viewed longest ago are dropped, and decoded again if they come back.
+ *
+ * All members may be called from any thread.
+ */
+class ImageCache {
+  struct Entry {
+    fs::path path;
+    IFFReader::ImageProbe probe;
+    shared_ptr<ImageFile> image;
+    size_t bytes = 0;
+    uint64_t last_viewed = 0;
+    bool decoding = false;
+    bool failed = false;
+    string error;
+  };
+
+  vector<Entry> entries_;
+  mutable std::mutex mutex_;
+  std::condition_variable decoded_;
+
+  shared_ptr<const IFFReader::DecodeCache> decode_cache_;
+
+  size_t budget_;
+  size_t neighbours_;
+  size_t resident_bytes_ = 0;
+  size_t current_ = 0;
+  size_t pending_ = 0;
+  uint64_t clock_ = 0;
+  bool stopping_ = false;
+
+  // Distance between two entries, wrapping around as navigation does.
+  const size_t Distance(const size_t a, const size_t b) const;
+
+  // Queues a decode unless the entry is decoded, being decoded or known to
+  // be broken.
+  // Caller holds the lock.
+  void Schedule(const size_t n);
+
+  // Decodes an entry on a pool thread.
+  void Decode(const size_t n);
+
+  // Drops least recently viewed images outside the current neighbourhood
+  // until within budget. Caller holds the lock.
+  void Evict();
+
+public:
+  // Budget in bytes; neighbours on each side of the current image.
+  ImageCache(const size_t budget = size_t(512) << 20,
+             const size_t neighbours = 2);
+
+  // Waits for decodes in flight.
+  ~ImageCache();
+
+  // Changes the budget and look-ahead, evicting if needed.
+  void SetLimits(const size_t budget, const size_t neighbours);
+
+  // Sidecar cache images are loaded through; none if empty.
+  void SetDecodeCache(shared_ptr<const IFFReader::DecodeCache> decode_cache);
+
+  // Probes the file and adds it if it is an image.
+  const bool Add(const fs::path &path);
+
+  // Number of images added.
+  const size_t Size() const;
+
+  // Path of image n.
+  const fs::path Path(const size_t n) const;
+
+  // Metadata of image n, available whether decoded or not.
+  const IFFReader::ImageProbe Probe(const size_t n) const;
+
+  // Makes n the current image: decodes it and its neighbours ahead of
+  // time, and marks it as recently viewed.
+  void View(const size_t n);
+
+  // Decoded image n, or empty if it is not decoded (yet).
+  shared_ptr<ImageFile> Get(const size_t n) const;
+
+  // Whether image n passed probing but could not be decoded. Such images
+  // are not tried again.
+  const bool Failed(const size_t n) const;
+
+  // Why image n could not be decoded; empty if it was, or still may be.
+  const string Error(const size_t n) const;
+
+  // Memory taken by decoded images, by estimate.
+  const size_t ResidentBytes() const;
+
+  // Number of images currently decoded.
+  const size_t ResidentCount() const;
+};
@@ -0,0 +1,186 @@
+#include "ImageExport.h"
+#include "PNGEncoder.h"
+#include "PixelFormat.h"
+#include "ThreadPool.h"
+
+#include <cstring>
+#include <functional>
+
+const IFFReader::ResolvedImage
+IFFReader::ResolveImage(const ILBM &image, const bool correct_aspect,
+                        const ScaleFilter filter) {
+  ResolvedImage resolved;
+  resolved.width = image.width();
+  resolved.height = image.height();
+  resolved.pixels.resize(static_cast<size_t>(resolved.width) *
+                         resolved.height);
+
+  const auto stride = static_cast<size_t>(resolved.width);
+  auto *pixels = resolved.pixels.data();
+  ThreadPool::Shared().ParallelFor(
+      0, resolved.height, 32, [&](const size_t first, const size_t last) {
+        image.ResolveRows(static_cast<uint32_t>(first),
+                          static_cast<uint32_t>(last), pixels + first * stride,
+                          stride);
+      });
+
+  if (!correct_aspect) {
+    return resolved;
+  }
+
+  const auto scaler = image.AspectCorrection(filter);
+  if (!scaler.Scales()) {
+    return resolved;
+  }
+
+  ResolvedImage scaled;
+  scaled.width = scaler.Width();
+  scaled.height = scaler.Height();
+  scaled.pixels.resize(static_cast<size_t>(scaled.width) * scaled.height);
+  scaler.Scale(resolved.pixels.data(), resolved.width, scaled.pixels.data(),
+               scaled.width);
+  return scaled;
+}
+
+const bool IFFReader::ParseExportFormat(const string &name,
+                                        ExportFormat &format) {
+  if (name == "ppm") {
+    format = ExportFormat::PPM;
+  } else if (name == "pam") {
+    format = ExportFormat::PAM;
+  } else if (name == "raw") {
+    format = ExportFormat::Raw;
+  } else if (name == "png") {
+    format = ExportFormat::PNG;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const string IFFReader::ExportExtension(const ExportFormat format) {
+  switch (format) {
+  case ExportFormat::PPM:
+    return ".ppm";
+  case ExportFormat::PAM:
+    return ".pam";
+  case ExportFormat::PNG:
+    return ".png";
+  case ExportFormat::Raw:
+  default:
+    return ".raw";
+  }
+}
+
+// Header and pixels of the formats written uncompressed.
+struct Uncompressed {
+  string header;
+  IFFReader::PixelFormat format = IFFReader::PixelFormat::RGBA8;
+  size_t pixel_bytes = 4;
+};
+
+static const Uncompressed Layout(const IFFReader::ExportFormat format,
+                                 const uint32_t width, const uint32_t height) {
+  const auto w = std::to_string(width);
+  const auto h = std::to_string(height);
+  switch (format) {
+  case IFFReader::ExportFormat::PPM:
+    return {"P6\n" + w + " " + h + "\n255\n",
+            IFFReader::PixelFormat::RGB888, 3};
+  case IFFReader::ExportFormat::PAM:
+    return {"P7\nWIDTH " + w + "\nHEIGHT " + h +
+                "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n",
+            IFFReader::PixelFormat::RGBA8, 4};
+  case IFFReader::ExportFormat::Raw:
+  default:
+    return {"", IFFReader::PixelFormat::RGBA8, 4}; // 0xAABBGGRR in memory.
+  }
+}
+
+// Writes rows [first, last) in the given format, stride bytes apart.
+using RowWriter =
+    std::function<void(const uint32_t first, const uint32_t last,
+                       const IFFReader::PixelFormat format, uint8_t *rows,
+                       const size_t stride)>;
+
+// The file is allocated once at its final size, and bands of rows written
+// straight into it in parallel, leaving nothing to do but write it out.
+static const bytefield EncodeUncompressed(const IFFReader::ExportFormat format,
+                                          const uint32_t width,
+                                          const uint32_t height,
+                                          const RowWriter &write) {
+  const auto layout = Layout(format, width, height);
+  const auto row_bytes = static_cast<size_t>(width) * layout.pixel_bytes;
+
+  bytefield file(layout.header.size() + row_bytes * height);
+  std::memcpy(file.data(), layout.header.data(), layout.header.size());
+  auto *pixels = file.data() + layout.header.size();
+  IFFReader::ThreadPool::Shared().ParallelFor(
+      0, height, 32, [&](const size_t first, const size_t last) {
+        write(static_cast<uint32_t>(first), static_cast<uint32_t>(last),
+              layout.format, pixels + first * row_bytes, row_bytes);
+      });
+  return file;
+}
+
+const bytefield IFFReader::EncodeImage(const ResolvedImage &image,
+                                       const ExportFormat format) {
+  if (format == ExportFormat::PNG) {
+    return EncodePNG(image);
+  }
+
+  return EncodeUncompressed(
+      format, image.width, image.height,
+      [&](const uint32_t first, const uint32_t last,
+          const PixelFormat pixel_format, uint8_t *rows, const size_t stride) {
+        ConvertRows(image.pixels.data() + static_cast<size_t>(first) *
+                                              image.width,
+                    image.width, last - first, image.width, pixel_format, rows,
+                    stride);
+      });
+}
+
+// Unless pixels are scaled, rows are resolved straight into the file.
+const bytefield IFFReader::EncodeImage(const ILBM &image,
+                                       const ExportFormat format,
+                                       const bool correct_aspect,
+                                       const ScaleFilter filter) {
+  if (correct_aspect && image.AspectCorrection(filter).Scales()) {
+    return EncodeImage(ResolveImage(image, correct_aspect, filter), format);
+  }
+
+  if (format == ExportFormat::PNG) {
+    return EncodePNG(image);
+  }
+
+  return EncodeUncompressed(
+      format, image.width(), image.height(),
+      [&](const uint32_t first, const uint32_t last,
+          const PixelFormat pixel_format, uint8_t *rows, const size_t stride) {
+        image.ResolveRows(first, last, pixel_format, rows, stride);
+      });
+}
+
+const bool IFFReader::WriteBytes(const fs::path &path,
+                                 const bytefield &bytes) {
+  std::ofstream stream(path, std::ios::binary);
+  if (!stream.is_open()) {
+    return false;
+  }
+  stream.write(reinterpret_cast<const char *>(bytes.data()),
+               static_cast<std::streamsize>(bytes.size()));
+  return static_cast<bool>(stream);
+}
+
+const bool IFFReader::WriteImage(const fs::path &path,
+                                 const ResolvedImage &image,
+                                 const ExportFormat format) {
+  return WriteBytes(path, EncodeImage(image, format));
+}
+
+const bool IFFReader::WriteImage(const fs::path &path, const ILBM &image,
+                                 const ExportFormat format,
+                                 const bool correct_aspect,
+                                 const ScaleFilter filter) {
+  return WriteBytes(path, EncodeImage(image, format, correct_aspect, filter));
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "InterleavedBitmap.h"
+#include "utility.h"
+
+/*
+ * Decoding and writing whole images with no display involved, for batch
+ * conversion on machines without one. Nothing here depends on the viewer.
+ *
+ * Files are encoded in memory first, then written with a single call, so
+ * that slow disks and network shares see one large write per image.
+ */
+namespace IFFReader {
+
+// An image resolved to 0xAABBGGRR pixels, width pixels per row.
+struct ResolvedImage {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  vector<uint32_t> pixels;
+};
+
+enum class ExportFormat {
+  PPM, // Binary RGB (P6); alpha is dropped.
+  PAM, // RGBA (P7, RGB_ALPHA); the raw words with a header.
+  Raw, // 0xAABBGGRR words, as in the regression test dumps.
+  PNG  // Indexed where the image allows, RGBA otherwise (see PNGEncoder.h).
+};
+
+// Resolves every row, bands of rows spread over the thread pool. With
+// correct_aspect, pixels are made square according to BMHD.
+const ResolvedImage
+ResolveImage(const ILBM &image, const bool correct_aspect = false,
+             const ScaleFilter filter = ScaleFilter::Cubic);
+
+// Format named as on the command line: "ppm", "pam", "png" or "raw".
+// Returns false for any other name.
+const bool ParseExportFormat(const string &name, ExportFormat &format);
+
+// File name extension for the format, dot included.
+const string ExportExtension(const ExportFormat format);
+
+// The complete file contents for the image in the given format.
+const bytefield EncodeImage(const ResolvedImage &image,
+                            const ExportFormat format);
+
+// As above, straight from the image. Without aspect correction, rows are
+// resolved straight into the file (or, for PNG, into the bands being
+// compressed), and PNG files kept indexed if the image is.
+const bytefield EncodeImage(const ILBM &image, const ExportFormat format,
+                            const bool correct_aspect = false,
+                            const ScaleFilter filter = ScaleFilter::Cubic);
+
+// Writes the bytes with a single call. Returns false if the file could not
+// be written.
+const bool WriteBytes(const fs::path &path, const bytefield &bytes);
+
+// Encodes and writes the image. Returns false if the file could not be
+// written.
+const bool WriteImage(const fs::path &path, const ResolvedImage &image,
+                      const ExportFormat format);
+const bool WriteImage(const fs::path &path, const ILBM &image,
+                      const ExportFormat format,
+                      const bool correct_aspect = false,
+                      const ScaleFilter filter = ScaleFilter::Cubic);
+} // namespace IFFReader
@@ -25,21 +25,47 @@ const string ImageFile::ErrorMessage(const IFFReader::File &f) const {
   return string();
 }
 
-ImageFile::ImageFile(const fs::path &path) : filepath(path), loaded(false) {
+// Files the cache cannot open are read again below, for the error message;
+// animations, which it does not keep, are only read below.
+ImageFile::ImageFile(const fs::path &path,
+                     const IFFReader::DecodeCache *decode_cache)
+    : filepath(path), loaded(false) {
+  if (decode_cache) {
+    ilbm = decode_cache->Open(path);
+    if (ilbm) {
+      loaded = true;
+      return;
+    }
+  }
+
   file = unique_ptr<IFFReader::File>(new IFFReader::File(path.string()));
 
   if (const string error_text = ErrorMessage(*file.get());
       !error_text.empty()) {
     cout << error_text;
+    error = error_text;
     return;
   }
 
-  ilbm = make_shared<IFFReader::ILBM>(*file->AsILBM());
+  // Animations are indexed here, while decoding ahead of the viewer.
+  if (file->GetType() == IFFReader::IFF_T::ANIM) {
+    anim = file->AsANIM();
+    anim->IndexKeyframes();
+    ilbm = anim->Image();
+  } else {
+    ilbm = make_shared<IFFReader::ILBM>(*file->AsILBM());
+  }
   loaded = true;
 }
 
 shared_ptr<IFFReader::ILBM> ImageFile::Get() const { return ilbm; }
 
+shared_ptr<IFFReader::ANIM> ImageFile::GetAnimation() const { return anim; }
+
+const IFFReader::IndexedImage ImageFile::GetIndexed() const {
+  return ilbm->GetIndexed();
+}
+
 const string ImageFile::Path() const {
     return filepath.generic_string();
 }
@@ -56,4 +82,6 @@ const void ImageFile::ApplyOCSColourCorrection(const bool apply) {
   ilbm->color_correction(apply);
 }
 
+const string ImageFile::Error() const { return error; }
+
 const bool ImageFile::IsLoaded() const { return loaded; }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "DecodeCache.h"
 #include "FileData.h"
 #include <filesystem>
 
@@ -13,18 +14,34 @@ class ImageFile {
   fs::path filepath;
   unique_ptr<IFFReader::File> file;
   shared_ptr<IFFReader::ILBM> ilbm;
+  shared_ptr<IFFReader::ANIM> anim;
+  string error;
   bool loaded;
 
 public:
   ImageFile() : loaded(false) {}
-  ImageFile(const fs::path &path);
+  // Loads through the decode cache, if given, so that images seen before
+  // are not decoded again.
+  ImageFile(const fs::path &path,
+            const IFFReader::DecodeCache *decode_cache = nullptr);
 
   // User friendly error message.
   const string ErrorMessage(const IFFReader::File &f) const;
 
+  // Why the file could not be loaded; empty if it was.
+  const string Error() const;
+
   // Returns actual ILBM. Possible refactor candidate (to avoid passing ptrs).
   shared_ptr<IFFReader::ILBM> Get() const;
 
+  // Returns the animation, indexed for seeking, whose current frame Get()
+  // shows; empty for still images.
+  shared_ptr<IFFReader::ANIM> GetAnimation() const;
+
+  // Returns chunky indices plus effective palette, a byte per pixel.
+  // Indices live as long as this handler's image does.
+  const IFFReader::IndexedImage GetIndexed() const;
+
   // Returns the image path.
   const string Path() const;
 
@@ -0,0 +1,71 @@
+#include "ImageProbe.h"
+
+// Chunks before BMHD (rare, but allowed) are skipped, pad bytes included.
+const IFFReader::ImageProbe IFFReader::Probe(const fs::path &path) {
+  ImageProbe probe;
+  std::error_code error;
+
+  probe.file_size = fs::file_size(path, error);
+  if (error) {
+    return probe;
+  }
+
+  bytefilestream stream(path, std::ios::binary);
+  if (!stream.is_open()) {
+    return probe;
+  }
+
+  try {
+    if (read_tag(stream) != "FORM") {
+      return probe;
+    }
+    read_long(stream);
+    auto form = read_tag(stream);
+
+    // An animation is described by its first frame, a FORM ILBM of its own.
+    if (form == "ANIM") {
+      probe.animation = true;
+      if (read_tag(stream) != "FORM") {
+        return probe;
+      }
+      read_long(stream);
+      form = read_tag(stream);
+    }
+    if (form != "ILBM") {
+      return probe;
+    }
+
+    while (stream.good()) {
+      const auto tag = read_tag(stream);
+      const auto size = read_long(stream);
+
+      if (!stream.good()) {
+        break;
+      }
+
+      if (tag == "BMHD") {
+        probe.width = read_word(stream);
+        probe.height = read_word(stream);
+        stream.ignore(4); // Position.
+        probe.bitplanes = read_byte(stream);
+        stream.ignore(1); // Masking.
+        probe.compression = read_byte(stream);
+        probe.valid = stream.good();
+        break;
+      }
+
+      stream.seekg(size + (size & 1), std::ios::cur);
+    }
+  } catch (...) {
+    probe.valid = false;
+  }
+
+  return probe;
+}
+
+const size_t IFFReader::DecodedSize(const ImageProbe &probe) {
+  const auto pixels = static_cast<size_t>(probe.width) * probe.height;
+  const auto planar = static_cast<size_t>((probe.width + 15) / 16) * 2 *
+                      probe.bitplanes * probe.height;
+  return pixels + planar + static_cast<size_t>(probe.file_size);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "utility.h"
+
+/*
+ * Opening an image fully means decompressing its body and converting it to
+ * chunky pixels. Browsing a large folder only needs to know which files are
+ * images and how big they are; probing reads the FORM header and BMHD chunk
+ * and stops there.
+ */
+namespace IFFReader {
+
+struct ImageProbe {
+  // Whether this is an ILBM with a bitmap header, or an animation whose
+  // first frame is one.
+  bool valid = false;
+  bool animation = false;
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint16_t bitplanes = 0;
+  uint8_t compression = 0;
+
+  // Size of the file on disk, in bytes.
+  uintmax_t file_size = 0;
+};
+
+// Reads just enough of the file to describe it. Never throws.
+const ImageProbe Probe(const fs::path &path);
+
+// Rough memory taken by the image once decoded: compressed and planar data
+// plus chunky indices.
+const size_t DecodedSize(const ImageProbe &probe);
+} // namespace IFFReader
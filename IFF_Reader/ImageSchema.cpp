@@ -0,0 +1,213 @@
+#include "ImageSchema.h"
+
+// LZ4 block format: every sequence is a token (literal count in the high
+// nibble, match length less four in the low one, 15 meaning more bytes of
+// up to 255 follow), the literals, and a little endian match offset. The
+// last sequence has literals only; matches end at least five bytes before
+// the end, and start at least twelve before it.
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t LAST_LITERALS = 5;
+constexpr size_t MATCH_LIMIT = 12;
+constexpr size_t MAX_OFFSET = 65535;
+constexpr uint32_t HASH_BITS = 16;
+
+static const uint32_t Read32(const uint8_t *bytes) {
+  uint32_t value;
+  std::memcpy(&value, bytes, 4);
+  return value;
+}
+
+static const uint32_t Hash(const uint32_t value) {
+  return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// A length of 15 or more, past the token's nibble.
+static void PutLength(size_t length, bytefield &out) {
+  for (; length >= 255; length -= 255) {
+    out.push_back(255);
+  }
+  out.push_back(static_cast<uint8_t>(length));
+}
+
+static void PutSequence(const uint8_t *literals, const size_t literal_count,
+                        const size_t offset, const size_t match,
+                        bytefield &out) {
+  const auto extra = match > 0 ? match - MIN_MATCH : 0;
+  out.push_back(static_cast<uint8_t>(std::min<size_t>(literal_count, 15) << 4 |
+                                     std::min<size_t>(extra, 15)));
+  if (literal_count >= 15) {
+    PutLength(literal_count - 15, out);
+  }
+  out.insert(out.end(), literals, literals + literal_count);
+  if (match == 0) {
+    return;
+  }
+  out.push_back(static_cast<uint8_t>(offset));
+  out.push_back(static_cast<uint8_t>(offset >> 8));
+  if (extra >= 15) {
+    PutLength(extra - 15, out);
+  }
+}
+
+void IFFReader::PackLZ(const uint8_t *bytes, const size_t size,
+                       bytefield &out) {
+  size_t anchor = 0;
+  if (size > MATCH_LIMIT) {
+    // Last position seen with each hash, plus one; zero for none yet.
+    vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+    const auto limit = size - MATCH_LIMIT;
+    for (size_t i = 0; i < limit;) {
+      const auto value = Read32(bytes + i);
+      auto &entry = table[Hash(value)];
+      const size_t candidate = entry;
+      entry = static_cast<uint32_t>(i + 1);
+      if (candidate == 0 || i - (candidate - 1) > MAX_OFFSET ||
+          Read32(bytes + candidate - 1) != value) {
+        ++i;
+        continue;
+      }
+
+      const auto *match = bytes + candidate - 1;
+      auto length = MIN_MATCH;
+      while (i + length < size - LAST_LITERALS &&
+             match[length] == bytes[i + length]) {
+        ++length;
+      }
+      PutSequence(bytes + anchor, i - anchor, bytes + i - match, length, out);
+      i += length;
+      anchor = i;
+    }
+  }
+  PutSequence(bytes + anchor, size - anchor, 0, 0, out);
+}
+
+const bool IFFReader::UnpackByteRun1(const uint8_t *data, const size_t size,
+                                     const size_t expected, bytefield &out) {
+  out.clear();
+  out.reserve(expected);
+  const auto *end = data + size;
+  while (out.size() < expected && data < end) {
+    const auto code = static_cast<int8_t>(*data++);
+    if (code >= 0) {
+      const size_t count = code + 1;
+      if (static_cast<size_t>(end - data) < count ||
+          out.size() + count > expected) {
+        return false;
+      }
+      out.insert(out.end(), data, data + count);
+      data += count;
+    } else if (code != -128) { // -128 is a no-op.
+      const size_t count = 1 - code;
+      if (data == end || out.size() + count > expected) {
+        return false;
+      }
+      out.insert(out.end(), count, *data++);
+    }
+  }
+  return out.size() == expected;
+}
+
+// A length of 15 or more, read on from the token's nibble.
+static const bool GetLength(const uint8_t *&data, const uint8_t *end,
+                            size_t &length) {
+  uint8_t byte;
+  do {
+    if (data == end) {
+      return false;
+    }
+    byte = *data++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+const bool IFFReader::UnpackLZ(const uint8_t *data, const size_t size,
+                               const size_t expected, bytefield &out) {
+  out.clear();
+  out.reserve(expected);
+  const auto *end = data + size;
+  while (data < end) {
+    const auto token = *data++;
+    size_t literals = token >> 4;
+    if (literals == 15 && !GetLength(data, end, literals)) {
+      return false;
+    }
+    if (static_cast<size_t>(end - data) < literals ||
+        out.size() + literals > expected) {
+      return false;
+    }
+    out.insert(out.end(), data, data + literals);
+    data += literals;
+    if (data == end) {
+      break; // Literals only: the last sequence.
+    }
+
+    if (end - data < 2) {
+      return false;
+    }
+    const size_t offset = data[0] | data[1] << 8;
+    data += 2;
+    size_t length = token & 15;
+    if (length == 15 && !GetLength(data, end, length)) {
+      return false;
+    }
+    length += MIN_MATCH;
+    if (offset == 0 || offset > out.size() ||
+        out.size() + length > expected) {
+      return false;
+    }
+
+    // Byte by byte: a match may overlap what it copies.
+    auto from = out.size() - offset;
+    for (size_t i = 0; i < length; ++i) {
+      out.push_back(out[from++]);
+    }
+  }
+  return out.size() == expected;
+}
+
+void IFFReader::PutSchemaPalette(const vector<uint32_t> &palette,
+                                 const size_t count,
+                                 const PaletteFormat format, bytefield &out) {
+  for (size_t i = 0; i < count; ++i) {
+    const auto color = i < palette.size() ? palette[i] : 0;
+    const uint8_t r = color & 0xff;
+    const uint8_t g = (color >> 8) & 0xff;
+    const uint8_t b = (color >> 16) & 0xff;
+    if (format == PaletteFormat::RGB4) {
+      out.push_back(r >> 4);
+      out.push_back(static_cast<uint8_t>((g & 0xf0) | b >> 4));
+    } else {
+      out.push_back(r);
+      out.push_back(g);
+      out.push_back(b);
+    }
+  }
+}
+
+const bool IFFReader::GetSchemaPalette(const uint8_t *&data, size_t &size,
+                                       const size_t count,
+                                       const PaletteFormat format,
+                                       vector<uint32_t> &palette) {
+  const size_t bytes = format == PaletteFormat::RGB4 ? 2 : 3;
+  if (size < count * bytes) {
+    return false;
+  }
+
+  palette.resize(count);
+  for (size_t i = 0; i < count; ++i, data += bytes) {
+    uint32_t r, g, b;
+    if (format == PaletteFormat::RGB4) {
+      r = (data[0] & 0xf) * 0x11;
+      g = (data[1] >> 4) * 0x11;
+      b = (data[1] & 0xf) * 0x11;
+    } else {
+      r = data[0];
+      g = data[1];
+      b = data[2];
+    }
+    palette[i] = 0xff000000 | b << 16 | g << 8 | r;
+  }
+  size -= count * bytes;
+  return true;
+}
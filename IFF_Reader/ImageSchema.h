@@ -0,0 +1,293 @@
+#pragma once
+#include "ILBMWriter.h"
+#include "IndexedImage.h"
+#include "utility.h"
+
+#include <algorithm>
+#include <cstring>
+
+/*
+ * Images stored the way a custom project's runtime wants them, rather than
+ * as ILBM: the bits per pixel, how planes are laid out, how colors are
+ * stored and how the pixels are packed are all chosen by the project. A
+ * schema is a type, and its Encode and Decode are generated for it at
+ * compile time, so that the inner loops know the depth and layout and the
+ * runtime's decoder can be equally plain.
+ *
+ * A stored image is, in order:
+ *  - width, height and color count, as big endian words;
+ *  - the palette: RGB4 as one big endian word per color (0x0RGB, as the
+ *    Amiga's color registers), RGB8 as three bytes per color (R, G, B);
+ *  - the pixels, in lines of whole bytes, packed as a whole.
+ *
+ * Planar images hold all lines of plane 0, then all of plane 1, and so on;
+ * interleaved images hold plane 0 to the last of line 0, then of line 1 (as
+ * in ILBM BODY, without the word padding); chunky images hold Depth bits per
+ * pixel, leftmost pixel in the highest bits. ByteRun1 packs every line on
+ * its own, so lines can be unpacked one at a time. LZ packs all lines
+ * together in LZ4's block format, for which small decoders abound.
+ *
+ * For example, four planes of interleaved lines with twelve-bit colors:
+ *
+ *   using Sprite = ImageSchema<4, PlaneOrder::Interleaved,
+ *                              PaletteFormat::RGB4, Compression::ByteRun1>;
+ *   const auto stored = Sprite::Encode(image.GetIndexed());
+ */
+namespace IFFReader {
+
+enum class PlaneOrder { Planar, Interleaved, Chunky };
+enum class PaletteFormat { RGB4, RGB8 };
+enum class Compression { Uncompressed, ByteRun1, LZ };
+
+// An image read back from a schema. Colors are 0xAABBGGRR, opaque; RGB4
+// colors are widened by repeating each nibble.
+struct SchemaImage {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  vector<uint8_t> indices; // One byte per pixel, width per row.
+  vector<uint32_t> palette;
+};
+
+// Appends the palette, at most count colors (missing ones black).
+void PutSchemaPalette(const vector<uint32_t> &palette, const size_t count,
+                      const PaletteFormat format, bytefield &out);
+
+// Reads count colors at data, moving it past them. False if size is short.
+const bool GetSchemaPalette(const uint8_t *&data, size_t &size,
+                            const size_t count, const PaletteFormat format,
+                            vector<uint32_t> &palette);
+
+// Appends size bytes packed as an LZ4 block, matched greedily.
+void PackLZ(const uint8_t *bytes, const size_t size, bytefield &out);
+
+// Unpacks ByteRun1 or an LZ4 block into out, which must come out exactly
+// expected bytes long. False if the data is damaged or of another length.
+const bool UnpackByteRun1(const uint8_t *data, const size_t size,
+                          const size_t expected, bytefield &out);
+const bool UnpackLZ(const uint8_t *data, const size_t size,
+                    const size_t expected, bytefield &out);
+
+template <uint8_t Depth, PlaneOrder Order,
+          PaletteFormat Palette = PaletteFormat::RGB8,
+          Compression Packing = Compression::Uncompressed>
+struct ImageSchema {
+  static_assert(Depth >= 1 && Depth <= 8, "indices are bytes: 1 to 8 bits");
+
+  static constexpr uint8_t depth = Depth;
+  static constexpr PlaneOrder order = Order;
+  static constexpr PaletteFormat palette_format = Palette;
+  static constexpr Compression compression = Packing;
+  static constexpr size_t colors = size_t(1) << Depth;
+  static constexpr uint8_t mask = static_cast<uint8_t>(colors - 1);
+
+  // Bytes in one line: a plane's row, or a row of chunky pixels.
+  static constexpr size_t LineBytes(const uint32_t width) {
+    return Order == PlaneOrder::Chunky ? (size_t(width) * Depth + 7) / 8
+                                       : (size_t(width) + 7) / 8;
+  }
+
+  static constexpr size_t LineCount(const uint32_t height) {
+    return Order == PlaneOrder::Chunky ? height : size_t(height) * Depth;
+  }
+
+  // Where plane p of row y starts among the unpacked pixels.
+  static constexpr size_t PlaneOffset(const uint32_t width,
+                                      const uint32_t height, const uint32_t y,
+                                      const uint8_t p) {
+    return (Order == PlaneOrder::Planar ? size_t(p) * height + y
+                                        : size_t(y) * Depth + p) *
+           LineBytes(width);
+  }
+
+  // The image as the schema stores it. Indices are cut to Depth bits and
+  // the palette to as many colors as they can refer to.
+  static const bytefield Encode(const IndexedImage &image) {
+    const auto width = image.width;
+    const auto height = image.height;
+    const auto line_bytes = LineBytes(width);
+
+    bytefield pixels(line_bytes * LineCount(height), 0);
+    vector<uint8_t> row(width);
+    vector<uint8_t> planar(line_bytes * Depth);
+    for (uint32_t y = 0; y < height; ++y) {
+      const auto *indices = image.indices + y * image.stride;
+      for (uint32_t x = 0; x < width; ++x) {
+        row[x] = indices[x] & mask;
+      }
+
+      if constexpr (Order == PlaneOrder::Chunky) {
+        PackChunky(row.data(), width, pixels.data() + y * line_bytes);
+      } else if constexpr (Order == PlaneOrder::Interleaved) {
+        // Planes of a row already lie one after another.
+        ChunkyToPlanar(row.data(), width, Depth,
+                       pixels.data() + PlaneOffset(width, height, y, 0),
+                       line_bytes);
+      } else {
+        ChunkyToPlanar(row.data(), width, Depth, planar.data(), line_bytes);
+        for (uint8_t p = 0; p < Depth; ++p) {
+          std::memcpy(pixels.data() + PlaneOffset(width, height, y, p),
+                      planar.data() + p * line_bytes, line_bytes);
+        }
+      }
+    }
+
+    const auto count = std::min(image.palette.size(), colors);
+    bytefield out;
+    PutWord(out, width);
+    PutWord(out, height);
+    PutWord(out, static_cast<uint32_t>(count));
+    PutSchemaPalette(image.palette, count, Palette, out);
+
+    if constexpr (Packing == Compression::ByteRun1) {
+      for (size_t line = 0; line < LineCount(height); ++line) {
+        PackByteRun1(pixels.data() + line * line_bytes, line_bytes, out);
+      }
+    } else if constexpr (Packing == Compression::LZ) {
+      PackLZ(pixels.data(), pixels.size(), out);
+    } else {
+      out.insert(out.end(), pixels.begin(), pixels.end());
+    }
+    return out;
+  }
+
+  // Reads an image stored by Encode. False if the data is short, damaged,
+  // or holds more colors than Depth bits can refer to.
+  static const bool Decode(const uint8_t *data, size_t size,
+                           SchemaImage &image) {
+    if (size < 6) {
+      return false;
+    }
+    const auto width = GetWord(data);
+    const auto height = GetWord(data + 2);
+    const auto count = GetWord(data + 4);
+    data += 6;
+    size -= 6;
+    if (count > colors ||
+        !GetSchemaPalette(data, size, count, Palette, image.palette)) {
+      return false;
+    }
+
+    const auto line_bytes = LineBytes(width);
+    const auto expected = line_bytes * LineCount(height);
+    bytefield unpacked;
+    const uint8_t *pixels = data;
+    if constexpr (Packing == Compression::ByteRun1) {
+      if (!UnpackByteRun1(data, size, expected, unpacked)) {
+        return false;
+      }
+      pixels = unpacked.data();
+    } else if constexpr (Packing == Compression::LZ) {
+      if (!UnpackLZ(data, size, expected, unpacked)) {
+        return false;
+      }
+      pixels = unpacked.data();
+    } else if (size < expected) {
+      return false;
+    }
+
+    image.width = width;
+    image.height = height;
+    image.indices.assign(size_t(width) * height, 0);
+    for (uint32_t y = 0; y < height; ++y) {
+      auto *row = image.indices.data() + size_t(y) * width;
+      if constexpr (Order == PlaneOrder::Chunky) {
+        UnpackChunky(pixels + y * line_bytes, width, row);
+      } else {
+        const uint8_t *planes[Depth];
+        for (uint8_t p = 0; p < Depth; ++p) {
+          planes[p] = pixels + PlaneOffset(width, height, y, p);
+        }
+        PlanarToChunky(planes, width, row);
+      }
+    }
+    return true;
+  }
+
+  static const bool Decode(const bytefield &data, SchemaImage &image) {
+    return Decode(data.data(), data.size(), image);
+  }
+
+private:
+  static void PutWord(bytefield &out, const uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+  }
+
+  static const uint32_t GetWord(const uint8_t *data) {
+    return uint32_t(data[0]) << 8 | data[1];
+  }
+
+  // Depth bits per pixel, leftmost in the highest bits. Eight bits are
+  // bytes as they are; depths dividing eight never straddle a byte.
+  static void PackChunky(const uint8_t *row, const uint32_t width,
+                         uint8_t *out) {
+    if constexpr (Depth == 8) {
+      std::memcpy(out, row, width);
+    } else if constexpr (8 % Depth == 0) {
+      constexpr uint32_t per_byte = 8 / Depth;
+      for (uint32_t x = 0; x < width; ++x) {
+        const auto shift = 8 - Depth * (x % per_byte + 1);
+        out[x / per_byte] |= static_cast<uint8_t>(row[x] << shift);
+      }
+    } else {
+      uint32_t bits = 0; // Pending, in the low end of buffer.
+      uint32_t buffer = 0;
+      for (uint32_t x = 0; x < width; ++x) {
+        buffer = buffer << Depth | row[x];
+        bits += Depth;
+        if (bits >= 8) {
+          bits -= 8;
+          *out++ = static_cast<uint8_t>(buffer >> bits);
+        }
+      }
+      if (bits > 0) {
+        *out = static_cast<uint8_t>(buffer << (8 - bits));
+      }
+    }
+  }
+
+  static void UnpackChunky(const uint8_t *line, const uint32_t width,
+                           uint8_t *row) {
+    if constexpr (Depth == 8) {
+      std::memcpy(row, line, width);
+    } else if constexpr (8 % Depth == 0) {
+      constexpr uint32_t per_byte = 8 / Depth;
+      for (uint32_t x = 0; x < width; ++x) {
+        const auto shift = 8 - Depth * (x % per_byte + 1);
+        row[x] = (line[x / per_byte] >> shift) & mask;
+      }
+    } else {
+      uint32_t bits = 0;
+      uint32_t buffer = 0;
+      for (uint32_t x = 0; x < width; ++x) {
+        if (bits < Depth) {
+          buffer = buffer << 8 | *line++;
+          bits += 8;
+        }
+        bits -= Depth;
+        row[x] = (buffer >> bits) & mask;
+      }
+    }
+  }
+
+  // Eight pixels per byte of every plane; the plane loop unrolls, being of
+  // known length.
+  static void PlanarToChunky(const uint8_t *const *planes,
+                             const uint32_t width, uint8_t *row) {
+    for (uint32_t x = 0; x < width; x += 8) {
+      uint8_t bytes[Depth];
+      for (uint8_t p = 0; p < Depth; ++p) {
+        bytes[p] = planes[p][x / 8];
+      }
+      const auto count = std::min(8u, width - x);
+      for (uint32_t k = 0; k < count; ++k) {
+        uint8_t index = 0;
+        for (uint8_t p = 0; p < Depth; ++p) {
+          index |= static_cast<uint8_t>(((bytes[p] >> (7 - k)) & 1) << p);
+        }
+        row[x + k] = index;
+      }
+    }
+  }
+};
+} // namespace IFFReader
@@ -0,0 +1,95 @@
+#include "ImageStatistics.h"
+#include "ThreadPool.h"
+
+#include <array>
+#include <bitset>
+#include <mutex>
+#include <unordered_set>
+
+using std::array;
+
+constexpr size_t COLOR_WORDS = (size_t(1) << 24) / 64;
+
+IFFReader::ColorSet::ColorSet()
+    : words_(new std::atomic<uint64_t>[COLOR_WORDS]) {
+  for (size_t i = 0; i < COLOR_WORDS; ++i) {
+    words_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+// Runs of equal pixels are common, and most colors are seen many times
+// over; testing before setting keeps the cache lines shared between threads.
+void IFFReader::ColorSet::Add(const uint32_t *pixels, const size_t count) {
+  uint32_t previous = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const auto color = pixels[i] & 0xffffff;
+    if (i > 0 && color == previous) {
+      continue;
+    }
+    previous = color;
+
+    auto &word = words_[color >> 6];
+    const auto bit = uint64_t(1) << (color & 63);
+    if ((word.load(std::memory_order_relaxed) & bit) == 0) {
+      word.fetch_or(bit, std::memory_order_relaxed);
+    }
+  }
+}
+
+const size_t IFFReader::ColorSet::Count() const {
+  size_t count = 0;
+  for (size_t i = 0; i < COLOR_WORDS; ++i) {
+    count += std::bitset<64>(words_[i].load(std::memory_order_relaxed)).count();
+  }
+  return count;
+}
+
+// Each band counts into its own table; tables are summed as bands finish.
+const vector<uint64_t> IFFReader::IndexHistogram(const IndexedImage &image) {
+  vector<uint64_t> histogram(256, 0);
+  std::mutex merge;
+
+  ThreadPool::Shared().ParallelFor(
+      0, image.height, 64, [&](const size_t first, const size_t last) {
+        array<uint64_t, 256> counts{};
+        for (auto y = first; y < last; ++y) {
+          const auto *row = image.indices + y * image.stride;
+          for (uint32_t x = 0; x < image.width; ++x) {
+            ++counts[row[x]];
+          }
+        }
+
+        std::lock_guard<std::mutex> lock(merge);
+        for (size_t i = 0; i < counts.size(); ++i) {
+          histogram[i] += counts[i];
+        }
+      });
+
+  return histogram;
+}
+
+void IFFReader::SummarizeIndexed(const vector<uint32_t> &palette,
+                                 const size_t palette_entries,
+                                 ImageStatistics &statistics) {
+  std::unordered_set<uint32_t> colors;
+  statistics.palette_entries = palette_entries;
+  statistics.used_entries = 0;
+  statistics.unused_entries.clear();
+
+  for (size_t i = 0; i < statistics.histogram.size(); ++i) {
+    const bool used = statistics.histogram[i] != 0;
+    if (i < palette_entries) {
+      if (used) {
+        ++statistics.used_entries;
+      } else {
+        statistics.unused_entries.push_back(static_cast<uint16_t>(i));
+      }
+    }
+
+    if (used) {
+      colors.insert((i < palette.size() ? palette[i] : 0) & 0xffffff);
+    }
+  }
+
+  statistics.unique_colors = colors.size();
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "IndexedImage.h"
+
+using std::vector;
+
+/*
+ * Counting colors is easy to do slowly. Indexed images never show more
+ * colors than they have palette entries, so a histogram of indices says all
+ * there is to say. HAM and sliced images can show any of 2^24 colors, which
+ * are tracked in a bitset of 2 MB: one bit per color, no hashing, no
+ * allocation per pixel.
+ *
+ * Both are filled in a single pass, a band of scanlines per thread.
+ */
+namespace IFFReader {
+
+struct ImageStatistics {
+  // Distinct colors on screen, alpha ignored.
+  size_t unique_colors = 0;
+
+  // Pixels per palette index (256 entries). Empty where pixels are not
+  // indices, as in HAM.
+  vector<uint64_t> histogram;
+
+  // Palette entries the image could use, and how many of them it does.
+  size_t palette_entries = 0;
+  size_t used_entries = 0;
+
+  // Palette entries no pixel refers to, in ascending order.
+  vector<uint16_t> unused_entries;
+};
+
+// Set of 24-bit colors. Colors may be added from several threads at once.
+class ColorSet {
+  std::unique_ptr<std::atomic<uint64_t>[]> words_;
+
+public:
+  ColorSet();
+
+  // Adds count 0xAABBGGRR pixels.
+  void Add(const uint32_t *pixels, const size_t count);
+
+  // Number of distinct colors added.
+  const size_t Count() const;
+};
+
+// Pixels per index, counted in parallel.
+const vector<uint64_t> IndexHistogram(const IndexedImage &image);
+
+// Fills in palette usage from a histogram. Colors are counted through the
+// palette; indices past its end show as black.
+void SummarizeIndexed(const vector<uint32_t> &palette,
+                      const size_t palette_entries,
+                      ImageStatistics &statistics);
+} // namespace IFFReader
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+namespace IFFReader {
+
+// Chunky image data as palette indices, one byte per pixel, along with the
+// colors those indices refer to. Meant for consumers that want indices
+// rather than colors, and for keeping large batches at a byte per pixel.
+//
+// Row y starts at indices + y * stride; stride is at least width. The
+// indices belong to the image they were taken from and remain valid for as
+// long as it lives and is not reloaded. The palette is a copy.
+struct IndexedImage {
+  const uint8_t *indices = nullptr;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  size_t stride = 0;
+
+  // 0xAABBGGRR. OCS correction applied if enabled; EHB expanded to 64
+  // entries. For sliced images, this is the palette of the first scanline.
+  vector<uint32_t> palette;
+
+  // Whether the palette changes down the screen (see ILBM::EffectivePalette).
+  bool sliced = false;
+};
+} // namespace IFFReader
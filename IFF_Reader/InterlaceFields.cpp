@@ -0,0 +1,78 @@
+#include "InterlaceFields.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+// Channels scaled by weight / 256; alpha is left alone.
+static const uint32_t Fade(const uint32_t pixel, const uint32_t weight) {
+  uint32_t faded = pixel & 0xff000000;
+  for (int c = 0; c < 24; c += 8) {
+    faded |= (((pixel >> c) & 0xff) * weight >> 8) << c;
+  }
+  return faded;
+}
+
+// Channel by channel average, rounding up.
+static const uint32_t Average(const uint32_t a, const uint32_t b) {
+  return (a | b) - (((a ^ b) >> 1) & 0x7f7f7f7f);
+}
+
+IFFReader::InterlaceFields::InterlaceFields(const uint32_t *pixels,
+                                            const uint32_t width,
+                                            const uint32_t height,
+                                            const size_t stride,
+                                            const uint32_t lines,
+                                            const uint32_t persistence)
+    : width_(width), height_(height) {
+  const auto size = static_cast<size_t>(width) * height;
+  fields_[0].resize(size);
+  fields_[1].resize(size);
+  blended_.resize(size);
+
+  // Line l starts at the first row at or below l * height / lines.
+  const uint64_t count = lines == 0 ? height : lines;
+  const auto line_of = [&](const uint64_t y) { return y * count / height; };
+  const auto first_row = [&](const uint64_t l) {
+    return (l * height + count - 1) / count;
+  };
+  const auto weight = std::min(persistence, 256u);
+
+  ThreadPool::Shared().ParallelFor(
+      0, height, 32, [&](const size_t first, const size_t last) {
+        for (auto y = first; y < last; ++y) {
+          const auto *row = pixels + y * stride;
+          const auto line = line_of(y);
+          const auto parity = line % 2;
+          auto *lit = fields_[parity].data() + y * width;
+          auto *unlit = fields_[parity ^ 1].data() + y * width;
+
+          std::copy(row, row + width, lit);
+          for (uint32_t x = 0; x < width; ++x) {
+            unlit[x] = Fade(row[x], weight);
+          }
+
+          // Blended with the same row of the next line, or its last if that
+          // is shorter; the last line has nothing below it.
+          const auto next = std::min(first_row(line + 1) + y - first_row(line),
+                                     first_row(line + 2) - 1);
+          const auto *below = next < height ? pixels + next * stride : row;
+          auto *blend = blended_.data() + y * width;
+          for (uint32_t x = 0; x < width; ++x) {
+            blend[x] = Average(row[x], below[x]);
+          }
+        }
+      });
+}
+
+const uint32_t IFFReader::InterlaceFields::Width() const { return width_; }
+
+const uint32_t IFFReader::InterlaceFields::Height() const { return height_; }
+
+const uint32_t *
+IFFReader::InterlaceFields::Field(const uint32_t parity) const {
+  return fields_[parity & 1].data();
+}
+
+const uint32_t *IFFReader::InterlaceFields::Blended() const {
+  return blended_.data();
+}
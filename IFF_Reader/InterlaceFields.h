@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+/*
+ * An interlaced Amiga screen draws the even lines in one frame and the odd
+ * lines in the next. Each line is lit only every other frame, and fine
+ * horizontal detail flickers at half the refresh rate. Flicker fixers
+ * smoothed this out by blending neighbouring lines.
+ *
+ * Both fields, and the blended picture, are built once from a resolved
+ * image. Showing a frame is then just a copy of one of them. The lines of
+ * the field not being drawn keep a fraction of their brightness, as the
+ * phosphor fades.
+ */
+namespace IFFReader {
+
+class InterlaceFields {
+  uint32_t width_;
+  uint32_t height_;
+
+  // Image as drawn with field 0 or 1 lit, and with lines blended.
+  vector<uint32_t> fields_[2];
+  vector<uint32_t> blended_;
+
+public:
+  // Builds from pixels showing an image of the given number of lines over
+  // height rows; zero lines means one per row. Lines need not be a whole
+  // number of rows tall, once corrected for aspect. Stride is in pixels;
+  // persistence is the brightness left in unlit lines, in 1/256ths.
+  InterlaceFields(const uint32_t *pixels, const uint32_t width,
+                  const uint32_t height, const size_t stride,
+                  const uint32_t lines = 0, const uint32_t persistence = 96);
+
+  const uint32_t Width() const;
+  const uint32_t Height() const;
+
+  // Image with the even (0) or odd (1) lines lit, width pixels per row.
+  const uint32_t *Field(const uint32_t parity) const;
+
+  // Each line averaged with the next, as by a flicker fixer.
+  const uint32_t *Blended() const;
+};
+} // namespace IFFReader
@@ -0,0 +1,287 @@
+#include "PNGEncoder.h"
+#include "Deflate.h"
+#include "PixelFormat.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+// Filtered bytes per band: enough for matches to be found, small enough
+// that a screen sized image still spreads over several threads.
+constexpr size_t BAND_BYTES = 64 << 10;
+
+constexpr uint8_t COLOR_INDEXED = 3;
+constexpr uint8_t COLOR_RGBA = 6;
+
+// How pixels are laid out in the image data.
+struct Layout {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint8_t depth = 8; // Bits per sample.
+  uint8_t color_type = COLOR_RGBA;
+  size_t row_bytes = 0;   // Without the filter type byte.
+  size_t pixel_bytes = 1; // Distance to the same byte of the pixel before.
+};
+
+// Fills unfiltered rows [first, last), stride bytes apart.
+using RowSource =
+    std::function<void(const uint32_t first, const uint32_t last,
+                       uint8_t *rows, const size_t stride)>;
+
+static void PutLong(bytefield &out, const uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+// Length, type, data and the CRC of type and data.
+static void PutChunk(bytefield &out, const char *type, const bytefield &data) {
+  PutLong(out, static_cast<uint32_t>(data.size()));
+  const auto start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data.begin(), data.end());
+  PutLong(out, IFFReader::Crc32(out.data() + start, out.size() - start));
+}
+
+static const uint8_t Paeth(const int a, const int b, const int c) {
+  const auto p = a + b - c;
+  const auto pa = std::abs(p - a);
+  const auto pb = std::abs(p - b);
+  const auto pc = std::abs(p - c);
+  return static_cast<uint8_t>(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+}
+
+// Sum of the bytes taken as signed, the usual measure of how well a
+// filtered row will compress.
+static const uint64_t Cost(const uint8_t *bytes, const size_t size) {
+  uint64_t cost = 0;
+  for (size_t i = 0; i < size; ++i) {
+    cost += static_cast<uint64_t>(std::abs(static_cast<int8_t>(bytes[i])));
+  }
+  return cost;
+}
+
+// Writes the filter type and filtered row to out. Indexed rows are left
+// unfiltered, as the PNG specification advises; others get whichever of
+// the five filters costs least.
+static void FilterRow(const uint8_t *row, const uint8_t *previous,
+                      const Layout &layout, uint8_t *out,
+                      vector<uint8_t> &scratch) {
+  const auto size = layout.row_bytes;
+  const auto step = layout.pixel_bytes;
+  out[0] = 0;
+  std::memcpy(out + 1, row, size);
+  if (layout.color_type == COLOR_INDEXED) {
+    return;
+  }
+
+  auto best = Cost(row, size);
+  scratch.resize(size);
+  auto *filtered = scratch.data();
+  for (uint8_t type = 1; type <= 4; ++type) {
+    for (size_t i = 0; i < size; ++i) {
+      const uint8_t a = i >= step ? row[i - step] : 0;
+      const uint8_t b = previous[i];
+      const uint8_t c = i >= step ? previous[i - step] : 0;
+      switch (type) {
+      case 1:
+        filtered[i] = static_cast<uint8_t>(row[i] - a);
+        break;
+      case 2:
+        filtered[i] = static_cast<uint8_t>(row[i] - b);
+        break;
+      case 3:
+        filtered[i] = static_cast<uint8_t>(row[i] - ((a + b) >> 1));
+        break;
+      default:
+        filtered[i] = static_cast<uint8_t>(row[i] - Paeth(a, b, c));
+        break;
+      }
+    }
+
+    const auto cost = Cost(filtered, size);
+    if (cost < best) {
+      best = cost;
+      out[0] = type;
+      std::memcpy(out + 1, filtered, size);
+    }
+  }
+}
+
+// Bands are resolved, filtered and compressed in parallel, each with the
+// row above it resolved again to filter against. The zlib header goes in
+// the first IDAT, and the Adler-32 of all bands, combined, in the last.
+static const bytefield Encode(const Layout &layout, const RowSource &source,
+                              const vector<uint32_t> &palette) {
+  const auto line = layout.row_bytes + 1;
+  const auto rows_per_band = std::max<size_t>(1, BAND_BYTES / line);
+  const auto bands =
+      std::max<size_t>(1, (layout.height + rows_per_band - 1) / rows_per_band);
+
+  vector<bytefield> compressed(bands);
+  vector<uint32_t> checksums(bands);
+  vector<size_t> sizes(bands);
+  const vector<uint8_t> blank(layout.row_bytes, 0);
+
+  IFFReader::ThreadPool::Shared().ParallelFor(
+      0, bands, 1, [&](const size_t first, const size_t last) {
+        vector<uint8_t> raw;
+        vector<uint8_t> filtered;
+        vector<uint8_t> scratch;
+
+        for (auto band = first; band < last; ++band) {
+          const auto top = static_cast<uint32_t>(band * rows_per_band);
+          const auto bottom = static_cast<uint32_t>(
+              std::min<size_t>(layout.height, top + rows_per_band));
+          const uint32_t above = top > 0 ? 1 : 0;
+
+          raw.resize((bottom - top + above) * layout.row_bytes);
+          source(top - above, bottom, raw.data(), layout.row_bytes);
+
+          filtered.resize((bottom - top) * line);
+          for (auto y = top; y < bottom; ++y) {
+            const auto *row =
+                raw.data() + (y - top + above) * layout.row_bytes;
+            const auto *previous = y > 0 ? row - layout.row_bytes
+                                         : blank.data();
+            FilterRow(row, previous, layout,
+                      filtered.data() + (y - top) * line, scratch);
+          }
+
+          checksums[band] = IFFReader::Adler32(filtered.data(),
+                                               filtered.size());
+          sizes[band] = filtered.size();
+          compressed[band] = IFFReader::Deflate(
+              filtered.data(), filtered.size(), band + 1 == bands);
+        }
+      });
+
+  bytefield png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+  bytefield header;
+  PutLong(header, layout.width);
+  PutLong(header, layout.height);
+  header.insert(header.end(),
+                {layout.depth, layout.color_type, 0, 0, 0});
+  PutChunk(png, "IHDR", header);
+
+  if (layout.color_type == COLOR_INDEXED) {
+    bytefield colors;
+    bytefield alpha;
+    for (const auto color : palette) {
+      colors.insert(colors.end(), {static_cast<uint8_t>(color),
+                                   static_cast<uint8_t>(color >> 8),
+                                   static_cast<uint8_t>(color >> 16)});
+      alpha.push_back(static_cast<uint8_t>(color >> 24));
+    }
+    PutChunk(png, "PLTE", colors);
+
+    // Alpha only up to the last entry that is not opaque.
+    while (!alpha.empty() && alpha.back() == 0xff) {
+      alpha.pop_back();
+    }
+    if (!alpha.empty()) {
+      PutChunk(png, "tRNS", alpha);
+    }
+  }
+
+  uint32_t adler = 1;
+  for (size_t band = 0; band < bands; ++band) {
+    adler = IFFReader::CombineAdler32(adler, checksums[band], sizes[band]);
+  }
+
+  for (size_t band = 0; band < bands; ++band) {
+    bytefield data;
+    if (band == 0) {
+      data = {0x78, 0x5e}; // Deflate, 32 kB window.
+    }
+    data.insert(data.end(), compressed[band].begin(), compressed[band].end());
+    if (band + 1 == bands) {
+      PutLong(data, adler);
+    }
+    PutChunk(png, "IDAT", data);
+    bytefield().swap(compressed[band]);
+  }
+
+  PutChunk(png, "IEND", bytefield());
+  return png;
+}
+
+const bytefield IFFReader::EncodePNG(const ILBM &image) {
+  const auto indexed = image.GetIndexed();
+  const auto planes = image.bitplanes_count();
+
+  Layout layout;
+  layout.width = image.width();
+  layout.height = image.height();
+
+  if (!image.HasIndexedOutput() || indexed.sliced || planes == 0 ||
+      planes > 8) {
+    layout.row_bytes = static_cast<size_t>(layout.width) * 4;
+    layout.pixel_bytes = 4;
+    return Encode(
+        layout,
+        [&](const uint32_t first, const uint32_t last, uint8_t *rows,
+            const size_t stride) {
+          image.ResolveRows(first, last, PixelFormat::RGBA8, rows, stride);
+        },
+        {});
+  }
+
+  layout.color_type = COLOR_INDEXED;
+  layout.depth = planes <= 1 ? 1 : planes <= 2 ? 2 : planes <= 4 ? 4 : 8;
+  layout.row_bytes = (static_cast<size_t>(layout.width) * layout.depth + 7) / 8;
+
+  // One entry for every index the planes can hold.
+  const auto entries = size_t(1) << planes;
+  auto palette = indexed.palette;
+  palette.resize(entries, 0xff000000);
+  const auto mask = static_cast<uint8_t>(entries - 1);
+
+  return Encode(
+      layout,
+      [&](const uint32_t first, const uint32_t last, uint8_t *rows,
+          const size_t stride) {
+        const auto depth = layout.depth;
+        const auto per_byte = 8u / depth;
+        for (auto y = first; y < last; ++y) {
+          const auto *source = indexed.indices + y * indexed.stride;
+          auto *row = rows + (y - first) * stride;
+          if (depth == 8) {
+            for (uint32_t x = 0; x < layout.width; ++x) {
+              row[x] = source[x] & mask;
+            }
+            continue;
+          }
+
+          // Leftmost pixel in the most significant bits.
+          std::fill(row, row + layout.row_bytes, 0);
+          for (uint32_t x = 0; x < layout.width; ++x) {
+            const auto shift = 8 - depth * (x % per_byte + 1);
+            row[x / per_byte] |=
+                static_cast<uint8_t>((source[x] & mask) << shift);
+          }
+        }
+      },
+      palette);
+}
+
+const bytefield IFFReader::EncodePNG(const ResolvedImage &image) {
+  Layout layout;
+  layout.width = image.width;
+  layout.height = image.height;
+  layout.row_bytes = static_cast<size_t>(layout.width) * 4;
+  layout.pixel_bytes = 4;
+
+  return Encode(
+      layout,
+      [&](const uint32_t first, const uint32_t last, uint8_t *rows,
+          const size_t stride) {
+        ConvertRows(image.pixels.data() + static_cast<size_t>(first) *
+                                              image.width,
+                    image.width, last - first, image.width,
+                    PixelFormat::RGBA8, rows, stride);
+      },
+      {});
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "ImageExport.h"
+
+/*
+ * PNG files, compressed with the deflate in Deflate.h.
+ *
+ * Rows are taken in bands, each filtered and compressed on its own thread
+ * as soon as it is resolved, so the image is never held whole at full size
+ * and all cores share the compression. The bands' deflate streams are
+ * joined into one, and written out as an IDAT chunk apiece.
+ */
+namespace IFFReader {
+
+// Indexed, with the palette in PLTE, when every pixel is an index into the
+// same palette; RGBA otherwise (HAM, or palettes changing down the screen).
+// Indices of up to four bits are packed.
+const bytefield EncodePNG(const ILBM &image);
+
+// RGBA, for images already resolved (and perhaps scaled).
+const bytefield EncodePNG(const ResolvedImage &image);
+} // namespace IFFReader
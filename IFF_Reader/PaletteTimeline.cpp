@@ -0,0 +1,80 @@
+#include "PaletteTimeline.h"
+
+IFFReader::PaletteTimeline::PaletteTimeline(const vector<uint32_t> &base,
+                                            const uint32_t height)
+    : base_(base), row_offsets_(static_cast<size_t>(height) + 1, 0),
+      running_(base), next_row_(0) {}
+
+const uint32_t IFFReader::PaletteTimeline::RowBegin(const uint32_t y) const {
+  // Rows past the last recorded one have no changes of their own.
+  return y < next_row_ ? row_offsets_.at(y)
+                       : static_cast<uint32_t>(changes_.size());
+}
+
+void IFFReader::PaletteTimeline::Record(const uint32_t y,
+                                        const vector<ColorChange> &changes) {
+  if (y + 1 < next_row_) {
+    return; // Out of order; the beam cannot go back up.
+  }
+
+  if (y + 1 >= row_offsets_.size()) {
+    return; // Below the image.
+  }
+
+  // Rows skipped since the last call start (and end) where we are now.
+  while (next_row_ <= y) {
+    row_offsets_.at(next_row_++) = static_cast<uint32_t>(changes_.size());
+  }
+
+  for (const auto &change : changes) {
+    if (change.index >= running_.size()) {
+      running_.resize(static_cast<size_t>(change.index) + 1, 0xff000000);
+      base_.resize(running_.size(), 0xff000000);
+    }
+
+    if (running_.at(change.index) != change.color) {
+      running_.at(change.index) = change.color;
+      changes_.push_back(change);
+    }
+  }
+}
+
+void IFFReader::PaletteTimeline::Advance(const uint32_t y,
+                                         vector<uint32_t> &palette) const {
+  if (y + 1 >= row_offsets_.size()) {
+    return;
+  }
+
+  if (palette.size() < base_.size()) {
+    palette.resize(base_.size(), 0xff000000);
+  }
+
+  const auto last = RowBegin(y + 1);
+  for (auto i = RowBegin(y); i < last; ++i) {
+    const auto &change = changes_[i];
+    palette[change.index] = change.color;
+  }
+}
+
+const vector<uint32_t>
+IFFReader::PaletteTimeline::PaletteAt(const uint32_t y) const {
+  vector<uint32_t> palette(base_);
+  const auto last = RowBegin(y + 1);
+
+  for (uint32_t i = 0; i < last && i < changes_.size(); ++i) {
+    palette[changes_[i].index] = changes_[i].color;
+  }
+  return palette;
+}
+
+const size_t IFFReader::PaletteTimeline::PaletteSize() const {
+  return base_.size();
+}
+
+const size_t IFFReader::PaletteTimeline::ChangeCount() const {
+  return changes_.size();
+}
+
+const uint32_t IFFReader::PaletteTimeline::Height() const {
+  return static_cast<uint32_t>(row_offsets_.size() - 1);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+/*
+ * The Amiga copper can rewrite color registers while the beam travels down
+ * the screen. Sliced HAM (SHAM), Dynamic HiRes (CTBL) and PCHG images all
+ * exploit this, giving each scanline a palette of its own.
+ *
+ * Storing a full palette per scanline would be wasteful, since most lines
+ * only alter a handful of registers. The timeline therefore keeps the base
+ * palette and, for each scanline, only the registers that change relative to
+ * the line above. Walking the image top to bottom costs a few writes per row.
+ */
+namespace IFFReader {
+
+// A single color register change, taking effect at a given scanline.
+struct ColorChange {
+  uint16_t index;
+  uint32_t color;
+};
+
+class PaletteTimeline {
+  // Palette in effect before the first change.
+  vector<uint32_t> base_;
+
+  // All deltas, in scanline order.
+  vector<ColorChange> changes_;
+
+  // Deltas for row y are changes_[row_offsets_[y]] up to row_offsets_[y + 1].
+  vector<uint32_t> row_offsets_;
+
+  // Palette as of the most recently recorded row. Only used while building.
+  vector<uint32_t> running_;
+
+  // First row not yet recorded.
+  uint32_t next_row_;
+
+  // First index of the deltas of the given row.
+  const uint32_t RowBegin(const uint32_t y) const;
+
+public:
+  PaletteTimeline(const vector<uint32_t> &base, const uint32_t height);
+
+  // Records register changes taking effect at scanline y. Rows must be
+  // recorded in ascending order. Changes that leave the palette as it was are
+  // dropped, so full per-line palettes (SHAM, CTBL) may be recorded as is.
+  void Record(const uint32_t y, const vector<ColorChange> &changes);
+
+  // Applies the changes of scanline y to a palette valid for the row above.
+  void Advance(const uint32_t y, vector<uint32_t> &palette) const;
+
+  // Rebuilds the palette in effect on scanline y.
+  const vector<uint32_t> PaletteAt(const uint32_t y) const;
+
+  // Number of registers addressed by base palette or changes.
+  const size_t PaletteSize() const;
+
+  // Total number of stored register changes.
+  const size_t ChangeCount() const;
+
+  // Number of scanlines covered.
+  const uint32_t Height() const;
+};
+} // namespace IFFReader
@@ -0,0 +1,331 @@
+#include "PixelFormat.h"
+#include <cstring>
+
+using IFFReader::PixelFormat;
+using IFFReader::SimdLevel;
+
+// Scalar kernels. These define the results; vector kernels below convert
+// the bulk of a row and leave the remainder to them.
+
+static void ToBGRA8(const uint32_t *source, const size_t count,
+                    uint8_t *destination) {
+  for (size_t i = 0; i < count; ++i, destination += 4) {
+    const auto p = source[i];
+    destination[0] = static_cast<uint8_t>(p >> 16);
+    destination[1] = static_cast<uint8_t>(p >> 8);
+    destination[2] = static_cast<uint8_t>(p);
+    destination[3] = static_cast<uint8_t>(p >> 24);
+  }
+}
+
+static void ToRGB888(const uint32_t *source, const size_t count,
+                     uint8_t *destination) {
+  for (size_t i = 0; i < count; ++i, destination += 3) {
+    const auto p = source[i];
+    destination[0] = static_cast<uint8_t>(p);
+    destination[1] = static_cast<uint8_t>(p >> 8);
+    destination[2] = static_cast<uint8_t>(p >> 16);
+  }
+}
+
+static const uint16_t RGB565(const uint32_t p) {
+  return static_cast<uint16_t>(((p & 0xf8) << 8) | ((p & 0xfc00) >> 5) |
+                               ((p & 0xf80000) >> 19));
+}
+
+static void ToRGB565(const uint32_t *source, const size_t count,
+                     uint8_t *destination) {
+  for (size_t i = 0; i < count; ++i, destination += 2) {
+    const auto word = RGB565(source[i]);
+    destination[0] = static_cast<uint8_t>(word);
+    destination[1] = static_cast<uint8_t>(word >> 8);
+  }
+}
+
+// 0.299 R + 0.587 G + 0.114 B in 8.8 fixed point, rounded. Weights add up
+// to 256, so white stays white.
+static void ToGray8(const uint32_t *source, const size_t count,
+                    uint8_t *destination) {
+  for (size_t i = 0; i < count; ++i) {
+    const auto p = source[i];
+    destination[i] = static_cast<uint8_t>(
+        ((p & 0xff) * 77 + ((p >> 8) & 0xff) * 150 + ((p >> 16) & 0xff) * 29 +
+         128) >>
+        8);
+  }
+}
+
+#if IFF_SIMD_X86
+// SSE2 kernels. Each returns the number of pixels it converted.
+
+IFF_TARGET_SSE2 static const size_t ToBGRA8_SSE2(const uint32_t *source,
+                                                 const size_t count,
+                                                 uint8_t *destination) {
+  const auto ag = _mm_set1_epi32(static_cast<int>(0xff00ff00));
+  const auto rb = _mm_set1_epi32(0x00ff00ff);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const auto p =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+    const auto red_blue = _mm_and_si128(p, rb);
+    const auto swapped = _mm_or_si128(_mm_srli_epi32(red_blue, 16),
+                                      _mm_slli_epi32(red_blue, 16));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i * 4),
+                     _mm_or_si128(_mm_and_si128(p, ag), swapped));
+  }
+  return i;
+}
+
+// 565 words computed in 32-bit lanes. They are sign extended before the
+// signed pack, which then keeps all 16 bits intact.
+IFF_TARGET_SSE2 static const __m128i RGB565_SSE2(const __m128i p) {
+  const auto r = _mm_slli_epi32(_mm_and_si128(p, _mm_set1_epi32(0xf8)), 8);
+  const auto g = _mm_srli_epi32(_mm_and_si128(p, _mm_set1_epi32(0xfc00)), 5);
+  const auto b =
+      _mm_srli_epi32(_mm_and_si128(p, _mm_set1_epi32(0xf80000)), 19);
+  const auto word = _mm_or_si128(_mm_or_si128(r, g), b);
+  return _mm_srai_epi32(_mm_slli_epi32(word, 16), 16);
+}
+
+IFF_TARGET_SSE2 static const size_t ToRGB565_SSE2(const uint32_t *source,
+                                                  const size_t count,
+                                                  uint8_t *destination) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const auto *in = reinterpret_cast<const __m128i *>(source + i);
+    const auto lo = RGB565_SSE2(_mm_loadu_si128(in));
+    const auto hi = RGB565_SSE2(_mm_loadu_si128(in + 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i * 2),
+                     _mm_packs_epi32(lo, hi));
+  }
+  return i;
+}
+
+// Products stay below 2^16, so 16-bit multiplies in 32-bit lanes suffice.
+IFF_TARGET_SSE2 static const __m128i Luma_SSE2(const __m128i p) {
+  const auto mask = _mm_set1_epi32(0xff);
+  const auto r = _mm_and_si128(p, mask);
+  const auto g = _mm_and_si128(_mm_srli_epi32(p, 8), mask);
+  const auto b = _mm_and_si128(_mm_srli_epi32(p, 16), mask);
+  const auto sum = _mm_add_epi32(
+      _mm_add_epi32(_mm_mullo_epi16(r, _mm_set1_epi32(77)),
+                    _mm_mullo_epi16(g, _mm_set1_epi32(150))),
+      _mm_add_epi32(_mm_mullo_epi16(b, _mm_set1_epi32(29)),
+                    _mm_set1_epi32(128)));
+  return _mm_srli_epi32(sum, 8);
+}
+
+IFF_TARGET_SSE2 static const size_t ToGray8_SSE2(const uint32_t *source,
+                                                 const size_t count,
+                                                 uint8_t *destination) {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const auto *in = reinterpret_cast<const __m128i *>(source + i);
+    const auto y0 = Luma_SSE2(_mm_loadu_si128(in));
+    const auto y1 = Luma_SSE2(_mm_loadu_si128(in + 1));
+    const auto y2 = Luma_SSE2(_mm_loadu_si128(in + 2));
+    const auto y3 = Luma_SSE2(_mm_loadu_si128(in + 3));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i),
+                     _mm_packus_epi16(_mm_packs_epi32(y0, y1),
+                                      _mm_packs_epi32(y2, y3)));
+  }
+  return i;
+}
+
+// AVX2 kernels. Packs work within 128-bit lanes, so their results are
+// permuted back into pixel order before storing.
+
+IFF_TARGET_AVX2 static const size_t ToBGRA8_AVX2(const uint32_t *source,
+                                                 const size_t count,
+                                                 uint8_t *destination) {
+  const auto order = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14,
+                                      13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10,
+                                      9, 8, 11, 14, 13, 12, 15);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const auto p =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i * 4),
+                        _mm256_shuffle_epi8(p, order));
+  }
+  return i;
+}
+
+// Each lane packs four pixels into its low twelve bytes. The second lane is
+// stored twelve bytes after the first, overwriting its four spare bytes, so
+// the loop stops early enough for those to fall inside the row.
+IFF_TARGET_AVX2 static const size_t ToRGB888_AVX2(const uint32_t *source,
+                                                  const size_t count,
+                                                  uint8_t *destination) {
+  const auto order = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+                                      -1, -1, -1, -1, 0, 1, 2, 4, 5, 6, 8, 9,
+                                      10, 12, 13, 14, -1, -1, -1, -1);
+  size_t i = 0;
+  for (; i + 10 <= count; i += 8) {
+    const auto p = _mm256_shuffle_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i)),
+        order);
+    auto *out = destination + i * 3;
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out),
+                     _mm256_castsi256_si128(p));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 12),
+                     _mm256_extracti128_si256(p, 1));
+  }
+  return i;
+}
+
+IFF_TARGET_AVX2 static const __m256i RGB565_AVX2(const __m256i p) {
+  const auto r =
+      _mm256_slli_epi32(_mm256_and_si256(p, _mm256_set1_epi32(0xf8)), 8);
+  const auto g =
+      _mm256_srli_epi32(_mm256_and_si256(p, _mm256_set1_epi32(0xfc00)), 5);
+  const auto b =
+      _mm256_srli_epi32(_mm256_and_si256(p, _mm256_set1_epi32(0xf80000)), 19);
+  const auto word = _mm256_or_si256(_mm256_or_si256(r, g), b);
+  return _mm256_srai_epi32(_mm256_slli_epi32(word, 16), 16);
+}
+
+IFF_TARGET_AVX2 static const size_t ToRGB565_AVX2(const uint32_t *source,
+                                                  const size_t count,
+                                                  uint8_t *destination) {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const auto *in = reinterpret_cast<const __m256i *>(source + i);
+    const auto lo = RGB565_AVX2(_mm256_loadu_si256(in));
+    const auto hi = RGB565_AVX2(_mm256_loadu_si256(in + 1));
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(destination + i * 2),
+        _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8));
+  }
+  return i;
+}
+
+IFF_TARGET_AVX2 static const __m256i Luma_AVX2(const __m256i p) {
+  const auto mask = _mm256_set1_epi32(0xff);
+  const auto r = _mm256_and_si256(p, mask);
+  const auto g = _mm256_and_si256(_mm256_srli_epi32(p, 8), mask);
+  const auto b = _mm256_and_si256(_mm256_srli_epi32(p, 16), mask);
+  const auto sum = _mm256_add_epi32(
+      _mm256_add_epi32(_mm256_mullo_epi16(r, _mm256_set1_epi32(77)),
+                       _mm256_mullo_epi16(g, _mm256_set1_epi32(150))),
+      _mm256_add_epi32(_mm256_mullo_epi16(b, _mm256_set1_epi32(29)),
+                       _mm256_set1_epi32(128)));
+  return _mm256_srli_epi32(sum, 8);
+}
+
+IFF_TARGET_AVX2 static const size_t ToGray8_AVX2(const uint32_t *source,
+                                                 const size_t count,
+                                                 uint8_t *destination) {
+  const auto order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  size_t i = 0;
+  for (; i + 32 <= count; i += 32) {
+    const auto *in = reinterpret_cast<const __m256i *>(source + i);
+    const auto y0 = Luma_AVX2(_mm256_loadu_si256(in));
+    const auto y1 = Luma_AVX2(_mm256_loadu_si256(in + 1));
+    const auto y2 = Luma_AVX2(_mm256_loadu_si256(in + 2));
+    const auto y3 = Luma_AVX2(_mm256_loadu_si256(in + 3));
+    const auto bytes = _mm256_packus_epi16(_mm256_packs_epi32(y0, y1),
+                                           _mm256_packs_epi32(y2, y3));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i),
+                        _mm256_permutevar8x32_epi32(bytes, order));
+  }
+  return i;
+}
+#endif
+
+const size_t IFFReader::BytesPerPixel(const PixelFormat format) {
+  switch (format) {
+  case PixelFormat::RGB888:
+    return 3;
+  case PixelFormat::RGB565:
+    return 2;
+  case PixelFormat::Gray8:
+    return 1;
+  case PixelFormat::RGBA8:
+  case PixelFormat::BGRA8:
+  default:
+    return 4;
+  }
+}
+
+// Vector kernels take whole blocks of pixels; the scalar kernel finishes the
+// row. SSE2 has no byte shuffle, so RGB888 only has an AVX2 kernel.
+void IFFReader::ConvertRow(const uint32_t *source, const size_t count,
+                           const PixelFormat format, uint8_t *destination,
+                           const SimdLevel level) {
+  if (format == PixelFormat::RGBA8) {
+    std::memcpy(destination, source, count * 4);
+    return;
+  }
+
+  size_t done = 0;
+  const auto bytes = BytesPerPixel(format);
+
+#if IFF_SIMD_X86
+  if (level == SimdLevel::AVX2) {
+    switch (format) {
+    case PixelFormat::BGRA8:
+      done = ToBGRA8_AVX2(source, count, destination);
+      break;
+    case PixelFormat::RGB888:
+      done = ToRGB888_AVX2(source, count, destination);
+      break;
+    case PixelFormat::RGB565:
+      done = ToRGB565_AVX2(source, count, destination);
+      break;
+    case PixelFormat::Gray8:
+      done = ToGray8_AVX2(source, count, destination);
+      break;
+    default:
+      break;
+    }
+  } else if (level == SimdLevel::SSE2) {
+    switch (format) {
+    case PixelFormat::BGRA8:
+      done = ToBGRA8_SSE2(source, count, destination);
+      break;
+    case PixelFormat::RGB565:
+      done = ToRGB565_SSE2(source, count, destination);
+      break;
+    case PixelFormat::Gray8:
+      done = ToGray8_SSE2(source, count, destination);
+      break;
+    default:
+      break;
+    }
+  }
+#endif
+
+  source += done;
+  destination += done * bytes;
+  const auto remaining = count - done;
+
+  switch (format) {
+  case PixelFormat::BGRA8:
+    ToBGRA8(source, remaining, destination);
+    break;
+  case PixelFormat::RGB888:
+    ToRGB888(source, remaining, destination);
+    break;
+  case PixelFormat::RGB565:
+    ToRGB565(source, remaining, destination);
+    break;
+  case PixelFormat::Gray8:
+    ToGray8(source, remaining, destination);
+    break;
+  default:
+    break;
+  }
+}
+
+void IFFReader::ConvertRows(const uint32_t *source, const uint32_t width,
+                            const uint32_t height, const size_t source_stride,
+                            const PixelFormat format, uint8_t *destination,
+                            const size_t destination_stride,
+                            const SimdLevel level) {
+  for (uint32_t y = 0; y < height; ++y) {
+    ConvertRow(source + y * source_stride, width, format,
+               destination + y * destination_stride, level);
+  }
+}
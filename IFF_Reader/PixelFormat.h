@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "Simd.h"
+
+/*
+ * Resolved pixels are 0xAABBGGRR, which in memory reads R, G, B, A: the
+ * layout olc::Pixel and most GPU APIs call RGBA8. Other consumers want
+ * something else, so whole rows are converted here in bulk, rather than a
+ * pixel at a time by every caller.
+ */
+namespace IFFReader {
+enum class PixelFormat {
+  RGBA8,  // R, G, B, A bytes; the native layout.
+  BGRA8,  // B, G, R, A bytes, as used by Windows DIBs and Direct2D.
+  RGB888, // R, G, B bytes, alpha dropped.
+  RGB565, // 16-bit little endian words, red in the top bits.
+  Gray8   // Luma byte, using BT.601 weights.
+};
+
+// Size of one pixel in the given format.
+const size_t BytesPerPixel(const PixelFormat format);
+
+// Converts count 0xAABBGGRR pixels into the given format.
+void ConvertRow(const uint32_t *source, const size_t count,
+                const PixelFormat format, uint8_t *destination,
+                const SimdLevel level = DetectSimdLevel());
+
+// Converts a block of rows. Source stride is in pixels, destination stride in
+// bytes; either may exceed the row width.
+void ConvertRows(const uint32_t *source, const uint32_t width,
+                 const uint32_t height, const size_t source_stride,
+                 const PixelFormat format, uint8_t *destination,
+                 const size_t destination_stride,
+                 const SimdLevel level = DetectSimdLevel());
+} // namespace IFFReader
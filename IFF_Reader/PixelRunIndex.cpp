@@ -0,0 +1,65 @@
+#include "PixelRunIndex.h"
+
+// Two passes over the indices: the first counts runs per register so that
+// the second can write each one straight into place.
+IFFReader::PixelRunIndex::PixelRunIndex(const IndexedImage &image,
+                                        const array<bool, 256> &registers)
+    : offsets_{}, pixel_count_(0) {
+  const auto for_each_run = [&](auto &&visit) {
+    for (uint32_t y = 0; y < image.height; ++y) {
+      const auto *row = image.indices + y * image.stride;
+      uint32_t x = 0;
+      while (x < image.width) {
+        const auto index = row[x];
+        auto end = x + 1;
+        while (end < image.width && row[end] == index) {
+          ++end;
+        }
+        if (registers[index]) {
+          visit(index, x, y, end - x);
+        }
+        x = end;
+      }
+    }
+  };
+
+  array<uint32_t, 256> counts{};
+  for_each_run([&](const uint8_t index, uint32_t, uint32_t, uint32_t length) {
+    ++counts[index];
+    pixel_count_ += length;
+  });
+
+  for (size_t r = 0; r < counts.size(); ++r) {
+    offsets_[r + 1] = offsets_[r] + counts[r];
+  }
+
+  runs_.resize(offsets_.back());
+  auto next = offsets_;
+  for_each_run([&](const uint8_t index, const uint32_t x, const uint32_t y,
+                   const uint32_t length) {
+    runs_[next[index]++] = {static_cast<uint16_t>(x), static_cast<uint16_t>(y),
+                            static_cast<uint16_t>(length)};
+  });
+}
+
+const IFFReader::PixelRun *
+IFFReader::PixelRunIndex::RunsBegin(const uint8_t index) const {
+  return runs_.data() + offsets_[index];
+}
+
+const IFFReader::PixelRun *
+IFFReader::PixelRunIndex::RunsEnd(const uint8_t index) const {
+  return runs_.data() + offsets_[index + 1];
+}
+
+const size_t IFFReader::PixelRunIndex::RunCount(const uint8_t index) const {
+  return offsets_[index + 1] - offsets_[index];
+}
+
+const size_t IFFReader::PixelRunIndex::RunCount() const {
+  return runs_.size();
+}
+
+const size_t IFFReader::PixelRunIndex::PixelCount() const {
+  return pixel_count_;
+}
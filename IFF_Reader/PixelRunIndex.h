@@ -0,0 +1,61 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "IndexedImage.h"
+
+using std::array;
+using std::vector;
+
+/*
+ * When a palette register changes, as it does many times a second while
+ * color cycling, only pixels using that register need drawing again. Finding
+ * them by scanning the whole image every tick defeats the purpose on large
+ * AGA screens, where a cycling range often covers a small part of the image.
+ *
+ * The run index is built once from the chunky indices. It lists, for each
+ * register of interest, the horizontal runs of pixels that use it; a tick
+ * then costs one fill per affected run. Runs of a register are stored
+ * contiguously, top to bottom, left to right.
+ */
+namespace IFFReader {
+
+// Horizontal stretch of pixels sharing the same palette index.
+struct PixelRun {
+  uint16_t x;
+  uint16_t y;
+  uint16_t length;
+};
+
+class PixelRunIndex {
+  // All runs, grouped by register.
+  vector<PixelRun> runs_;
+
+  // Runs for register r are runs_[offsets_[r]] up to offsets_[r + 1].
+  array<uint32_t, 257> offsets_;
+
+  // Total number of pixels covered by runs.
+  size_t pixel_count_;
+
+public:
+  // Indexes runs of the flagged registers only; others have no runs.
+  PixelRunIndex(const IndexedImage &image, const array<bool, 256> &registers);
+
+  // First run using the given register.
+  const PixelRun *RunsBegin(const uint8_t index) const;
+
+  // One past the last run using the given register.
+  const PixelRun *RunsEnd(const uint8_t index) const;
+
+  // Number of runs for the given register.
+  const size_t RunCount(const uint8_t index) const;
+
+  // Number of runs over all registers.
+  const size_t RunCount() const;
+
+  // Number of pixels covered by runs over all registers.
+  const size_t PixelCount() const;
+};
+} // namespace IFFReader
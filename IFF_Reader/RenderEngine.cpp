@@ -1,72 +1,446 @@
 #include "RenderEngine.h"
+#include "ThreadPool.h"
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
 
 using std::cout;
+using std::chrono::duration_cast;
 using std::chrono::microseconds;
-using std::chrono::system_clock;
-using std::this_thread::sleep_for;
-
-void Renderer::AddImage(ImageFile &img) { images_.emplace_back(move(img)); }
-
-Renderer::Renderer() { sAppName = "IFF reader"; }
+using std::chrono::steady_clock;
 
 constexpr unsigned int PAL_FRAME = 1000000 / 50;
 constexpr unsigned int NTSC_FRAME = 1000000 / 60;
 
-const vector<uint32_t> Renderer::GetData(const size_t n) const {
-  vector<uint32_t> contents;
-  const auto data = images_.at(n).Get();
-  for (unsigned int y = 0; y < data->height(); ++y) {
-    for (unsigned int x = 0; x < data->width(); ++x) {
-      const auto px = data->color_at(x, y);
-      contents.push_back(px);
-    }
-  }
-  return contents;
+// ANIM frame times are in jiffies, whatever the display's rate.
+constexpr unsigned int JIFFY = 1000000 / 60;
+
+// Contact sheet layout: cells of SHEET_CELL pixels square, each holding a
+// thumbnail with a small margin.
+constexpr size_t SHEET_COLUMNS = 20;
+constexpr size_t SHEET_ROWS = 12;
+constexpr uint32_t SHEET_CELL = 48;
+constexpr uint32_t THUMBNAIL_SIZE = SHEET_CELL - 4;
+
+// Zoomed view: its size on screen, how far it zooms in and out (as powers
+// of two), and the memory allowed for its tiles.
+constexpr int32_t VIEW_WIDTH = 640;
+constexpr int32_t VIEW_HEIGHT = 512;
+constexpr int32_t MIN_ZOOM = -6;
+constexpr int32_t MAX_ZOOM = 4;
+constexpr size_t TILE_CACHE_BYTES = 64 << 20;
+
+// Refresh rate, then mean and 99th percentile of frame interval and work.
+static const string FormatFrameStats(const FrameStats &stats) {
+  const auto ms = [](const microseconds time) {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1) << time.count() / 1000.0;
+    return text.str();
+  };
+
+  std::ostringstream text;
+  text << std::fixed << std::setprecision(1)
+       << (stats.mean_interval.count() > 0
+               ? 1000000.0 / stats.mean_interval.count()
+               : 0.0)
+       << " Hz  frame " << ms(stats.mean_interval) << "/"
+       << ms(stats.p99_interval) << " ms  work " << ms(stats.mean_work) << "/"
+       << ms(stats.p99_work) << " ms  dropped " << stats.dropped << " of "
+       << stats.frames;
+  return text.str();
 }
 
-const size_t Renderer::GetFilePosByAbspath(const fs::path path) const {
-  for (size_t i = 0; i < images_.size(); ++i) {
-    if (images_.at(i).Path() == path) {
-      return i;
-    }
-  }
-  return images_.size();
+Renderer::Renderer()
+    : sheet_(THUMBNAIL_SIZE), pacer_(microseconds(PAL_FRAME)) {
+  sAppName = "IFF reader";
+}
+
+shared_ptr<ImageFile> Renderer::CurrentImage() const {
+  return cache_.Get(current_image);
+}
+
+void Renderer::SetCacheLimits(const size_t budget, const size_t neighbours) {
+  cache_.SetLimits(budget, neighbours);
+}
+
+void Renderer::SetDecodeCache(const fs::path &folder,
+                              const uintmax_t limit) {
+  const auto decode_cache =
+      std::make_shared<const IFFReader::DecodeCache>(folder, limit);
+  cache_.SetDecodeCache(decode_cache);
+  sheet_.SetDecodeCache(decode_cache);
 }
 
 void Renderer::DisplayImage() {
-  // Select among the images already established.
-  const auto &image_file = images_.at(current_image);
-  const auto &this_image = image_file.Get();
+  // Fields belong to the screen last drawn whole. The zoomed view, and an
+  // image still decoding, have none.
+  fields_.reset();
 
-  if (!image_file.IsLoaded()) { // Show black screen while loading.
+  // Select among the images already decoded.
+  const auto image_file = CurrentImage();
+
+  if (!image_file || !image_file->IsLoaded()) { // Black while decoding.
     Clear(olc::BLACK);
+    if (cache_.Failed(current_image)) {
+      DrawString(8, 8,
+                 cache_.Path(current_image).filename().string() + "\n\n" +
+                     cache_.Error(current_image),
+                 olc::WHITE);
+    }
     return;
   }
+  const auto this_image = image_file->Get();
+
+  // The player has the animation's image to itself; its frames are shown
+  // as it resolved them, at the size it has. Black until the first comes.
+  const uint32_t *frame = nullptr;
+  if (player_) {
+    if (anim_frame_.pixels.size() !=
+        static_cast<size_t>(this_image->width()) * this_image->height()) {
+      Clear(olc::BLACK);
+      return;
+    }
+    frame = anim_frame_.pixels.data();
+  }
 
-  if (this_image->width() != ScreenWidth() ||
-      this_image->height() != ScreenHeight()) {
-    SetScreenSize(this_image->width(), this_image->height());
+  if (zoom_view_ && !player_) {
+    DisplayZoomed(this_image);
+    return;
+  }
+
+  // Pixels are stretched to square on one axis when correcting aspect.
+  const auto scaler = this_image->AspectCorrection(
+      aspect_mode_ == AspectMode::Sharp ? IFFReader::ScaleFilter::Nearest
+                                        : IFFReader::ScaleFilter::Cubic);
+  const bool scaling = aspect_mode_ != AspectMode::Off && scaler.Scales();
+
+  const auto width = scaling ? scaler.Width() : this_image->width();
+  const auto height = scaling ? scaler.Height() : this_image->height();
+
+  // The CRT is simulated on the corrected image, which it enlarges.
+  const bool crt = crt_scale_ != 0;
+  if (crt && (!crt_ || crt_->SourceWidth() != width ||
+              crt_->SourceHeight() != height ||
+              crt_->Settings().scale != crt_scale_)) {
+    IFFReader::CRTSettings settings;
+    settings.scale = crt_scale_;
+    crt_ = std::make_unique<IFFReader::CRTFilter>(width, height, settings);
+  }
+
+  const auto screen_width = crt ? crt_->Width() : width;
+  const auto screen_height = crt ? crt_->Height() : height;
+  if (static_cast<int32_t>(screen_width) != ScreenWidth() ||
+      static_cast<int32_t>(screen_height) != ScreenHeight()) {
+    SetScreenSize(screen_width, screen_height);
   }
 
   // Start timer
-  const auto start = system_clock::now();
+  const auto start = steady_clock::now();
+
+  // Resolve rows straight into the draw target, which has the same pixel
+  // layout, unless scaling or the CRT still have to work on them. Each
+  // stage writes to the draw target if it is the last, or else to scratch.
+  // Bands of rows are spread over the thread pool.
+  static_assert(sizeof(olc::Pixel) == sizeof(uint32_t), "Pixel is not RGBA8");
+  auto *target = reinterpret_cast<uint32_t *>(GetDrawTarget()->GetData());
+  const auto stride = static_cast<size_t>(ScreenWidth());
+
+  uint32_t *resolved = target;
+  size_t resolved_stride = stride;
+  if (scaling || crt) {
+    resolved_stride = this_image->width();
+    unscaled_.resize(resolved_stride * this_image->height());
+    resolved = unscaled_.data();
+  }
+
+  IFFReader::ThreadPool::Shared().ParallelFor(
+      0, this_image->height(), 32, [&](const size_t first, const size_t last) {
+        if (!frame) {
+          this_image->ResolveRows(static_cast<uint32_t>(first),
+                                  static_cast<uint32_t>(last),
+                                  resolved + first * resolved_stride,
+                                  resolved_stride);
+          return;
+        }
+        const auto width = this_image->width();
+        for (auto y = first; y < last; ++y) {
+          std::copy(frame + y * width, frame + (y + 1) * width,
+                    resolved + y * resolved_stride);
+        }
+      });
+
+  uint32_t *corrected = resolved;
+  size_t corrected_stride = resolved_stride;
+  if (scaling) {
+    corrected = target;
+    corrected_stride = stride;
+    if (crt) {
+      corrected_stride = width;
+      scaled_.resize(corrected_stride * height);
+      corrected = scaled_.data();
+    }
+    scaler.Scale(resolved, resolved_stride, corrected, corrected_stride);
+  }
+
+  if (crt) {
+    crt_->Apply(corrected, corrected_stride, target, stride);
+  }
+
+  // Interlaced images keep both fields of the finished screen, so that later
+  // frames only swap them. Lines are split by the image's own line count,
+  // however far aspect correction and the CRT have stretched them.
+  if (interlace_mode_ != InterlaceMode::Off && this_image->Interlaced()) {
+    fields_ = std::make_unique<IFFReader::InterlaceFields>(
+        target, ScreenWidth(), ScreenHeight(), stride, this_image->height());
+    PresentField();
+  }
+
+  // End timer.
+  display_time_ = duration_cast<microseconds>(steady_clock::now() - start);
+}
+
+// Screen columns and rows are mapped to pixels of the tile level closest
+// to the zoom without being smaller, then only the tiles those pixels fall
+// in are resolved and copied. Aspect correction, the CRT and interlacing
+// are left out here; the zoomed view shows pixels as stored.
+void Renderer::DisplayZoomed(const shared_ptr<IFFReader::ILBM> &image) {
+  if (ScreenWidth() != VIEW_WIDTH || ScreenHeight() != VIEW_HEIGHT) {
+    SetScreenSize(VIEW_WIDTH, VIEW_HEIGHT);
+  }
+
+  const auto start = steady_clock::now();
+
+  if (!tiles_ || tiles_->Image() != image) {
+    tiles_ = std::make_unique<IFFReader::TileCache>(image, TILE_CACHE_BYTES);
+  }
+  if (recenter_) {
+    view_x_ = (image->width() - VIEW_WIDTH / std::ldexp(1.0, zoom_)) / 2;
+    view_y_ = (image->height() - VIEW_HEIGHT / std::ldexp(1.0, zoom_)) / 2;
+    recenter_ = false;
+  }
+
+  // Zooming out reads a level with fewer pixels; zooming in repeats them.
+  constexpr auto TILE = IFFReader::TileCache::TILE_SIZE;
+  const auto level = static_cast<uint32_t>(std::max(-zoom_, 0));
+  const auto magnify = std::ldexp(1.0, std::max(zoom_, 0));
+  const auto level_width = static_cast<int64_t>(tiles_->LevelWidth(level));
+  const auto level_height = static_cast<int64_t>(tiles_->LevelHeight(level));
+
+  // Level pixel shown in each screen column and row, or -1 off the image.
+  const auto map = [&](const int32_t size, const double origin,
+                       const int64_t extent) {
+    vector<int32_t> positions(size);
+    for (int32_t i = 0; i < size; ++i) {
+      const auto p = static_cast<int64_t>(
+          std::floor(std::ldexp(origin, -static_cast<int>(level)) +
+                     i / magnify));
+      positions[i] = p >= 0 && p < extent ? static_cast<int32_t>(p) : -1;
+    }
+    return positions;
+  };
+  const auto columns = map(VIEW_WIDTH, view_x_, level_width);
+  const auto rows = map(VIEW_HEIGHT, view_y_, level_height);
+
+  // Positions only grow, so the first and last on the image bound it.
+  const auto bounds = [](const vector<int32_t> &positions, int32_t &first,
+                         int32_t &last) {
+    first = -1;
+    last = -1;
+    for (const auto p : positions) {
+      if (p >= 0) {
+        first = first < 0 ? p : first;
+        last = p;
+      }
+    }
+    return first >= 0;
+  };
+  int32_t first_x, last_x, first_y, last_y;
+  Clear(olc::BLACK);
+  if (!bounds(columns, first_x, last_x) || !bounds(rows, first_y, last_y)) {
+    display_time_ = duration_cast<microseconds>(steady_clock::now() - start);
+    return;
+  }
+
+  const auto first_column = first_x / TILE;
+  const auto last_column = last_x / TILE + 1;
+  tiles_->Prepare(level, first_column, last_column, first_y / TILE,
+                  last_y / TILE + 1);
+
+  auto *target = reinterpret_cast<uint32_t *>(GetDrawTarget()->GetData());
+  IFFReader::ThreadPool::Shared().ParallelFor(
+      0, VIEW_HEIGHT, 32, [&](const size_t first, const size_t last) {
+        vector<const uint32_t *> tile_rows(last_column - first_column);
+        for (auto y = first; y < last; ++y) {
+          const auto row = rows[y];
+          if (row < 0) {
+            continue;
+          }
+
+          for (uint32_t t = 0; t < tile_rows.size(); ++t) {
+            tile_rows[t] = tiles_->Get(level, first_column + t, row / TILE) +
+                           static_cast<size_t>(row % TILE) * TILE;
+          }
+
+          auto *out = target + y * VIEW_WIDTH;
+          for (int32_t x = 0; x < VIEW_WIDTH; ++x) {
+            const auto column = columns[x];
+            if (column >= 0) {
+              out[x] = tile_rows[column / TILE - first_column][column % TILE];
+            }
+          }
+        }
+      });
+
+  display_time_ = duration_cast<microseconds>(steady_clock::now() - start);
+}
+
+void Renderer::PresentField() {
+  if (!fields_ || static_cast<int32_t>(fields_->Width()) != ScreenWidth() ||
+      static_cast<int32_t>(fields_->Height()) != ScreenHeight()) {
+    return;
+  }
+
+  const auto *field = interlace_mode_ == InterlaceMode::FlickerFixer
+                          ? fields_->Blended()
+                          : fields_->Field(field_);
+  const auto size = static_cast<size_t>(fields_->Width()) * fields_->Height();
+  std::copy(field, field + size,
+            reinterpret_cast<uint32_t *>(GetDrawTarget()->GetData()));
+}
+
+// Thumbnails of the page holding the current image are requested as the
+// page is drawn, along with those of the next page; the sheet fills in as
+// they arrive.
+void Renderer::DisplaySheet() {
+  if (ScreenWidth() != SHEET_COLUMNS * SHEET_CELL ||
+      ScreenHeight() != SHEET_ROWS * SHEET_CELL) {
+    SetScreenSize(SHEET_COLUMNS * SHEET_CELL, SHEET_ROWS * SHEET_CELL);
+  }
 
-  // Write pixels
-  for (unsigned int y = 0; y < this_image->height(); ++y) {
-    for (unsigned int x = 0; x < this_image->width(); ++x) {
-      auto px = this_image->color_at(x, y);
-      Draw(x, y, olc::Pixel(px));
+  const auto start = steady_clock::now();
+  sheet_completed_ = sheet_.Completed();
+  Clear(olc::BLACK);
+
+  const auto count = cache_.Size();
+  const auto per_page = SHEET_COLUMNS * SHEET_ROWS;
+  const auto first = current_image / per_page * per_page;
+  const auto last = std::min(count, first + per_page);
+
+  auto *target = reinterpret_cast<uint32_t *>(GetDrawTarget()->GetData());
+  const auto stride = static_cast<size_t>(ScreenWidth());
+
+  for (auto n = first; n < last; ++n) {
+    sheet_.Request(n, cache_.Path(n));
+    const auto thumbnail = sheet_.Get(n);
+    if (!thumbnail) {
+      continue;
     }
+
+    // Centered in its cell.
+    const auto cell = n - first;
+    const auto left = (cell % SHEET_COLUMNS) * SHEET_CELL +
+                      (SHEET_CELL - thumbnail->width) / 2;
+    const auto top = (cell / SHEET_COLUMNS) * SHEET_CELL +
+                     (SHEET_CELL - thumbnail->height) / 2;
+
+    for (uint32_t y = 0; y < thumbnail->height; ++y) {
+      const auto *row = thumbnail->pixels.data() +
+                        static_cast<size_t>(y) * thumbnail->width;
+      std::copy(row, row + thumbnail->width,
+                target + (top + y) * stride + left);
+    }
+  }
+
+  for (auto n = last; n < std::min(count, last + per_page); ++n) {
+    sheet_.Request(n, cache_.Path(n));
+  }
+
+  const auto cell = current_image - first;
+  DrawRect(static_cast<int32_t>((cell % SHEET_COLUMNS) * SHEET_CELL),
+           static_cast<int32_t>((cell / SHEET_COLUMNS) * SHEET_CELL),
+           SHEET_CELL - 1, SHEET_CELL - 1, olc::WHITE);
+
+  display_time_ = duration_cast<microseconds>(steady_clock::now() - start);
+}
+
+void Renderer::Invalidate(const Redraw redraw) {
+  redraw_ = std::max(redraw_, redraw);
+}
+
+// An image that is still loading shows black, and stays dirty until it can
+// be drawn for real. One that failed to load shows why, once.
+void Renderer::Repaint() {
+  switch (redraw_) {
+  case Redraw::Full:
+    if (sheet_mode_) {
+      DisplaySheet();
+    } else {
+      DisplayImage();
+    }
+    break;
+  case Redraw::Cycled:
+    RedrawCycledPixels();
+    break;
+  case Redraw::Field:
+    PresentField();
+    break;
+  case Redraw::Clean:
+  default:
+    return;
+  }
+
+  const auto image_file = CurrentImage();
+  const bool done =
+      sheet_mode_ || cache_.Failed(current_image) ||
+      (image_file && image_file->IsLoaded() &&
+       (!player_ || !anim_frame_.pixels.empty()));
+  redraw_ = done ? Redraw::Clean : Redraw::Full;
+}
+
+// Cycling changes the colors behind some palette indices, never the indices
+// themselves, so only pixels using those indices are drawn again. HAM pixels
+// depend on their neighbours, and sliced palettes differ per line; those
+// images are redrawn in full, as are images shown with aspect correction, on
+// a simulated CRT, interlaced, or zoomed (whose tiles are then stale).
+void Renderer::RedrawCycledPixels() {
+  const auto image_file = CurrentImage();
+
+  if (!image_file || !image_file->IsLoaded()) {
+    return;
+  }
+  const auto this_image = image_file->Get();
+
+  const auto indexed = this_image->GetIndexed();
+  if (!this_image->HasIndexedOutput() || indexed.sliced ||
+      aspect_mode_ != AspectMode::Off || crt_scale_ != 0 || fields_ ||
+      zoom_view_) {
+    tiles_.reset();
+    DisplayImage();
+    return;
   }
 
-  // End timer. Thread sleeps until next Vertical Blank,
-  // letting us conserve resources.
-  const auto elapsed = system_clock::now() - start;
-  const auto frame_time_taken =
-      elapsed.count() * microseconds::period::num / microseconds::period::den;
+  // Runs are looked up once per image; each tick then only fills them.
+  const auto &runs = this_image->CyclingRuns();
+  const auto registers = this_image->CyclingRegisters();
+  const auto &palette = indexed.palette;
+  auto *target = GetDrawTarget()->GetData();
+  const auto stride = static_cast<size_t>(ScreenWidth());
 
-  sleep_for(microseconds(FrameDuration() - frame_time_taken));
+  for (size_t index = 0; index < palette.size() && index < 256; ++index) {
+    if (!registers[index]) {
+      continue;
+    }
+
+    const olc::Pixel color(palette[index]);
+    const auto last = runs.RunsEnd(static_cast<uint8_t>(index));
+    for (auto run = runs.RunsBegin(static_cast<uint8_t>(index)); run != last;
+         ++run) {
+      auto *dest = target + run->y * stride + run->x;
+      std::fill(dest, dest + run->length, color);
+    }
+  }
 }
 
 const bool Renderer::RequestedBreak() const { return break_requested; }
@@ -79,7 +453,8 @@ void Renderer::DoneLoadingFiles() { done_loading_files = true; }
 
 // Called once at the start, so create things here
 bool Renderer::OnUserCreate() {
-  DisplayImage();
+  pacer_.SetPeriod(microseconds(FrameDuration()));
+  Invalidate(Redraw::Full);
   return true;
 }
 
@@ -91,23 +466,71 @@ const bool Renderer::ForwardKeyReleased() {
   return GetKey(olc::Key::RIGHT).bReleased || GetKey(olc::Key::SPACE).bReleased;
 }
 
-bool Renderer::OnUserUpdate(float fElapsedTime) {
-  if (break_no_valid_iff) {
-    return false;
+// Keys for viewing a single image.
+void Renderer::UpdateImage(const size_t image_count) {
+  // You can apply colour correction now.
+  auto this_image = CurrentImage();
+  UpdateAnimation(this_image);
+
+  // The player resolves colors on a thread of its own, so it is stopped
+  // while they change, and started again on the frame shown.
+  if (GetKey(olc::Key::O).bReleased && this_image &&
+      this_image->OffersOCSColourCorrection()) {
+    const bool playing = player_ != nullptr;
+    player_.reset();
+    const auto currently_enabled = this_image->UsingOCSColourCorrection();
+    this_image->ApplyOCSColourCorrection(!currently_enabled);
+    tiles_.reset();
+    if (playing) {
+      player_ = std::make_unique<IFFReader::AnimationPlayer>(
+          this_image->GetAnimation(), anim_frame_.frame);
+      anim_show_next_ = true;
+    }
+    Invalidate(Redraw::Full);
   }
-  const auto image_count = images_.size();
 
-  // You can apply colour correction now.
-  auto &this_image = images_.at(current_image);
+  // Cycle aspect correction: off, smooth, sharp.
+  if (GetKey(olc::Key::A).bReleased) {
+    aspect_mode_ = aspect_mode_ == AspectMode::Off      ? AspectMode::Smooth
+                   : aspect_mode_ == AspectMode::Smooth ? AspectMode::Sharp
+                                                        : AspectMode::Off;
+    Clear(olc::BLACK);
+    Invalidate(Redraw::Full);
+  }
 
-  if (GetKey(olc::Key::O).bReleased && this_image.OffersOCSColourCorrection()) {
-    const auto currently_enabled = this_image.UsingOCSColourCorrection();
-    this_image.ApplyOCSColourCorrection(!currently_enabled);
-    DisplayImage();
-    return true;
+  // Cycle CRT simulation: off, at twice and at three times the size.
+  if (GetKey(olc::Key::T).bReleased) {
+    crt_scale_ = crt_scale_ == 0 ? 2 : crt_scale_ == 2 ? 3 : 0;
+    Clear(olc::BLACK);
+    Invalidate(Redraw::Full);
+  }
+
+  // Cycle interlace emulation: off, flickering fields, flicker fixer.
+  if (GetKey(olc::Key::L).bReleased) {
+    interlace_mode_ = interlace_mode_ == InterlaceMode::Off
+                          ? InterlaceMode::Flicker
+                      : interlace_mode_ == InterlaceMode::Flicker
+                          ? InterlaceMode::FlickerFixer
+                          : InterlaceMode::Off;
+    Invalidate(Redraw::Full);
+  }
+
+  // Toggle the zoomed view, which starts out centered at the image's size.
+  // Animations are not shown zoomed.
+  if (GetKey(olc::Key::Z).bReleased && !player_) {
+    zoom_view_ = !zoom_view_;
+    zoom_ = 0;
+    recenter_ = true;
+    Clear(olc::BLACK);
+    Invalidate(Redraw::Full);
+  }
+  if (zoom_view_ && !player_) {
+    UpdateZoom();
   }
 
-  if (images_.size() > 1) {
+  // Shift with the arrows pans the zoomed view instead.
+  const bool panning = zoom_view_ && GetKey(olc::Key::SHIFT).bHeld;
+  if (image_count > 1 && !panning) {
     const auto stored_image = current_image;
     if (BackKeyReleased()) {
       current_image =
@@ -118,14 +541,53 @@ bool Renderer::OnUserUpdate(float fElapsedTime) {
           (current_image == image_count - 1) ? 0 : current_image + 1;
     }
     if (stored_image != current_image) {
+      // Cycling belongs to the image it was started on.
+      if (cycling_ && this_image) {
+        this_image->Get()->ResetColorCycling();
+      }
+      cycling_ = false;
+      // So does an animation, whose frames the next image must not show.
+      player_.reset();
+      anim_frame_ = IFFReader::ResolvedFrame();
+      anim_paused_ = false;
+      cache_.View(current_image);
+      this_image = CurrentImage();
+      recenter_ = true;
       Clear(olc::BLACK);
-      DisplayImage();
+      Invalidate(Redraw::Full);
+    }
+  }
+
+  const bool loaded = this_image && this_image->IsLoaded();
+
+  // Toggle color cycling. Stopping returns the palette to its original state.
+  // Animations do not cycle, as their player resolves colors meanwhile.
+  if (GetKey(olc::Key::C).bReleased && loaded && !player_ &&
+      this_image->Get()->HasColorCycling()) {
+    cycling_ = !cycling_;
+    if (!cycling_) {
+      this_image->Get()->ResetColorCycling();
+      tiles_.reset();
+      Invalidate(Redraw::Full);
     }
   }
 
+  // Cycling runs on the display's frame rate, as on the Amiga.
+  if (cycling_ && loaded &&
+      this_image->Get()->AdvanceColorCycling(FrameDuration())) {
+    Invalidate(Redraw::Cycled);
+  }
+
+  // An interlaced screen shows one field per frame, so fields alternate at
+  // the PAL or NTSC frame rate.
+  if (fields_ && interlace_mode_ == InterlaceMode::Flicker) {
+    field_ ^= 1;
+    Invalidate(Redraw::Field);
+  }
+
   // Display image information if requested.
-  if (GetKey(olc::Key::I).bReleased) {
-    const auto path = this_image.Path();
+  if (GetKey(olc::Key::I).bReleased && loaded) {
+    const auto path = this_image->Path();
     const auto pos = path.find_last_of("/\\");
 
     const auto name =
@@ -133,8 +595,233 @@ bool Renderer::OnUserUpdate(float fElapsedTime) {
 
     cout << "File: " << name << "\n"
          << "Path: " << path << "\n"
-         << this_image.Get()->GetImageInfo() << "\n";
+         << this_image->Get()->GetImageInfo();
+    if (const auto anim = this_image->GetAnimation(); anim && player_) {
+      cout << "Frame " << anim_frame_.frame + 1 << " of "
+           << anim->FrameCount() << ", " << anim->KeyframeCount()
+           << " keyframes, " << player_->Ready() << " decoded ahead\n";
+    }
+    cout << "Drawn in " << display_time_.count() << " us\n"
+         << "Cached: " << cache_.ResidentCount() << " of " << image_count
+         << " images, " << (cache_.ResidentBytes() >> 10) << " kB\n\n";
+  }
+}
+
+// Frames are taken from the player once the one shown has been up for its
+// time; time left over carries into the next frame's, up to a frame of the
+// display, so that frames the player was late with are not made up for by
+// rushing through those after them.
+void Renderer::UpdateAnimation(const shared_ptr<ImageFile> &image_file) {
+  const auto anim = image_file && image_file->IsLoaded()
+                        ? image_file->GetAnimation()
+                        : nullptr;
+  // Another image, or one still decoding, leaves any animation behind; the
+  // next one starts from its first frame.
+  if (!anim || (player_ && player_->Animation() != anim)) {
+    player_.reset();
+    anim_frame_ = IFFReader::ResolvedFrame();
+    anim_paused_ = false;
+    if (!anim) {
+      return;
+    }
+  }
+  if (!player_) {
+    player_ = std::make_unique<IFFReader::AnimationPlayer>(anim,
+                                                           anim_frame_.frame);
+    anim_show_next_ = true;
+  }
+
+  // P pauses and resumes. Up and down step a frame back or forward, page up
+  // and down a tenth of the animation; stepping pauses, seeking does not.
+  const auto count = anim->FrameCount();
+  const auto shown = anim_frame_.frame;
+  const auto jump = std::max<size_t>(count / 10, 1) % count;
+  if (GetKey(olc::Key::P).bReleased) {
+    anim_paused_ = !anim_paused_;
+  }
+  if (GetKey(olc::Key::DOWN).bReleased) {
+    anim_paused_ = true;
+    anim_show_next_ = true; // Frames after the one shown are next anyway.
+  }
+
+  size_t target = shown;
+  if (GetKey(olc::Key::UP).bReleased) {
+    anim_paused_ = true;
+    target = (shown + count - 1) % count;
+  }
+  if (GetKey(olc::Key::PGUP).bReleased) {
+    target = (shown + count - jump) % count;
+  }
+  if (GetKey(olc::Key::PGDN).bReleased) {
+    target = (shown + jump) % count;
   }
+  if (target != shown) {
+    player_->Seek(target);
+    anim_show_next_ = true;
+  }
+
+  if (!anim_paused_) {
+    anim_clock_ += microseconds(FrameDuration());
+  }
+  const auto due = microseconds(anim_frame_.jiffies * JIFFY);
+  const bool show = anim_show_next_ || (!anim_paused_ && anim_clock_ >= due);
+  if (show && player_->Pop(anim_frame_)) {
+    anim_clock_ = anim_show_next_ || anim_clock_ < due
+                      ? microseconds(0)
+                      : std::min(anim_clock_ - due,
+                                 microseconds(FrameDuration()));
+    anim_show_next_ = false;
+    Invalidate(Redraw::Full);
+  }
+}
+
+// Zoom keeps the point at the center of the view in place. Dragging with
+// the left button moves the image along with the mouse.
+void Renderer::UpdateZoom() {
+  const auto image_file = CurrentImage();
+  if (!image_file || !image_file->IsLoaded() || recenter_) {
+    return;
+  }
+  const auto image = image_file->Get();
+
+  auto zoom = zoom_;
+  const auto wheel = GetMouseWheel();
+  if (wheel > 0 || GetKey(olc::Key::NP_ADD).bReleased ||
+      GetKey(olc::Key::PGUP).bReleased) {
+    ++zoom;
+  }
+  if (wheel < 0 || GetKey(olc::Key::NP_SUB).bReleased ||
+      GetKey(olc::Key::PGDN).bReleased) {
+    --zoom;
+  }
+  zoom = std::clamp(zoom, MIN_ZOOM, MAX_ZOOM);
+
+  const auto x = view_x_;
+  const auto y = view_y_;
+  if (zoom != zoom_) {
+    const auto before = std::ldexp(1.0, zoom_);
+    const auto after = std::ldexp(1.0, zoom);
+    view_x_ += VIEW_WIDTH / 2 * (1 / before - 1 / after);
+    view_y_ += VIEW_HEIGHT / 2 * (1 / before - 1 / after);
+  }
+
+  const auto scale = std::ldexp(1.0, zoom);
+  if (GetMouse(0).bPressed) {
+    drag_x_ = GetMouseX();
+    drag_y_ = GetMouseY();
+  } else if (GetMouse(0).bHeld) {
+    view_x_ -= (GetMouseX() - drag_x_) / scale;
+    view_y_ -= (GetMouseY() - drag_y_) / scale;
+    drag_x_ = GetMouseX();
+    drag_y_ = GetMouseY();
+  }
+
+  // A quarter of the view per press.
+  if (GetKey(olc::Key::SHIFT).bHeld) {
+    const auto step_x = VIEW_WIDTH / 4 / scale;
+    const auto step_y = VIEW_HEIGHT / 4 / scale;
+    view_x_ -= GetKey(olc::Key::LEFT).bReleased ? step_x : 0;
+    view_x_ += GetKey(olc::Key::RIGHT).bReleased ? step_x : 0;
+    view_y_ -= GetKey(olc::Key::UP).bReleased ? step_y : 0;
+    view_y_ += GetKey(olc::Key::DOWN).bReleased ? step_y : 0;
+  }
+
+  if (GetKey(olc::Key::HOME).bReleased) {
+    recenter_ = true;
+  }
+
+  if (zoom != zoom_ || x != view_x_ || y != view_y_ || recenter_) {
+    zoom_ = zoom;
+    ClampView(image->width(), image->height());
+    Invalidate(Redraw::Full);
+  }
+}
+
+// An image larger than the view stays covering it; a smaller one stays
+// wholly inside it.
+void Renderer::ClampView(const uint32_t width, const uint32_t height) {
+  const auto scale = std::ldexp(1.0, zoom_);
+  const auto clamp = [](double &origin, const double extent,
+                        const double view) {
+    const auto low = std::min(0.0, extent - view);
+    const auto high = std::max(0.0, extent - view);
+    origin = std::clamp(origin, low, high);
+  };
+  clamp(view_x_, width, VIEW_WIDTH / scale);
+  clamp(view_y_, height, VIEW_HEIGHT / scale);
+}
+
+// Keys for the contact sheet: arrows move the selection, and the sheet is
+// drawn again whenever more thumbnails are done.
+void Renderer::UpdateSheet(const size_t image_count) {
+  const auto stored_image = current_image;
+
+  if (BackKeyReleased()) {
+    current_image = (current_image == 0) ? image_count - 1 : current_image - 1;
+  }
+  if (ForwardKeyReleased()) {
+    current_image = (current_image + 1) % image_count;
+  }
+  if (GetKey(olc::Key::UP).bReleased && current_image >= SHEET_COLUMNS) {
+    current_image -= SHEET_COLUMNS;
+  }
+  if (GetKey(olc::Key::DOWN).bReleased &&
+      current_image + SHEET_COLUMNS < image_count) {
+    current_image += SHEET_COLUMNS;
+  }
+
+  if (stored_image != current_image ||
+      sheet_.Completed() != sheet_completed_) {
+    Invalidate(Redraw::Full);
+  }
+}
+
+bool Renderer::OnUserUpdate(float fElapsedTime) {
+  if (break_no_valid_iff) {
+    return false;
+  }
+  pacer_.BeginFrame();
+  const auto image_count = cache_.Size();
+  if (image_count == 0) { // Nothing probed yet.
+    pacer_.EndFrame();
+    return !(break_requested && done_loading_files);
+  }
+
+  // Keeps the current image and its neighbours decoded.
+  cache_.View(current_image);
+
+  // Toggle between the single image and the contact sheet, which starts
+  // out on the current image.
+  if (GetKey(olc::Key::G).bReleased) {
+    if (const auto image = CurrentImage(); cycling_ && image) {
+      image->Get()->ResetColorCycling();
+    }
+    cycling_ = false;
+    sheet_mode_ = !sheet_mode_;
+    Clear(olc::BLACK);
+    Invalidate(Redraw::Full);
+  }
+
+  if (sheet_mode_) {
+    UpdateSheet(image_count);
+  } else {
+    UpdateImage(image_count);
+  }
+
+  // Frames where nothing changed skip drawing altogether, leaving the
+  // previous frame in the draw target.
+  Repaint();
+
+  // Frame timing, drawn over the screen and logged every so often.
+  if (GetKey(olc::Key::F).bReleased) {
+    frame_overlay_ = !frame_overlay_;
+  }
+  if (frame_overlay_) {
+    const auto text = FormatFrameStats(pacer_.Stats());
+    DrawStringDecal({3.0f, 3.0f}, text, olc::BLACK);
+    DrawStringDecal({2.0f, 2.0f}, text, olc::YELLOW);
+  }
+  LogFrameStats();
 
   // Close viewer on keypress.
   const auto exit_key_pressed =
@@ -145,6 +832,9 @@ bool Renderer::OnUserUpdate(float fElapsedTime) {
     break_requested = true;
   }
 
+  // Thread sleeps until next Vertical Blank, letting us conserve resources.
+  pacer_.EndFrame();
+
   // We test if the unpacking thread is done.
   const bool actually_break = break_requested && done_loading_files;
 
@@ -152,6 +842,25 @@ bool Renderer::OnUserUpdate(float fElapsedTime) {
   return (!actually_break);
 }
 
+void Renderer::SetFrameLog(const std::chrono::seconds interval) {
+  frame_log_interval_ = interval;
+}
+
+void Renderer::LogFrameStats() {
+  if (frame_log_interval_.count() == 0) {
+    return;
+  }
+
+  const auto now = steady_clock::now();
+  if (now - last_frame_log_ < frame_log_interval_) {
+    return;
+  }
+  if (last_frame_log_ != steady_clock::time_point()) {
+    cout << "Frames: " << FormatFrameStats(pacer_.Stats()) << "\n";
+  }
+  last_frame_log_ = now;
+}
+
 // Time between vertical blank refresh of the screen in microseconds.
 const unsigned int Renderer::FrameDuration() const {
   switch (tv_standard_) {
@@ -163,17 +872,10 @@ const unsigned int Renderer::FrameDuration() const {
   }
 }
 
-const bool Renderer::Viewable() const {
-  return images_.size() != 0 &&
-         any_of(begin(images_), end(images_),
-                [](const ImageFile &f) { return f.IsLoaded(); });
-}
+const bool Renderer::Viewable() const { return cache_.Size() != 0; }
 
-const bool Renderer::AddImage(
-    const fs::path &path) { // Add file to collection (=open for viewing).
-  if (auto image = ImageFile(path.string()); image.Get()) {
-    AddImage(image);
-    return true;
-  }
-  return false;
+// Add file to collection (=open for viewing). Only probes the file; the
+// cache decodes it once the viewer gets close.
+const bool Renderer::AddImage(const fs::path &path) {
+  return cache_.Add(path);
 }
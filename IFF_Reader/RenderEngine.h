@@ -1,7 +1,15 @@
 #pragma once
 
-#include "ImageFile.h"
+#include "AnimationPlayer.h"
+#include "CRTFilter.h"
+#include "FramePacer.h"
+#include "ImageCache.h"
+#include "InterlaceFields.h"
+#include "ThumbnailSheet.h"
+#include "TileCache.h"
 #include "olcPixelGameEngine.h"
+#include <chrono>
+#include <memory>
 
 using std::ofstream;
 using std::vector;
@@ -9,19 +17,91 @@ namespace fs = std::filesystem;
 
 enum class TVStandard { PAL, NTSC };
 
+// How much of the screen needs drawing again, in increasing order. Changing
+// image, toggling OCS correction or resizing the screen calls for a full
+// redraw; a color cycling step only for pixels in cycling registers, and an
+// interlaced frame only for showing the next field.
+enum class Redraw { Clean, Field, Cycled, Full };
+
+// Pixel aspect correction: off (one image pixel per screen pixel), smooth
+// (cubic) or sharp (nearest neighbour).
+enum class AspectMode { Off, Smooth, Sharp };
+
+// Interlaced images: shown whole (off), a field per frame (flicker), or with
+// lines blended as by a flicker fixer.
+enum class InterlaceMode { Off, Flicker, FlickerFixer };
+
 // Renderer class has started to become God object. Should
 // be subordinate to actual viewer via composition.
 class Renderer : public olc::PixelGameEngine {
-  vector<ImageFile> images_;
+  ImageCache cache_;
   size_t current_image = 0;
   double cyclic = 0;
   bool break_requested = false;
   bool break_no_valid_iff = false;
   bool done_loading_files = false;
   TVStandard tv_standard_ = TVStandard::PAL;
-
-  // Adds given image to the file list.
-  void AddImage(ImageFile &img);
+  bool cycling_ = false;
+  Redraw redraw_ = Redraw::Clean;
+
+  // Contact sheet mode, and how many thumbnails were done when it was last
+  // drawn.
+  ThumbnailSheet sheet_;
+  bool sheet_mode_ = false;
+  size_t sheet_completed_ = 0;
+
+  // Aspect correction, and the unscaled image it is resolved into first.
+  AspectMode aspect_mode_ = AspectMode::Off;
+  vector<uint32_t> unscaled_;
+
+  // CRT simulation, at crt_scale_ times the size, or off if zero. The
+  // filter keeps its tables until the image size changes, and takes the
+  // aspect corrected image from scaled_ if there is one.
+  uint32_t crt_scale_ = 0;
+  std::unique_ptr<IFFReader::CRTFilter> crt_;
+  vector<uint32_t> scaled_;
+
+  // Fields of the current image when it is shown interlaced, built from the
+  // screen after each full redraw, and the field shown this frame.
+  InterlaceMode interlace_mode_ = InterlaceMode::Off;
+  std::unique_ptr<IFFReader::InterlaceFields> fields_;
+  uint32_t field_ = 0;
+
+  // Zoomed view: a window of fixed size onto the image at 2^zoom_ times its
+  // size, with image pixel (view_x_, view_y_) at the top left. Tiles of the
+  // image are cached for it; the view is centered again on the next redraw
+  // if recenter_ is set.
+  bool zoom_view_ = false;
+  int32_t zoom_ = 0;
+  double view_x_ = 0;
+  double view_y_ = 0;
+  bool recenter_ = false;
+  int32_t drag_x_ = 0;
+  int32_t drag_y_ = 0;
+  std::unique_ptr<IFFReader::TileCache> tiles_;
+
+  // Animation playback. The player decodes frames ahead; the one on screen
+  // is kept in anim_frame_ and stays up for as many jiffies as it says,
+  // counted in frames of the display. While paused, a frame is only taken
+  // when asked for by stepping or seeking.
+  std::unique_ptr<IFFReader::AnimationPlayer> player_;
+  IFFReader::ResolvedFrame anim_frame_;
+  std::chrono::microseconds anim_clock_{0};
+  bool anim_paused_ = false;
+  bool anim_show_next_ = false;
+
+  // Time taken by the last full redraw, shown with the image information.
+  std::chrono::microseconds display_time_{0};
+
+  // Frame pacing, and frame timing shown on screen or logged to the console
+  // every frame_log_interval_ (never if zero).
+  FramePacer pacer_;
+  bool frame_overlay_ = false;
+  std::chrono::seconds frame_log_interval_{0};
+  std::chrono::steady_clock::time_point last_frame_log_;
+
+  // Decoded current image, or empty while it is being decoded.
+  shared_ptr<ImageFile> CurrentImage() const;
 
   // Tests if user wants to go back one image.
   const bool BackKeyReleased();
@@ -39,15 +119,44 @@ class Renderer : public olc::PixelGameEngine {
   // Draw the image to screen.
   void DisplayImage();
 
-public:
-  Renderer();
+  // Draw the visible part of the image in the zoomed view.
+  void DisplayZoomed(const shared_ptr<IFFReader::ILBM> &image);
+
+  // Draw a page of thumbnails, with the current image highlighted.
+  void DisplaySheet();
+
+  // Handles keys while viewing a single image.
+  void UpdateImage(const size_t image_count);
+
+  // Plays the current image if it is an animation, and handles its keys.
+  void UpdateAnimation(const shared_ptr<ImageFile> &image_file);
+
+  // Handles zooming and panning in the zoomed view.
+  void UpdateZoom();
+
+  // Keeps the view from drifting off the image.
+  void ClampView(const uint32_t width, const uint32_t height);
 
-  // Returns the stored image file as an array of integers.
-  const vector<uint32_t> GetData(const size_t n) const;
+  // Handles keys while viewing the contact sheet.
+  void UpdateSheet(const size_t image_count);
 
-  // If file has been loaded by viewer, returns index; otherwise
-  // returns total file count. Used by test generation.
-  const size_t GetFilePosByAbspath(const fs::path path) const;
+  // Copies the current field, or the blended fields, to the screen.
+  void PresentField();
+
+  // Redraw only the pixels whose colors were changed by color cycling.
+  void RedrawCycledPixels();
+
+  // Marks the screen as needing at least the given redraw.
+  void Invalidate(const Redraw redraw);
+
+  // Draws whatever was invalidated since the last frame, if anything.
+  void Repaint();
+
+  // Prints frame timing if logging is on and it is time to.
+  void LogFrameStats();
+
+public:
+  Renderer();
 
   // Thread communication.
   // Renderer requests file reader to halt.
@@ -73,4 +182,16 @@ public:
 
   // Open this file and add it to the viewable files.
   const bool AddImage(const fs::path &path);
+
+  // Memory budget for decoded images, in bytes, and how many images on
+  // either side of the current one to decode ahead.
+  void SetCacheLimits(const size_t budget, const size_t neighbours);
+
+  // Keeps decoded images in sidecar files in the given folder, up to limit
+  // bytes of them, for images and thumbnails alike.
+  void SetDecodeCache(const fs::path &folder, const uintmax_t limit);
+
+  // Logs frame timing to the console at the given interval; zero turns
+  // logging off.
+  void SetFrameLog(const std::chrono::seconds interval);
 };
@@ -0,0 +1,44 @@
+#include "Simd.h"
+
+#if IFF_SIMD_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// AVX2 needs both the CPU flag and an OS that saves YMM registers.
+static const IFFReader::SimdLevel Probe() {
+#if IFF_SIMD_X86 && defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  const auto max_leaf = info[0];
+
+  __cpuid(info, 1);
+  const bool sse2 = (info[3] & (1 << 26)) != 0;
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+
+  bool avx2 = false;
+  if (max_leaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+    __cpuidex(info, 7, 0);
+    avx2 = (info[1] & (1 << 5)) != 0;
+  }
+
+  if (avx2) {
+    return IFFReader::SimdLevel::AVX2;
+  }
+  return sse2 ? IFFReader::SimdLevel::SSE2 : IFFReader::SimdLevel::Scalar;
+#elif IFF_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return IFFReader::SimdLevel::AVX2;
+  }
+  return __builtin_cpu_supports("sse2") ? IFFReader::SimdLevel::SSE2
+                                        : IFFReader::SimdLevel::Scalar;
+#else
+  return IFFReader::SimdLevel::Scalar;
+#endif
+}
+
+const IFFReader::SimdLevel IFFReader::DetectSimdLevel() {
+  static const auto level = Probe();
+  return level;
+}
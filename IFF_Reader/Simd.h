@@ -0,0 +1,32 @@
+#pragma once
+
+/*
+ * Vector instruction support. Kernels come in scalar, SSE2 and AVX2 flavors;
+ * the best one the running CPU supports is picked at runtime, so that a
+ * single build runs anywhere. Scalar versions are the reference: vector
+ * versions must produce exactly the same output.
+ */
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) ||            \
+    defined(__i386__)
+#define IFF_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define IFF_SIMD_X86 0
+#endif
+
+// MSVC accepts any intrinsic anywhere; GCC and Clang need functions using
+// AVX2 marked as such.
+#if IFF_SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define IFF_TARGET_AVX2 __attribute__((target("avx2")))
+#define IFF_TARGET_SSE2 __attribute__((target("sse2")))
+#else
+#define IFF_TARGET_AVX2
+#define IFF_TARGET_SSE2
+#endif
+
+namespace IFFReader {
+enum class SimdLevel { Scalar, SSE2, AVX2 };
+
+// Best instruction set supported by the running CPU. Detected once.
+const SimdLevel DetectSimdLevel();
+} // namespace IFFReader
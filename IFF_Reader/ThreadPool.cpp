@@ -0,0 +1,118 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+IFFReader::ThreadPool::ThreadPool(size_t threads) {
+  if (threads == 0) {
+    const auto hardware = std::thread::hardware_concurrency();
+    threads = hardware > 1 ? hardware - 1 : 1;
+  }
+
+  for (size_t i = 0; i < threads; ++i) {
+    workers_.emplace_back([this] { Work(); });
+  }
+}
+
+IFFReader::ThreadPool::~ThreadPool() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void IFFReader::ThreadPool::Work() {
+  for (;;) {
+    function<void()> task;
+    {
+      unique_lock<mutex> lock(mutex_);
+      wake_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return; // Stopping, and nothing left to do.
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+const size_t IFFReader::ThreadPool::Size() const { return workers_.size(); }
+
+void IFFReader::ThreadPool::Submit(function<void()> task) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  wake_.notify_one();
+}
+
+// Blocks are handed out through a shared counter. Helpers that start after
+// everything has been claimed simply return; the caller waits only for the
+// blocks themselves, so helpers stuck in the queue never hold it up.
+void IFFReader::ThreadPool::ParallelFor(
+    const size_t begin, const size_t end, const size_t grain,
+    const function<void(size_t, size_t)> &body) {
+  if (begin >= end) {
+    return;
+  }
+
+  const auto step = std::max<size_t>(grain, 1);
+  const auto blocks = (end - begin + step - 1) / step;
+
+  if (blocks == 1 || workers_.empty()) {
+    for (auto first = begin; first < end; first += step) {
+      body(first, std::min(end, first + step));
+    }
+    return;
+  }
+
+  struct Job {
+    std::atomic<size_t> next{0};
+    size_t done = 0;
+    mutex lock;
+    std::condition_variable finished;
+  };
+  auto job = std::make_shared<Job>();
+
+  // Copies of the body are cheap next to a block of scanlines, and keep the
+  // helper valid however late it runs.
+  const auto run = [job, begin, end, step, blocks, body] {
+    size_t completed = 0;
+    for (auto block = job->next++; block < blocks; block = job->next++) {
+      const auto first = begin + block * step;
+      body(first, std::min(end, first + step));
+      ++completed;
+    }
+
+    if (completed > 0) {
+      lock_guard<mutex> lock(job->lock);
+      job->done += completed;
+      if (job->done == blocks) {
+        job->finished.notify_all();
+      }
+    }
+  };
+
+  const auto helpers = std::min(workers_.size(), blocks - 1);
+  for (size_t i = 0; i < helpers; ++i) {
+    Submit(run);
+  }
+  run();
+
+  unique_lock<mutex> lock(job->lock);
+  job->finished.wait(lock, [&] { return job->done == blocks; });
+}
+
+IFFReader::ThreadPool &IFFReader::ThreadPool::Shared() {
+  static ThreadPool pool;
+  return pool;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::function;
+using std::vector;
+
+/*
+ * Most of the heavy lifting in here (statistics, conversion, filtering,
+ * encoding) splits naturally into bands of scanlines that can be processed
+ * independently. The pool keeps one worker per core around for that, rather
+ * than starting threads for every job.
+ *
+ * ParallelFor lets the calling thread take part in the work. Since it only
+ * waits for work that has actually been claimed, it cannot deadlock when
+ * called from inside a worker, or when all workers are busy elsewhere.
+ */
+namespace IFFReader {
+class ThreadPool {
+  vector<std::thread> workers_;
+  std::deque<function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+
+  // Takes tasks off the queue until the pool is destroyed.
+  void Work();
+
+public:
+  // Zero threads means one per hardware thread, less the caller's.
+  explicit ThreadPool(size_t threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Number of worker threads, not counting callers of ParallelFor.
+  const size_t Size() const;
+
+  // Queues a task. Tasks must not throw.
+  void Submit(function<void()> task);
+
+  // Calls body(first, last) for consecutive blocks of at most grain items
+  // covering [begin, end), spread over the pool and the calling thread.
+  // Returns once all blocks are done.
+  void ParallelFor(const size_t begin, const size_t end, const size_t grain,
+                   const function<void(size_t, size_t)> &body);
+
+  // Pool shared by the whole program, started on first use.
+  static ThreadPool &Shared();
+};
+} // namespace IFFReader
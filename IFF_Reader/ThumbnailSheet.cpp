@@ -0,0 +1,82 @@
+#include "ThumbnailSheet.h"
+#include "FileData.h"
+#include "ThreadPool.h"
+
+using std::lock_guard;
+using std::make_shared;
+using std::mutex;
+using std::unique_lock;
+
+ThumbnailSheet::ThumbnailSheet(const uint32_t size) : size_(size) {}
+
+ThumbnailSheet::~ThumbnailSheet() {
+  unique_lock<mutex> lock(mutex_);
+  stopping_ = true;
+  finished_.wait(lock, [this] { return pending_ == 0; });
+}
+
+// Files that fail to decode leave their slot empty, but still count as
+// completed, so the sheet is not redrawn waiting for them. Animations,
+// which the decode cache does not keep, show their first frame.
+void ThumbnailSheet::Generate(const size_t n, const fs::path path) {
+  shared_ptr<const IFFReader::DecodeCache> decode_cache;
+  bool stopping;
+  {
+    lock_guard<mutex> lock(mutex_);
+    decode_cache = decode_cache_;
+    stopping = stopping_;
+  }
+
+  shared_ptr<const IFFReader::Thumbnail> thumbnail;
+  if (!stopping) {
+    auto ilbm = decode_cache ? decode_cache->Open(path) : nullptr;
+    if (!ilbm) {
+      const IFFReader::File file(path.string());
+      const auto anim = file.AsANIM();
+      ilbm = anim ? anim->Image() : file.AsILBM();
+    }
+    if (ilbm) {
+      thumbnail = make_shared<const IFFReader::Thumbnail>(
+          IFFReader::MakeThumbnail(*ilbm, size_));
+    }
+  }
+
+  lock_guard<mutex> lock(mutex_);
+  slots_[n].thumbnail = thumbnail;
+  ++completed_;
+  --pending_;
+  finished_.notify_all();
+}
+
+void ThumbnailSheet::SetDecodeCache(
+    shared_ptr<const IFFReader::DecodeCache> decode_cache) {
+  lock_guard<mutex> lock(mutex_);
+  decode_cache_ = std::move(decode_cache);
+}
+
+void ThumbnailSheet::Request(const size_t n, const fs::path &path) {
+  lock_guard<mutex> lock(mutex_);
+  if (n >= slots_.size()) {
+    slots_.resize(n + 1);
+  }
+  if (slots_[n].requested || stopping_) {
+    return;
+  }
+
+  slots_[n].requested = true;
+  ++pending_;
+  IFFReader::ThreadPool::Shared().Submit(
+      [this, n, path] { Generate(n, path); });
+}
+
+shared_ptr<const IFFReader::Thumbnail>
+ThumbnailSheet::Get(const size_t n) const {
+  lock_guard<mutex> lock(mutex_);
+  return n < slots_.size() ? slots_[n].thumbnail
+                           : shared_ptr<const IFFReader::Thumbnail>();
+}
+
+const size_t ThumbnailSheet::Completed() const {
+  lock_guard<mutex> lock(mutex_);
+  return completed_;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "DecodeCache.h"
+#include "Downscale.h"
+
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+
+using std::shared_ptr;
+using std::vector;
+namespace fs = std::filesystem;
+
+/*
+ * Thumbnails for the contact sheet. Each is made on the thread pool when
+ * first requested, straight from the file, without going through the image
+ * cache: a page of the sheet touches far more images than the cache would
+ * want to keep. Thumbnails are small, and kept once made.
+ *
+ * All members may be called from any thread.
+ */
+class ThumbnailSheet {
+  struct Slot {
+    shared_ptr<const IFFReader::Thumbnail> thumbnail;
+    bool requested = false;
+  };
+
+  vector<Slot> slots_;
+  shared_ptr<const IFFReader::DecodeCache> decode_cache_;
+  mutable std::mutex mutex_;
+  std::condition_variable finished_;
+  uint32_t size_;
+  size_t pending_ = 0;
+  size_t completed_ = 0;
+  bool stopping_ = false;
+
+  // Decodes the image and shrinks it, on a pool thread.
+  void Generate(const size_t n, const fs::path path);
+
+public:
+  // Thumbnails fit within size x size pixels.
+  explicit ThumbnailSheet(const uint32_t size);
+
+  // Waits for thumbnails in the making.
+  ~ThumbnailSheet();
+
+  // Sidecar cache images are loaded through; none if empty.
+  void SetDecodeCache(shared_ptr<const IFFReader::DecodeCache> decode_cache);
+
+  // Starts making the thumbnail of image n, unless already done or under way.
+  void Request(const size_t n, const fs::path &path);
+
+  // Thumbnail of image n, or empty if not made (yet).
+  shared_ptr<const IFFReader::Thumbnail> Get(const size_t n) const;
+
+  // Thumbnails finished so far, including failed ones. Changes whenever a
+  // new thumbnail becomes available.
+  const size_t Completed() const;
+};
@@ -0,0 +1,142 @@
+#include "TileCache.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+constexpr size_t TILE_BYTES = IFFReader::TileCache::TILE_SIZE *
+                              IFFReader::TileCache::TILE_SIZE *
+                              sizeof(uint32_t);
+
+IFFReader::TileCache::TileCache(shared_ptr<const ILBM> image,
+                                const size_t budget)
+    : image_(std::move(image)), budget_(budget) {}
+
+const shared_ptr<const IFFReader::ILBM> &
+IFFReader::TileCache::Image() const {
+  return image_;
+}
+
+const uint32_t IFFReader::TileCache::LevelWidth(const uint32_t level) const {
+  return (image_->width() + (1u << level) - 1) >> level;
+}
+
+const uint32_t IFFReader::TileCache::LevelHeight(const uint32_t level) const {
+  return (image_->height() + (1u << level) - 1) >> level;
+}
+
+const uint32_t IFFReader::TileCache::Columns(const uint32_t level) const {
+  return (LevelWidth(level) + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+const uint32_t IFFReader::TileCache::Rows(const uint32_t level) const {
+  return (LevelHeight(level) + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+// Each row of the tile row is resolved in full, then every 2^level-th pixel
+// of it is handed out to the tiles. Rows are spread over the thread pool.
+// Tiles are created before the work starts, so the map is not touched by
+// more than one thread.
+void IFFReader::TileCache::BuildTiles(const uint32_t level, const uint32_t row,
+                                      const vector<uint32_t> &columns) {
+  vector<Tile *> tiles;
+  for (const auto column : columns) {
+    auto &tile = tiles_[Key(level, column, row)];
+    tile.pixels.resize(TILE_SIZE * TILE_SIZE);
+    tile.last_used = clock_;
+    resident_bytes_ += TILE_BYTES;
+    tiles.push_back(&tile);
+  }
+
+  const auto width = image_->width();
+  const auto first = row * TILE_SIZE;
+  const auto last = std::min(first + TILE_SIZE, LevelHeight(level));
+
+  // Level 0 resolves a few rows per call; other levels skip rows.
+  constexpr uint32_t BATCH = 16;
+  const auto batch = level == 0 ? BATCH : 1;
+
+  ThreadPool::Shared().ParallelFor(
+      first, last, BATCH, [&](const size_t begin, const size_t end) {
+        vector<uint32_t> resolved(static_cast<size_t>(width) * batch);
+
+        for (auto y = static_cast<uint32_t>(begin); y < end; y += batch) {
+          const auto count = std::min<uint32_t>(batch, end - y);
+          if (level == 0) {
+            image_->ResolveRows(y, y + count, resolved.data(), width);
+          } else {
+            image_->ResolveRows(y << level, (y << level) + 1,
+                                resolved.data(), width);
+          }
+
+          for (uint32_t k = 0; k < count; ++k) {
+            const auto *source = resolved.data() + k * width;
+            for (size_t t = 0; t < tiles.size(); ++t) {
+              auto *out = tiles[t]->pixels.data() +
+                          (y + k - first) * TILE_SIZE;
+              const auto x0 = columns[t] * TILE_SIZE;
+              const auto x1 = std::min(x0 + TILE_SIZE, LevelWidth(level));
+              for (auto x = x0; x < x1; ++x) {
+                out[x - x0] = source[static_cast<size_t>(x) << level];
+              }
+            }
+          }
+        }
+      });
+}
+
+void IFFReader::TileCache::Evict() {
+  while (resident_bytes_ > budget_) {
+    auto oldest = tiles_.end();
+    for (auto tile = tiles_.begin(); tile != tiles_.end(); ++tile) {
+      if (tile->second.last_used != clock_ &&
+          (oldest == tiles_.end() ||
+           tile->second.last_used < oldest->second.last_used)) {
+        oldest = tile;
+      }
+    }
+    if (oldest == tiles_.end()) {
+      return; // Everything left is in view.
+    }
+    tiles_.erase(oldest);
+    resident_bytes_ -= TILE_BYTES;
+  }
+}
+
+void IFFReader::TileCache::Prepare(const uint32_t level,
+                                   const uint32_t first_column,
+                                   const uint32_t last_column,
+                                   const uint32_t first_row,
+                                   const uint32_t last_row) {
+  ++clock_;
+  const auto columns = std::min(last_column, Columns(level));
+  const auto rows = std::min(last_row, Rows(level));
+
+  for (auto row = first_row; row < rows; ++row) {
+    vector<uint32_t> missing;
+    for (auto column = first_column; column < columns; ++column) {
+      const auto tile = tiles_.find(Key(level, column, row));
+      if (tile == tiles_.end()) {
+        missing.push_back(column);
+      } else {
+        tile->second.last_used = clock_;
+      }
+    }
+
+    if (!missing.empty()) {
+      BuildTiles(level, row, missing);
+    }
+  }
+
+  Evict();
+}
+
+const uint32_t *IFFReader::TileCache::Get(const uint32_t level,
+                                          const uint32_t column,
+                                          const uint32_t row) const {
+  const auto tile = tiles_.find(Key(level, column, row));
+  return tile == tiles_.end() ? nullptr : tile->second.pixels.data();
+}
+
+const size_t IFFReader::TileCache::ResidentBytes() const {
+  return resident_bytes_;
+}
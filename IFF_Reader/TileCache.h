@@ -0,0 +1,76 @@
+#pragma once
+#include "InterleavedBitmap.h"
+
+#include <map>
+#include <memory>
+#include <tuple>
+
+using std::shared_ptr;
+using std::vector;
+
+/*
+ * Resolved pixels of an image, cut into square tiles and kept for as long
+ * as a memory budget allows, so that a zoomed view only resolves what comes
+ * into sight. Tiles not used for the longest time are dropped first.
+ *
+ * Zooming out uses levels: level n holds every 2^n-th pixel of every 2^n-th
+ * row, so the tiles covering a view stay few however large the image. A
+ * row has to be resolved across the full width (HAM depends on the pixels
+ * to its left), so all missing tiles of a tile row are built from the same
+ * resolved rows.
+ */
+namespace IFFReader {
+
+class TileCache {
+public:
+  static constexpr uint32_t TILE_SIZE = 256;
+
+private:
+  struct Tile {
+    vector<uint32_t> pixels;
+    uint64_t last_used = 0;
+  };
+
+  // Tiles by level, column and row.
+  using Key = std::tuple<uint32_t, uint32_t, uint32_t>;
+
+  shared_ptr<const ILBM> image_;
+  size_t budget_;
+  size_t resident_bytes_ = 0;
+  uint64_t clock_ = 0;
+  std::map<Key, Tile> tiles_;
+
+  // Builds the given tiles of one tile row; all of them must be missing.
+  void BuildTiles(const uint32_t level, const uint32_t row,
+                  const vector<uint32_t> &columns);
+
+  // Drops least recently used tiles, sparing those used this round.
+  void Evict();
+
+public:
+  TileCache(shared_ptr<const ILBM> image, const size_t budget);
+
+  const shared_ptr<const ILBM> &Image() const;
+
+  // Size of the image at a level, in that level's pixels.
+  const uint32_t LevelWidth(const uint32_t level) const;
+  const uint32_t LevelHeight(const uint32_t level) const;
+
+  // Number of tile columns and rows at a level.
+  const uint32_t Columns(const uint32_t level) const;
+  const uint32_t Rows(const uint32_t level) const;
+
+  // Makes tiles in columns [first_column, last_column) and rows
+  // [first_row, last_row) of a level resident, resolving those missing.
+  void Prepare(const uint32_t level, const uint32_t first_column,
+               const uint32_t last_column, const uint32_t first_row,
+               const uint32_t last_row);
+
+  // TILE_SIZE x TILE_SIZE pixels, or null if not resident. Pixels past the
+  // image's edge are undefined.
+  const uint32_t *Get(const uint32_t level, const uint32_t column,
+                      const uint32_t row) const;
+
+  const size_t ResidentBytes() const;
+};
+} // namespace IFFReader
@@ -4,6 +4,8 @@
 // O------------------------------------------------------------------------------O
 
 #define OLC_PGE_APPLICATION
+#include "AnimBenchmark.h"
+#include "BatchConverter.h"
 #include "FileData.h"
 #include "RenderEngine.h"
 #include "lyra/lyra.hpp"
@@ -11,41 +13,9 @@
 #include <thread>
 
 using std::cout;
-using std::ios;
-using std::ofstream;
 using std::ref;
 using std::thread;
 
-// Only called in debug mode. Used to build
-// files for regression test.
-void GenerateAndStoreTestFiles(
-    const vector<fs::path> &file_paths, const fs::path &path,
-    const Renderer &ilbm_viewer) 
-{ 
-  const auto root = fs::absolute(path).parent_path().parent_path();
-
-  vector<string> input_files;
-  for (auto &f : file_paths) {
-    input_files.emplace_back(f.string());
-  }
-
-  for (auto &f : file_paths) {
-    fs::path n = root;
-    n /= "ILBMviewer_test";
-    n /= "test dumps";
-    n /= (fs::absolute(f).stem().string() + ".tst");
-
-    ofstream testfile(n, ios::binary);
-    if (testfile.is_open()) {
-      const auto data = ilbm_viewer.GetData(ilbm_viewer.GetFilePosByAbspath(f));
-      for (auto &d : data) {
-        testfile.write((char *)&d, sizeof(d));
-      }
-      testfile.close();
-    }
-  }
-}
-
 // Lets the loader/unpacker work side by side with renderer.
 void add_images_threadholder(Renderer &ilbm_viewer,
 	const vector<fs::path> &file_paths) 
@@ -67,20 +37,147 @@ void add_images_threadholder(Renderer &ilbm_viewer,
   ilbm_viewer.DoneLoadingFiles();
 }
 
+// Converts a tree of images without opening a window, then reports how
+// fast it went. Writes the test dumps; archives are converted by IFF_Convert.
+int ConvertFolder(const string &input, const string &output,
+                  const string &format_name,
+                  const IFFReader::ConvertSettings &defaults) {
+  auto settings = defaults;
+  if (!IFFReader::ParseExportFormat(format_name, settings.format)) {
+    cout << "Unknown format " << format_name << ".\n";
+    return 1;
+  }
+
+  if (input.empty() || !IFFReader::CheckPath(input)) {
+    cout << "File or path " << fs::absolute(input).string() << " not found.\n";
+    return 1;
+  }
+
+  const auto stats = IFFReader::ConvertTree(
+      fs::absolute(input), fs::absolute(output), settings,
+      [](const fs::path &source, const string &reason) {
+        cout << "Skipped " << source.string() << ": " << reason << ".\n";
+      });
+  cout << IFFReader::FormatConvertStats(stats);
+
+  return stats.images > 0 ? 0 : 2;
+}
+
+// Plays every animation in a tree without showing it, and reports how long
+// each delta operation took to decode.
+int BenchmarkAnimations(const string &input, const size_t passes) {
+  if (input.empty() || !IFFReader::CheckPath(input)) {
+    cout << "File or path " << fs::absolute(input).string() << " not found.\n";
+    return 1;
+  }
+
+  IFFReader::DeltaBenchmarks results;
+  const auto measure = [&](const fs::path &source) {
+    std::ifstream stream(source, std::ios::binary);
+    const bytefield contents((std::istreambuf_iterator<char>(stream)),
+                             std::istreambuf_iterator<char>());
+    const IFFReader::File file(source.string(), contents);
+    if (const auto anim = file.AsANIM()) {
+      IFFReader::BenchmarkDeltas(*anim, passes, results);
+    }
+  };
+
+  std::error_code error;
+  const auto root = fs::absolute(input);
+  if (fs::is_regular_file(root, error)) {
+    measure(root);
+  } else {
+    for (fs::recursive_directory_iterator
+             entry(root, fs::directory_options::skip_permission_denied, error),
+         end;
+         !error && entry != end; entry.increment(error)) {
+      if (entry->is_regular_file(error)) {
+        measure(entry->path());
+      }
+    }
+  }
+  cout << IFFReader::FormatDeltaBenchmarks(results);
+
+  return results.empty() ? 2 : 0;
+}
+
+// Writes every image as regression test data (raw words, .tst) or for a
+// quick look (PPM or PAM). Rows are resolved straight into each file's
+// buffer, which is written with one call, so goldens take milliseconds.
+int GenerateAndStoreTestFiles(const string &path, string folder,
+                              const string &format_name) {
+  IFFReader::ConvertSettings settings;
+  if (format_name == "raw") {
+    settings.extension = ".tst";
+  }
+
+  if (folder.empty()) { // Where the tests look for them.
+    const auto root = fs::absolute(path).parent_path().parent_path();
+    folder = (root / "IFF_Reader_tests" / "test dumps").string();
+  }
+
+  return ConvertFolder(path, folder, format_name, settings);
+}
+
 int main(int argc, char *argv[]) 
 {
-  Renderer ilbm_viewer;
-
   string path;
   auto generating_test_files = false;
+  string dump_folder;
+  string dump_format = "raw";
   auto show_help = false;
-  const auto cli = lyra::cli_parser() | lyra::help(show_help) |
-                   lyra::opt(generating_test_files)["-g"]["--gentest"](
-                       "Generate testing data.") |
-                   lyra::arg(path, "path")("File or folder to view.");
+  size_t cache_megabytes = 512;
+  size_t lookahead = 2;
+  unsigned int frame_log = 0;
+  string decode_cache = IFFReader::DecodeCache::DefaultFolder().string();
+  size_t decode_cache_megabytes = IFFReader::DECODE_CACHE_BYTES >> 20;
+  auto no_decode_cache = false;
+
+  auto benchmarking = false;
+  string bench_input;
+  size_t bench_passes = 10;
+  auto bench = lyra::command(
+      "bench", [&](const lyra::group &) { benchmarking = true; });
+  bench.help("Time ANIM delta decoding, by operation, without a window.");
+  bench.add_argument(lyra::opt(bench_passes, "passes")["--passes"](
+      "Times to play each animation (default 10)."));
+  bench.add_argument(
+      lyra::arg(bench_input, "input")("Animation or folder tree to time."));
+
+  const auto cli =
+      lyra::cli_parser() | lyra::help(show_help) | bench |
+      lyra::opt(generating_test_files)["-g"]["--gentest"](
+          "Generate testing data instead of viewing.") |
+      lyra::opt(dump_folder, "folder")["--dump"](
+          "Folder for testing data (default: the tests' test dumps).") |
+      lyra::opt(dump_format, "raw|ppm|pam")["--dump-format"](
+          "Format of testing data (default raw, as .tst files).") |
+      lyra::opt(cache_megabytes, "megabytes")["--cache"](
+          "Memory for decoded images (default 512).") |
+      lyra::opt(lookahead, "images")["--lookahead"](
+          "Images to decode ahead in each direction (default 2).") |
+      lyra::opt(frame_log, "seconds")["--frame-log"](
+          "Log frame timing every so many seconds (default off).") |
+      lyra::opt(decode_cache, "folder")["--decode-cache"](
+          "Folder for decoded images kept between runs (default: in the "
+          "temporary folder).") |
+      lyra::opt(decode_cache_megabytes, "megabytes")["--decode-cache-size"](
+          "Disk space for decoded images kept between runs (default 256); "
+          "those used longest ago are removed first.") |
+      lyra::opt(no_decode_cache)["--no-decode-cache"](
+          "Decode every image from its file.") |
+      lyra::arg(path, "path")("File or folder to view.");
 
   const auto result = cli.parse({argc, argv});
 
+  if (benchmarking) {
+    return BenchmarkAnimations(bench_input, bench_passes);
+  }
+
+  if (generating_test_files) {
+    return GenerateAndStoreTestFiles(path, dump_folder, dump_format);
+  }
+
   if (path.empty()) {
     cout << "You need to supply a file path.\n";
     return 1;
@@ -98,24 +195,20 @@ int main(int argc, char *argv[])
     return 1;
   }
 
+  // The window is only set up once it is certain to be needed.
+  Renderer ilbm_viewer;
+  ilbm_viewer.SetCacheLimits(cache_megabytes << 20, lookahead);
+  ilbm_viewer.SetFrameLog(std::chrono::seconds(frame_log));
+  if (!no_decode_cache) {
+    ilbm_viewer.SetDecodeCache(decode_cache,
+                               uintmax_t(decode_cache_megabytes) << 20);
+  }
+
   // We open a separate thread for unpacking the images. It is their job
   // to keep track of whether or not they're loaded.
   thread image_parse_thread(add_images_threadholder, ref(ilbm_viewer),
                             ref(file_paths));
 
-  if (generating_test_files) {
-#ifdef _DEBUG
-    image_parse_thread.join();
-
-    // If we are outputting test files, we do this here, then exit.
-    GenerateAndStoreTestFiles(file_paths, path, ilbm_viewer);
-
-    return 0;
-#endif
-    cout << "Regression test file dump not supported in release version.\n";
-    return 1;
-  }
-
   if (ilbm_viewer.Construct(320, 240, 2, 2, false, true)) {
     ilbm_viewer.Start();
   }
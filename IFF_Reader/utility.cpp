@@ -41,6 +41,29 @@ const uint8_t IFFReader::read_byte(bytestream &stream) {
   return buffer;
 }
 
+// Sizes read from a header are only claims; this is what is really there.
+const uint64_t IFFReader::remaining_bytes(bytestream &stream) {
+  const auto position = stream.tellg();
+  if (position < 0) {
+    return 0;
+  }
+  stream.seekg(0, std::ios_base::end);
+  const auto end = stream.tellg();
+  stream.seekg(position);
+  return end > position ? static_cast<uint64_t>(end - position) : 0;
+}
+
+// Color registers on OCS hold four bits per component. Each nibble is
+// repeated into the low nibble, so that $0F8 becomes $00ff88.
+const uint32_t IFFReader::expand_rgb4(const uint16_t rgb4) {
+  const uint32_t r = (rgb4 >> 8) & 0xf;
+  const uint32_t g = (rgb4 >> 4) & 0xf;
+  const uint32_t b = rgb4 & 0xf;
+
+  return 0xff000000 | ((b | (b << 4)) << 16) | ((g | (g << 4)) << 8) |
+         (r | (r << 4));
+}
+
 // Checks that file path exists.
 const bool IFFReader::CheckPath(const string path) { // Patch for powershell bug
   auto temp_path = path;
@@ -75,3 +98,44 @@ const vector<fs::path> IFFReader::GetPathsInFolder(
   }
   return file_paths;
 }
+
+IFFReader::MemoryBuffer::MemoryBuffer(const uint8_t *data, const size_t size) {
+  auto *begin = const_cast<uint8_t *>(data);
+  setg(begin, begin, begin + size);
+}
+
+// Only the get area moves; it covers all the bytes there are.
+IFFReader::MemoryBuffer::pos_type
+IFFReader::MemoryBuffer::seekoff(off_type offset,
+                                 std::ios_base::seekdir direction,
+                                 std::ios_base::openmode which) {
+  if (!(which & std::ios_base::in)) {
+    return pos_type(off_type(-1));
+  }
+
+  const auto size = egptr() - eback();
+  auto position = offset;
+  if (direction == std::ios_base::cur) {
+    position += gptr() - eback();
+  } else if (direction == std::ios_base::end) {
+    position += size;
+  }
+
+  if (position < 0 || position > size) {
+    return pos_type(off_type(-1));
+  }
+  setg(eback(), eback() + position, egptr());
+  return pos_type(position);
+}
+
+IFFReader::MemoryBuffer::pos_type
+IFFReader::MemoryBuffer::seekpos(pos_type position,
+                                 std::ios_base::openmode which) {
+  return seekoff(off_type(position), std::ios_base::beg, which);
+}
+
+// The buffer is set up before the stream can read from it.
+IFFReader::MemoryStream::MemoryStream(const uint8_t *data, const size_t size)
+    : bytestream(nullptr), buffer_(data, size) {
+  rdbuf(&buffer_);
+}
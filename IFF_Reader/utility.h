@@ -5,14 +5,36 @@
 #include <vector>
 
 using std::basic_ifstream;
+using std::basic_istream;
 using std::string;
 using std::vector;
 namespace fs = std::filesystem;
 
-typedef basic_ifstream<uint8_t> bytestream;
+// Chunks are parsed from any stream of bytes: a file, or one read earlier.
+typedef basic_istream<uint8_t> bytestream;
+typedef basic_ifstream<uint8_t> bytefilestream;
 typedef vector<uint8_t> bytefield;
 
 namespace IFFReader {
+// Buffer over bytes already in memory, which must outlive it.
+class MemoryBuffer : public std::basic_streambuf<uint8_t> {
+protected:
+  pos_type seekoff(off_type offset, std::ios_base::seekdir direction,
+                   std::ios_base::openmode which) override;
+  pos_type seekpos(pos_type position, std::ios_base::openmode which) override;
+
+public:
+  MemoryBuffer(const uint8_t *data, const size_t size);
+};
+
+// Stream over bytes already in memory, for parsing files read earlier.
+class MemoryStream : public bytestream {
+  MemoryBuffer buffer_;
+
+public:
+  MemoryStream(const uint8_t *data, const size_t size);
+};
+
 enum class Chipset { OCS, AGA, VGA, SVGA, SAGA };
 enum class ScreenMode { Plain, EHB, EHB_Sliced, HAM6, HAM8, SHAM };
 
@@ -28,6 +50,12 @@ const uint16_t read_word(bytestream &stream);
 // Reads byte.
 const uint8_t read_byte(bytestream &stream);
 
+// Bytes between the read position and the end; 0 if the stream cannot seek.
+const uint64_t remaining_bytes(bytestream &stream);
+
+// Expands a 12-bit Amiga color register value (0x0RGB) to 0xAABBGGRR.
+const uint32_t expand_rgb4(const uint16_t rgb4);
+
 // Checks that file path exists.
 const bool CheckPath(const string path);
 
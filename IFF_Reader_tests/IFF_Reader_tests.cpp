@@ -1,11 +1,28 @@
+#include "AnimBenchmark.h"
+#include "AnimDelta.h"
+#include "AnimationPlayer.h"
+#include "AspectScaler.h"
+#include "BatchConverter.h"
 #include "BitmapHeader.h"
 #include "Body.h"
 #include "Chunk.h"
 #include "ColorLookup.h"
+#include "CRTFilter.h"
 #include "CommodoreAmiga.h"
+#include "DecodeCache.h"
 #include "CppUnitTest.h"
+#include "Deflate.h"
 #include "FileData.h"
+#include "FramePacer.h"
+#include "ILBMWriter.h"
+#include "Downscale.h"
+#include "ImageExport.h"
+#include "ImageProbe.h"
+#include "ImageSchema.h"
 #include "InterleavedBitmap.h"
+#include "InterlaceFields.h"
+#include "PNGEncoder.h"
+#include "TileCache.h"
 #include "pch.h"
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -47,6 +64,16 @@ const bool compare(const string name) {
   return true;
 }
 
+// Index at (x, y) in frame f of the test animations: a box moving across
+// and down over a pattern of stripes.
+static const uint8_t animation_index(const uint32_t f, const uint32_t x,
+                                     const uint32_t y) {
+  if (x >= 4 * f && x < 4 * f + 16 && y >= 10 + f && y < 30 + f) {
+    return static_cast<uint8_t>(f % 15 + 1);
+  }
+  return static_cast<uint8_t>(((x >> 3) + y / 5) & 15);
+}
+
 TEST_CLASS(ILBMviewertest){
   public :
 
@@ -65,6 +92,753 @@ TEST_METHOD(TestILBMFileRegression01B) { Assert::IsTrue(compare("01B")); }
 TEST_METHOD(TestILBMFileRegression02A) { Assert::IsTrue(compare("02A")); }
 
 TEST_METHOD(TestILBMFileRegression02B) { Assert::IsTrue(compare("02B")); }
+
+// Row resolvers must agree with per-pixel lookups.
+TEST_METHOD(TestResolveRowsMatchesColorAt) {
+  for (const auto name : {"01A", "ehb", "ham_image", "sham", "pchg"}) {
+    IFFReader::File f(string("../../IFF_Reader/test files/") + name + ".iff");
+    const auto data = f.AsILBM();
+    Assert::IsNotNull(data.get());
+
+    vector<uint32_t> rows(data->width() * data->height());
+    data->ResolveRows(0, data->height(), rows.data(), data->width());
+
+    for (unsigned int y = 0; y < data->height(); ++y) {
+      for (unsigned int x = 0; x < data->width(); ++x) {
+        Assert::AreEqual(data->color_at(x, y), rows.at(y * data->width() + x));
+      }
+    }
+  }
+}
+
+// Indices looked up in the palette give the pixels' colors: EHB expanded to
+// 64 entries, OCS correction applied when on. HAM offers no indices.
+TEST_METHOD(TestIndexedImage) {
+  IFFReader::File f("../../IFF_Reader/test files/ehb.iff");
+  const auto ehb = f.AsILBM();
+  Assert::IsTrue(ehb->HasIndexedOutput());
+  const auto plain = ehb->GetIndexed();
+  Assert::AreEqual(size_t(64), plain.palette.size());
+
+  Assert::IsTrue(ehb->allows_ocs_correction());
+  ehb->color_correction(true);
+  const auto corrected = ehb->GetIndexed();
+  Assert::IsTrue(plain.palette != corrected.palette);
+  Assert::AreEqual(size_t(ehb->width()), corrected.stride);
+  for (uint32_t y = 0; y < corrected.height; ++y) {
+    for (uint32_t x = 0; x < corrected.width; ++x) {
+      const auto index = corrected.indices[y * corrected.stride + x];
+      Assert::AreEqual(ehb->color_at(x, y), corrected.palette[index]);
+    }
+  }
+
+  IFFReader::File ham("../../IFF_Reader/test files/ham_image.iff");
+  Assert::IsFalse(ham.AsILBM()->HasIndexedOutput());
+}
+
+// Palette changes take effect on the line they are listed for.
+TEST_METHOD(TestSlicedPalettes) {
+  IFFReader::File pchg("../../IFF_Reader/test files/pchg.iff");
+  Assert::AreEqual(0xffff0000u, pchg.AsILBM()->color_at(0, 1));
+  Assert::AreEqual(0xff0000ffu, pchg.AsILBM()->color_at(0, 2));
+
+  // The same changes, Huffman packed, take effect the same way.
+  IFFReader::File packed("../../IFF_Reader/test files/pchg_huffman.iff");
+  const auto expected = IFFReader::ResolveImage(*pchg.AsILBM()).pixels;
+  Assert::IsTrue(expected ==
+                 IFFReader::ResolveImage(*packed.AsILBM()).pixels);
+
+  IFFReader::File sham("../../IFF_Reader/test files/sham.iff");
+  Assert::IsTrue(sham.AsILBM()->InferScreenMode() ==
+                 IFFReader::ScreenMode::SHAM);
+  Assert::AreEqual(0xff00ff00u, sham.AsILBM()->color_at(0, 0));
+  Assert::AreEqual(0xffff0000u, sham.AsILBM()->color_at(0, 1));
+
+  // A SHAM too short for its version word, or claiming more lines than
+  // there are, is read as far as it goes and leaves the next chunk be.
+  for (const bytefield &damaged :
+       {bytefield{0, 0, 0, 0, 'B', 'O', 'D', 'Y'},
+        bytefield{0, 0, 0, 1, 0, 0, 'B', 'O', 'D', 'Y'}}) {
+    IFFReader::MemoryStream stream(damaged.data(), damaged.size());
+    Assert::IsTrue(IFFReader::SHAM(stream).GetLinePalettes().empty());
+    Assert::IsTrue(IFFReader::read_tag(stream) == "BODY");
+  }
+  const bytefield endless = {0x7f, 0xff, 0xff, 0xff, 0, 0, 0x0f, 0xff};
+  IFFReader::MemoryStream stream(endless.data(), endless.size());
+  Assert::IsTrue(IFFReader::SHAM(stream).GetLinePalettes().empty());
+}
+
+// Cycling rotates registers 1-3 one step per jiffy; indices stay put.
+TEST_METHOD(TestColorCycling) {
+  IFFReader::File f("../../IFF_Reader/test files/cycle.iff");
+  const auto data = f.AsILBM();
+  Assert::IsTrue(data->HasColorCycling());
+
+  Assert::IsFalse(data->AdvanceColorCycling(1000));
+  Assert::IsTrue(data->AdvanceColorCycling(1000000 / 60));
+  Assert::AreEqual(0xff000000u, data->color_at(0, 0));
+  Assert::AreEqual(0xffff0000u, data->color_at(1, 0));
+  Assert::AreEqual(0xff0000ffu, data->color_at(2, 0));
+
+  data->ResetColorCycling();
+  Assert::AreEqual(0xff0000ffu, data->color_at(1, 0));
+
+  // A CCRT too short for its fields is skipped, and does not cycle.
+  const bytefield shortened = {0, 0, 0, 5, 0, 1, 2, 3, 4, 0,
+                               'B', 'O', 'D', 'Y'};
+  IFFReader::MemoryStream stream(shortened.data(), shortened.size());
+  Assert::IsFalse(CCRT(stream).GetRange().active);
+  Assert::IsTrue(IFFReader::read_tag(stream) == "BODY");
+}
+
+// Registers 1-3 each appear four times on the single line, never adjacent.
+TEST_METHOD(TestCyclingRuns) {
+  IFFReader::File f("../../IFF_Reader/test files/cycle.iff");
+  const auto &runs = f.AsILBM()->CyclingRuns();
+
+  Assert::AreEqual(size_t(12), runs.RunCount());
+  Assert::AreEqual(size_t(12), runs.PixelCount());
+  Assert::AreEqual(size_t(0), runs.RunCount(0));
+  Assert::AreEqual(size_t(4), runs.RunCount(2));
+  Assert::AreEqual(uint16_t(6), (runs.RunsBegin(2) + 1)->x);
+}
+
+// Vector kernels must match the scalar ones byte for byte, tails included.
+TEST_METHOD(TestPixelFormats) {
+  using IFFReader::PixelFormat;
+  using IFFReader::SimdLevel;
+
+  IFFReader::File f("../../IFF_Reader/test files/01A.iff");
+  const auto data = f.AsILBM();
+  const auto width = data->width() - 3; // Not a multiple of any vector size.
+
+  for (const auto format : {PixelFormat::RGBA8, PixelFormat::BGRA8,
+                            PixelFormat::RGB888, PixelFormat::RGB565,
+                            PixelFormat::Gray8}) {
+    const auto stride = width * IFFReader::BytesPerPixel(format) + 5;
+    vector<uint32_t> rows(data->width() * data->height());
+    data->ResolveRows(0, data->height(), rows.data(), data->width());
+
+    vector<uint8_t> expected(stride * data->height(), 0);
+    IFFReader::ConvertRows(rows.data(), width, data->height(), data->width(),
+                           format, expected.data(), stride, SimdLevel::Scalar);
+
+    for (const auto level : {SimdLevel::SSE2, SimdLevel::AVX2}) {
+      if (level > IFFReader::DetectSimdLevel()) {
+        continue;
+      }
+      vector<uint8_t> converted(expected.size(), 0);
+      IFFReader::ConvertRows(rows.data(), width, data->height(),
+                             data->width(), format, converted.data(), stride,
+                             level);
+      Assert::IsTrue(expected == converted);
+    }
+  }
+
+  const uint32_t orange = 0xff0080ff;
+  uint8_t bgra[4], rgb565[2], gray;
+  IFFReader::ConvertRow(&orange, 1, PixelFormat::BGRA8, bgra);
+  IFFReader::ConvertRow(&orange, 1, PixelFormat::RGB565, rgb565);
+  IFFReader::ConvertRow(&orange, 1, PixelFormat::Gray8, &gray);
+  Assert::AreEqual(uint8_t(0x00), bgra[0]);
+  Assert::AreEqual(uint8_t(0xff), bgra[2]);
+  Assert::AreEqual(uint8_t(0xfc), rgb565[1]);
+  Assert::AreEqual(uint8_t(0x00), rgb565[0]);
+  Assert::AreEqual(uint8_t(152), gray);
+}
+
+// Indexed images are counted by histogram, HAM images by bitset.
+TEST_METHOD(TestStatistics) {
+  IFFReader::File indexed("../../IFF_Reader/test files/00A.iff");
+  const auto statistics = indexed.AsILBM()->Statistics();
+  Assert::AreEqual(size_t(3), statistics->unique_colors);
+  Assert::AreEqual(size_t(4), statistics->palette_entries);
+  Assert::AreEqual(size_t(3), statistics->used_entries);
+  Assert::AreEqual(size_t(1), statistics->unused_entries.size());
+
+  IFFReader::File ehb("../../IFF_Reader/test files/ehb.iff");
+  Assert::AreEqual(size_t(54), ehb.AsILBM()->ColorCount());
+  Assert::AreEqual(size_t(64), ehb.AsILBM()->Statistics()->used_entries);
+
+  IFFReader::File ham("../../IFF_Reader/test files/ham_image.iff");
+  Assert::AreEqual(size_t(534), ham.AsILBM()->ColorCount());
+  Assert::IsTrue(ham.AsILBM()->Statistics()->histogram.empty());
+}
+
+// Probing reads the header only, and agrees with a full decode.
+TEST_METHOD(TestProbe) {
+  const auto probe = IFFReader::Probe("../../IFF_Reader/test files/ehb.iff");
+  IFFReader::File f("../../IFF_Reader/test files/ehb.iff");
+  Assert::IsTrue(probe.valid);
+  Assert::AreEqual(f.AsILBM()->width(), probe.width);
+  Assert::AreEqual(f.AsILBM()->height(), probe.height);
+  Assert::AreEqual(f.AsILBM()->bitplanes_count(), probe.bitplanes);
+
+  Assert::IsFalse(IFFReader::Probe("../../IFF_Reader/main.cpp").valid);
+}
+
+// Thumbnails keep the shape of the image; sums add up per channel.
+TEST_METHOD(TestThumbnail) {
+  IFFReader::File f("../../IFF_Reader/test files/01B.iff");
+  const auto data = f.AsILBM();
+  const auto thumbnail = IFFReader::MakeThumbnail(*data, 40);
+  Assert::AreEqual(40u, thumbnail.width); // 320 x 220, in blocks of 8.
+  Assert::AreEqual(28u, thumbnail.height);
+
+  vector<uint32_t> pixels(37, 0xff204080);
+  vector<uint32_t> sums(pixels.size() * 4, 0);
+  IFFReader::AccumulatePixels(pixels.data(), pixels.size(), sums.data());
+  IFFReader::AccumulatePixels(pixels.data(), pixels.size(), sums.data());
+  Assert::AreEqual(uint32_t(0x80 * 2), sums[36 * 4]);
+  Assert::AreEqual(uint32_t(0xff * 2), sums[3]);
+}
+
+// Aspect scaling stretches to the display ratio without changing flat color.
+TEST_METHOD(TestAspectCorrection) {
+  IFFReader::File f("../../IFF_Reader/test files/01A.iff");
+  const auto data = f.AsILBM();
+  const auto scaler = data->AspectCorrection(IFFReader::ScaleFilter::Cubic);
+  Assert::IsTrue(scaler.Scales()); // 44:52, so stretched vertically.
+  Assert::AreEqual(320u, scaler.Width());
+  Assert::AreEqual(260u, scaler.Height());
+
+  // Weights sum to one: flat areas stay flat, for either filter.
+  const IFFReader::AspectScaler wide(7, 5, 20, 11);
+  Assert::AreEqual(13u, wide.Width());
+  vector<uint32_t> source(7 * 5, 0xff204080);
+  vector<uint32_t> scaled(13 * 5, 0);
+  wide.Scale(source.data(), 7, scaled.data(), 13);
+  for (const auto pixel : scaled) {
+    Assert::AreEqual(0xff204080u, pixel);
+  }
+}
+
+// The CRT filter enlarges pixels, then dims them by grille and scanline.
+TEST_METHOD(TestCRTFilter) {
+  vector<uint32_t> source(4 * 2, 0xff808080);
+  source[5] = 0xff0000ff;
+
+  // With every effect off, pixels are only enlarged.
+  IFFReader::CRTSettings plain;
+  plain.scanlines = plain.mask_strength = plain.blur = plain.bloom = 0;
+  IFFReader::CRTFilter enlarge(4, 2, plain);
+  vector<uint32_t> screen(8 * 4, 0);
+  enlarge.Apply(source.data(), 4, screen.data(), 8);
+  Assert::AreEqual(0xff0000ffu, screen[3 * 8 + 3]);
+  Assert::AreEqual(0xff808080u, screen[3 * 8 + 4]);
+
+  // The aperture grille dims the colors a column does not show, and the
+  // second row of each scanline is darker.
+  IFFReader::CRTSettings grille;
+  grille.blur = grille.bloom = 0;
+  IFFReader::CRTFilter crt(4, 2, grille);
+  crt.Apply(source.data(), 4, screen.data(), 8);
+  Assert::AreEqual(0xff5d5d7cu, screen[0]);
+  Assert::AreEqual(0xff5d7c5du, screen[1]);
+  Assert::AreEqual(0xff45455cu, screen[8]);
+}
+
+// Each field keeps its own lines and dims the other's; blending averages.
+TEST_METHOD(TestInterlaceFields) {
+  // Two lines, each two rows tall on an enlarged screen.
+  vector<uint32_t> screen = {0xff808080, 0xff808080, 0xff000000, 0xff000000};
+  const IFFReader::InterlaceFields fields(screen.data(), 1, 4, 1, 2, 128);
+
+  Assert::AreEqual(0xff808080u, fields.Field(0)[1]);
+  Assert::AreEqual(0xff000000u, fields.Field(0)[2]);
+  Assert::AreEqual(0xff404040u, fields.Field(1)[0]);
+  Assert::AreEqual(0xff404040u, fields.Blended()[0]);
+  Assert::AreEqual(0xff000000u, fields.Blended()[3]);
+
+  // Three lines stretched over four rows: the first line takes two rows,
+  // and blends both with the next line, one row tall.
+  screen = {0xff808080, 0xff808080, 0xff404040, 0xff000000};
+  const IFFReader::InterlaceFields stretched(screen.data(), 1, 4, 1, 3, 128);
+  Assert::AreEqual(0xff808080u, stretched.Field(0)[1]);
+  Assert::AreEqual(0xff202020u, stretched.Field(0)[2]);
+  Assert::AreEqual(0xff000000u, stretched.Field(0)[3]);
+  Assert::AreEqual(0xff606060u, stretched.Blended()[0]);
+  Assert::AreEqual(0xff606060u, stretched.Blended()[1]);
+}
+
+// Exports carry the resolved pixels under each format's own header.
+TEST_METHOD(TestExport) {
+  IFFReader::File f("../../IFF_Reader/test files/00A.iff");
+  const auto image = IFFReader::ResolveImage(*f.AsILBM());
+  Assert::AreEqual(size_t(9 * 4), image.pixels.size());
+
+  const auto ppm = IFFReader::EncodeImage(image, IFFReader::ExportFormat::PPM);
+  const string header = "P6\n9 4\n255\n";
+  Assert::AreEqual(header.size() + 9 * 4 * 3, ppm.size());
+  Assert::IsTrue(std::equal(header.begin(), header.end(), ppm.begin()));
+  Assert::AreEqual(uint8_t(image.pixels[0] & 0xff), ppm[header.size()]);
+
+  const auto raw = IFFReader::EncodeImage(image, IFFReader::ExportFormat::Raw);
+  Assert::AreEqual(size_t(9 * 4 * 4), raw.size());
+
+  // Resolved straight into the file, the same bytes as by way of pixels.
+  Assert::IsTrue(raw == IFFReader::EncodeImage(*f.AsILBM(),
+                                               IFFReader::ExportFormat::Raw));
+
+  const auto pam = IFFReader::EncodeImage(image, IFFReader::ExportFormat::PAM);
+  const string pam_header = "P7\nWIDTH 9\nHEIGHT 4\nDEPTH 4\nMAXVAL 255\n"
+                            "TUPLTYPE RGB_ALPHA\nENDHDR\n";
+  Assert::AreEqual(pam_header.size() + raw.size(), pam.size());
+  Assert::IsTrue(std::equal(raw.begin(), raw.end(),
+                            pam.begin() + pam_header.size()));
+}
+
+// The pacer counts frames, their intervals, and the deadlines missed.
+TEST_METHOD(TestFramePacer) {
+  FramePacer pacer(std::chrono::microseconds(1000));
+
+  // Frames that keep to time follow the period, give or take timer jitter.
+  for (int i = 0; i < 5; ++i) {
+    pacer.BeginFrame();
+    pacer.EndFrame();
+  }
+  auto stats = pacer.Stats();
+  Assert::AreEqual(uint64_t(5), stats.frames);
+  Assert::IsTrue(stats.mean_interval >= std::chrono::microseconds(900));
+
+  // A frame running well over misses the deadlines it overran.
+  pacer.BeginFrame();
+  std::this_thread::sleep_for(std::chrono::microseconds(3500));
+  pacer.EndFrame();
+  stats = pacer.Stats();
+  Assert::IsTrue(stats.dropped >= 3);
+  Assert::IsTrue(stats.p99_work >= std::chrono::microseconds(3500));
+}
+
+// Tiles are resolved on demand per level and evicted oldest first.
+TEST_METHOD(TestTileCache) {
+  IFFReader::File f("../../IFF_Reader/test files/01B.iff");
+  const shared_ptr<const IFFReader::ILBM> image = f.AsILBM();
+  IFFReader::TileCache tiles(image, 2 * 256 * 256 * 4);
+  Assert::AreEqual(2u, tiles.Columns(0));
+  Assert::AreEqual(1u, tiles.Rows(0));
+  Assert::AreEqual(160u, tiles.LevelWidth(1));
+
+  // Only prepared tiles are resolved.
+  tiles.Prepare(0, 1, 2, 0, 1);
+  Assert::IsNull(tiles.Get(0, 0, 0));
+  const auto *tile = tiles.Get(0, 1, 0);
+  Assert::IsNotNull(tile);
+  Assert::AreEqual(image->color_at(256 + 3, 5), tile[5 * 256 + 3]);
+
+  // Level 1 takes every other pixel of every other row.
+  tiles.Prepare(1, 0, 1, 0, 1);
+  Assert::AreEqual(image->color_at(6, 10), tiles.Get(1, 0, 0)[5 * 256 + 3]);
+
+  // The budget holds two tiles; the oldest goes.
+  tiles.Prepare(0, 0, 1, 0, 1);
+  Assert::IsNull(tiles.Get(0, 1, 0));
+  Assert::AreEqual(size_t(2 * 256 * 256 * 4), tiles.ResidentBytes());
+}
+
+// Checksums match the reference values; pieces end byte-aligned.
+TEST_METHOD(TestDeflate) {
+  const string text = "123456789";
+  const auto *bytes = reinterpret_cast<const uint8_t *>(text.data());
+  Assert::AreEqual(0xcbf43926u, IFFReader::Crc32(bytes, text.size()));
+  Assert::AreEqual(0x091e01deu, IFFReader::Adler32(bytes, text.size()));
+
+  // Checksums of pieces combine into that of the whole.
+  const auto first = IFFReader::Adler32(bytes, 4);
+  const auto second = IFFReader::Adler32(bytes + 4, 5);
+  Assert::AreEqual(0x091e01deu, IFFReader::CombineAdler32(first, second, 5));
+
+  // Pieces not last end in an empty stored block.
+  const bytefield zeros(1000, 0);
+  const auto piece = IFFReader::Deflate(zeros.data(), zeros.size(), false);
+  Assert::IsTrue(piece.size() < 100);
+  Assert::AreEqual(uint8_t(0xff), piece.back());
+  Assert::AreEqual(uint8_t(0x00), piece[piece.size() - 4]);
+}
+
+// PNGs keep indexed images indexed; resolved ones come out as RGBA.
+TEST_METHOD(TestPNG) {
+  IFFReader::File f("../../IFF_Reader/test files/00A.iff");
+  const auto png = IFFReader::EncodePNG(*f.AsILBM());
+  const bytefield signature = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  Assert::IsTrue(std::equal(signature.begin(), signature.end(), png.begin()));
+
+  // Two bitplanes: indexed, two bits per pixel, four palette entries.
+  Assert::AreEqual(uint8_t(2), png[24]);
+  Assert::AreEqual(uint8_t(3), png[25]);
+  Assert::AreEqual(uint8_t('P'), png[37]);
+  Assert::AreEqual(uint8_t(12), png[36]);
+
+  const auto rgba = IFFReader::EncodePNG(IFFReader::ResolveImage(*f.AsILBM()));
+  Assert::AreEqual(uint8_t(8), rgba[24]);
+  Assert::AreEqual(uint8_t(6), rgba[25]);
+}
+
+// Packing, planar conversion and a full round trip through a file.
+TEST_METHOD(TestILBMWriter) {
+  // Three pairs cost less as repeats than as one literal run.
+  const bytefield pairs = {1, 1, 2, 2, 3, 3};
+  bytefield packed;
+  IFFReader::PackByteRun1(pairs.data(), pairs.size(), packed);
+  Assert::AreEqual(size_t(6), packed.size());
+  Assert::AreEqual(uint8_t(0xff), packed[0]);
+
+  const bytefield mixed = {1, 2, 3, 3, 3, 3};
+  packed.clear();
+  IFFReader::PackByteRun1(mixed.data(), mixed.size(), packed);
+  const bytefield expected = {1, 1, 2, 0xfd, 3};
+  Assert::IsTrue(packed == expected);
+
+  // Leftmost pixel in the top bit; rows padded to whole words.
+  const bytefield indices = {1, 2, 3, 0, 0, 0, 0, 0, 3};
+  bytefield planar(4, 0xaa);
+  IFFReader::ChunkyToPlanar(indices.data(), 9, 2, planar.data(), 2);
+  Assert::AreEqual(uint8_t(0xa0), planar[0]);
+  Assert::AreEqual(uint8_t(0x80), planar[1]);
+  Assert::AreEqual(uint8_t(0x60), planar[2]);
+
+  // Written and read back, pixels are the same.
+  IFFReader::File f("../../IFF_Reader/test files/01A.iff");
+  const auto original = f.AsILBM();
+  const auto file = IFFReader::EncodeILBM(*original);
+  const auto path = fs::temp_directory_path() / "iff_reader_roundtrip.iff";
+  std::ofstream(path, std::ios::binary)
+      .write(reinterpret_cast<const char *>(file.data()),
+             static_cast<std::streamsize>(file.size()));
+
+  IFFReader::File g(path.string());
+  const auto copy = g.AsILBM();
+  Assert::AreEqual(original->ViewModes(), copy->ViewModes());
+  for (uint32_t y = 0; y < original->height(); y += 7) {
+    for (uint32_t x = 0; x < original->width(); x += 3) {
+      Assert::AreEqual(original->color_at(x, y), copy->color_at(x, y));
+    }
+  }
+  fs::remove(path);
+}
+
+// Conversion runs in parallel over a tree, and failures are counted.
+TEST_METHOD(TestBatchConverter) {
+  IFFReader::BoundedQueue<int> queue(2);
+  queue.Push(1);
+  queue.Push(2);
+  queue.Close();
+  int item = 0;
+  Assert::IsTrue(queue.Pop(item) && item == 1);
+  Assert::IsTrue(queue.Pop(item) && item == 2);
+  Assert::IsFalse(queue.Pop(item));
+
+  // Parsed from memory as from the file.
+  const fs::path files = "../../IFF_Reader/test files";
+  std::ifstream stream(files / "01B.iff", std::ios::binary);
+  const bytefield contents((std::istreambuf_iterator<char>(stream)),
+                           std::istreambuf_iterator<char>());
+  IFFReader::File f((files / "01B.iff").string());
+  IFFReader::File g("01B.iff", contents);
+  Assert::IsTrue(IFFReader::ResolveImage(*f.AsILBM()).pixels ==
+                 IFFReader::ResolveImage(*g.AsILBM()).pixels);
+
+  // Folders below the input are kept; files that are no ILBM are skipped.
+  const auto input = fs::temp_directory_path() / "iff_reader_batch_in";
+  const auto output = fs::temp_directory_path() / "iff_reader_batch_out";
+  fs::remove_all(input);
+  fs::remove_all(output);
+  fs::create_directories(input / "sub");
+  fs::copy_file(files / "00A.iff", input / "00A.iff");
+  fs::copy_file(files / "01A.iff", input / "sub" / "01A.iff");
+  std::ofstream(input / "notes.txt") << "Not an image.";
+
+  IFFReader::ConvertSettings settings;
+  settings.format = IFFReader::ExportFormat::Raw;
+  settings.queue_length = 1;
+  const auto stats = IFFReader::ConvertTree(input, output, settings);
+  Assert::AreEqual(size_t(2), stats.images);
+  Assert::AreEqual(size_t(1), stats.failed);
+
+  IFFReader::File h((files / "01A.iff").string());
+  Assert::AreEqual(static_cast<uintmax_t>(h.AsILBM()->width()) *
+                       h.AsILBM()->height() * 4,
+                   fs::file_size(output / "sub" / "01A.raw"));
+  fs::remove_all(output);
+
+  // Of sources sharing a target, the one found second keeps its extension
+  // in the name. An output folder inside the input is not converted, not
+  // even when converting a second time.
+  fs::copy_file(files / "01A.iff", input / "00A.lbm");
+  for (int pass = 0; pass < 2; ++pass) {
+    const auto inside = IFFReader::ConvertTree(input, input / "out", settings);
+    Assert::AreEqual(size_t(3), inside.images);
+    Assert::AreEqual(size_t(1), inside.failed);
+  }
+  Assert::IsTrue(fs::exists(input / "out" / "00A.raw"));
+  Assert::IsTrue(fs::exists(input / "out" / "00A.lbm.raw") ||
+                 fs::exists(input / "out" / "00A.iff.raw"));
+  fs::remove_all(input);
+}
+
+// Sidecars decode once, go stale with their source, and are pruned.
+TEST_METHOD(TestDecodeCache) {
+  const auto folder = fs::temp_directory_path() / "iff_reader_sidecars";
+  const auto source = fs::temp_directory_path() / "iff_reader_sidecar.iff";
+  fs::remove_all(folder);
+  fs::copy_file("../../IFF_Reader/test files/cycle.iff", source,
+                fs::copy_options::overwrite_existing);
+
+  // The first open decodes and writes the sidecar, the second reads it.
+  const IFFReader::DecodeCache cache(folder);
+  Assert::IsFalse(static_cast<bool>(cache.Load(source)));
+  const auto decoded = cache.Open(source);
+  const auto loaded = cache.Load(source);
+  Assert::IsTrue(fs::exists(cache.SidecarPath(source)));
+  Assert::IsTrue(static_cast<bool>(loaded));
+  Assert::IsTrue(IFFReader::ResolveImage(*decoded).pixels ==
+                 IFFReader::ResolveImage(*loaded).pixels);
+  Assert::IsTrue(loaded->HasColorCycling());
+
+  // Changed contents make the sidecar stale, even at the same time.
+  const auto time = fs::last_write_time(source);
+  {
+    std::fstream file(source, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(100);
+    file.put(0x55);
+  }
+  fs::last_write_time(source, time);
+  Assert::IsFalse(static_cast<bool>(cache.Load(source)));
+
+  // Past the limit, the sidecar used longest ago is removed first.
+  const auto other = fs::temp_directory_path() / "iff_reader_sidecar2.iff";
+  fs::copy_file("../../IFF_Reader/test files/cycle.iff", source,
+                fs::copy_options::overwrite_existing);
+  fs::copy_file(source, other, fs::copy_options::overwrite_existing);
+  Assert::IsTrue(static_cast<bool>(cache.Open(source)));
+  const auto sidecar = cache.SidecarPath(source);
+  fs::last_write_time(sidecar,
+                      fs::last_write_time(sidecar) - std::chrono::hours(1));
+  const IFFReader::DecodeCache small(folder, 2 * fs::file_size(sidecar));
+  Assert::IsTrue(static_cast<bool>(small.Open(other)));
+  Assert::IsFalse(fs::exists(sidecar));
+  Assert::IsTrue(fs::exists(small.SidecarPath(other)));
+
+  fs::remove(source);
+  fs::remove(other);
+  fs::remove_all(folder);
+}
+
+// Schemas pack and unpack any depth and plane order without loss.
+TEST_METHOD(TestImageSchema) {
+  // Depths that do not divide eight straddle bytes.
+  const bytefield indices = {5, 2, 7, 1};
+  IFFReader::IndexedImage small;
+  small.indices = indices.data();
+  small.width = 4;
+  small.height = 1;
+  small.stride = 4;
+  small.palette = {0xff123456};
+  using Chunky3 = IFFReader::ImageSchema<3, IFFReader::PlaneOrder::Chunky,
+                                         IFFReader::PaletteFormat::RGB4>;
+  const auto stored = Chunky3::Encode(small);
+  const bytefield expected = {0, 4, 0, 1, 0, 1, 0x05, 0x31, 0xab, 0x90};
+  Assert::IsTrue(stored == expected);
+
+  // Every layout and packing reads back as written.
+  IFFReader::File f("../../IFF_Reader/test files/01A.iff");
+  const auto image = f.AsILBM()->GetIndexed();
+  const auto check = [&image](const auto schema) {
+    using Schema = decltype(schema);
+    IFFReader::SchemaImage copy;
+    Assert::IsTrue(Schema::Decode(Schema::Encode(image), copy));
+    Assert::AreEqual(image.width, copy.width);
+    for (uint32_t y = 0; y < image.height; ++y) {
+      for (uint32_t x = 0; x < image.width; ++x) {
+        Assert::AreEqual(
+            static_cast<uint8_t>(image.indices[y * image.stride + x] &
+                                 Schema::mask),
+            copy.indices[size_t(y) * image.width + x]);
+      }
+    }
+  };
+  using IFFReader::Compression;
+  using IFFReader::PaletteFormat;
+  using IFFReader::PlaneOrder;
+  check(IFFReader::ImageSchema<8, PlaneOrder::Chunky, PaletteFormat::RGB8,
+                               Compression::LZ>());
+  check(IFFReader::ImageSchema<5, PlaneOrder::Chunky, PaletteFormat::RGB4,
+                               Compression::ByteRun1>());
+  check(IFFReader::ImageSchema<4, PlaneOrder::Planar, PaletteFormat::RGB8,
+                               Compression::ByteRun1>());
+  check(IFFReader::ImageSchema<5, PlaneOrder::Interleaved,
+                               PaletteFormat::RGB4, Compression::LZ>());
+
+  // A damaged stream is refused.
+  using Packed = IFFReader::ImageSchema<4, PlaneOrder::Interleaved,
+                                        PaletteFormat::RGB4, Compression::LZ>;
+  auto damaged = Packed::Encode(image);
+  damaged.resize(damaged.size() / 2);
+  IFFReader::SchemaImage copy;
+  Assert::IsFalse(Packed::Decode(damaged, copy));
+}
+
+// Vertical byte deltas change only the columns and rows they name.
+TEST_METHOD(TestAnimation) {
+  // One plane 16 pixels wide: column 0 copies two bytes, skips one and
+  // repeats a byte twice; column 1 is left alone.
+  IFFReader::PlanarFrame frame(16, 6, 1);
+  bytefield delta(64, 0);
+  delta[3] = 64;
+  const bytefield ops = {3, 0x82, 0x11, 0x22, 1, 0, 2, 0x33, 0};
+  delta.insert(delta.end(), ops.begin(), ops.end());
+  IFFReader::DirtyRows dirty;
+  Assert::IsTrue(
+      IFFReader::ApplyByteVerticalDelta(delta, false, frame, dirty));
+  const bytefield column = {0x11, 0x22, 0, 0x33, 0x33, 0};
+  for (uint32_t y = 0; y < 6; ++y) {
+    Assert::AreEqual(column[y], frame.Plane(0)[y * frame.row_bytes]);
+    Assert::AreEqual(uint8_t(column[y] != 0), dirty[y]);
+  }
+
+  // XORed twice, the frame is as before.
+  Assert::IsTrue(IFFReader::ApplyByteVerticalDelta(delta, true, frame, dirty));
+  Assert::AreEqual(uint8_t(0), frame.Plane(0)[0]);
+
+  // The test clip moves a box over a pattern, each delta against the frame
+  // before last.
+  IFFReader::File f("../../IFF_Reader/test files/anim5.anim");
+  const auto anim = f.AsANIM();
+  Assert::IsTrue(f.GetType() == IFFReader::IFF_T::ANIM);
+  Assert::AreEqual(size_t(10), anim->FrameCount());
+  Assert::AreEqual(uint32_t(10), anim->DisplayJiffies(2));
+
+  for (uint32_t n = 1; n <= 10; ++n) {
+    Assert::IsTrue(anim->NextFrame());
+    const auto shown = n % 10;
+    Assert::AreEqual(size_t(shown), anim->CurrentFrame());
+    if (shown > 0) {
+      Assert::IsTrue(anim->ChangedRows().size() < 50);
+    }
+    const auto image = anim->Image()->GetIndexed();
+    for (uint32_t y = 0; y < image.height; ++y) {
+      for (uint32_t x = 0; x < image.width; ++x) {
+        Assert::AreEqual(animation_index(shown, x, y),
+                         image.indices[y * image.stride + x]);
+      }
+    }
+  }
+
+  // Sizes claiming more than is there are not allocated: a delta is cut to
+  // what its frame holds, and a frame running off the end is left out.
+  std::ifstream in("../../IFF_Reader/test files/anim5.anim", std::ios::binary);
+  bytefield clip(std::istreambuf_iterator<char>(in), {});
+  const auto last = [&](const string &tag) {
+    return std::find_end(clip.begin(), clip.end(), tag.begin(), tag.end()) -
+           clip.begin() + 4;
+  };
+  const auto claim = [&](const std::ptrdiff_t at) {
+    clip[at] = 0x7f;
+    IFFReader::MemoryStream stream(clip.data() + 12, clip.size() - 12);
+    return IFFReader::ANIM(stream).FrameCount();
+  };
+  Assert::AreEqual(size_t(10), claim(last("DLTA")));
+  Assert::AreEqual(size_t(9), claim(last("FORM")));
+}
+
+// Every delta encoding decodes the clip, and is timed per operation.
+TEST_METHOD(TestAnimationDeltas) {
+  // The clip of TestAnimation, encoded with the other operations, in words
+  // and longwords. Eighty pixels are two longwords and a word.
+  const fs::path files = "../../IFF_Reader/test files";
+  IFFReader::DeltaBenchmarks results;
+  for (const auto *name :
+       {"anim7.anim", "anim7l.anim", "anim8.anim", "anim8l.anim",
+        "animj.anim"}) {
+    IFFReader::File f((files / name).string());
+    const auto anim = f.AsANIM();
+    Assert::IsTrue(static_cast<bool>(anim));
+    for (uint32_t n = 1; n < anim->FrameCount(); ++n) {
+      Assert::IsTrue(anim->NextFrame());
+      const auto image = anim->Image()->GetIndexed();
+      for (uint32_t y = 0; y < image.height; ++y) {
+        for (uint32_t x = 0; x < image.width; ++x) {
+          Assert::AreEqual(animation_index(n, x, y),
+                           image.indices[y * image.stride + x]);
+        }
+      }
+    }
+    IFFReader::BenchmarkDeltas(*anim, 2, results);
+  }
+
+  // Nine deltas a clip, played twice.
+  Assert::AreEqual(size_t(3), results.size());
+  Assert::AreEqual(size_t(2), results[IFFReader::ANIM_OP_VERTICAL_WORD].clips);
+  Assert::AreEqual(size_t(18),
+                   results[IFFReader::ANIM_OP_ERIC_GRAHAM].frames);
+  Assert::AreEqual(size_t(0),
+                   results[IFFReader::ANIM_OP_SHORT_LONG_VERTICAL].failed);
+}
+
+// Animations probe, seek through keyframes and play from a ring.
+TEST_METHOD(TestAnimationPlayer) {
+  const string path = "../../IFF_Reader/test files/anim5.anim";
+  const auto probe = IFFReader::Probe(path);
+  Assert::IsTrue(probe.valid && probe.animation);
+  Assert::AreEqual(uint32_t(80), probe.width);
+
+  // The decode cache keeps still images only, and leaves animations be.
+  const auto folder = fs::temp_directory_path() / "iff_reader_anim_sidecars";
+  const IFFReader::DecodeCache cache(folder);
+  Assert::IsFalse(static_cast<bool>(cache.Open(path)));
+  Assert::IsFalse(fs::exists(cache.SidecarPath(path)));
+
+  // Keyframes at frames 3, 6 and 9; seeking anywhere, back or forward,
+  // shows the same frame as playing up to it.
+  IFFReader::File f(path);
+  const auto anim = f.AsANIM();
+  Assert::IsTrue(anim->IndexKeyframes(3));
+  Assert::AreEqual(size_t(3), anim->KeyframeCount());
+  Assert::AreEqual(size_t(0), anim->CurrentFrame());
+  for (const uint32_t n : {7, 2, 9, 0, 5, 6, 1, 8, 3, 4, 4}) {
+    Assert::IsTrue(anim->Seek(n));
+    Assert::AreEqual(size_t(n), anim->CurrentFrame());
+    const auto image = anim->Image()->GetIndexed();
+    for (uint32_t y = 0; y < image.height; ++y) {
+      for (uint32_t x = 0; x < image.width; ++x) {
+        Assert::AreEqual(animation_index(n, x, y),
+                         image.indices[y * image.stride + x]);
+      }
+    }
+  }
+  Assert::IsFalse(anim->Seek(10));
+
+  // Frames come out of the ring in order, from where the player was
+  // started or last sought to, wrapping after the last.
+  const auto palette = anim->Image()->GetIndexed().palette;
+  const auto width = anim->Image()->width();
+  IFFReader::ResolvedFrame frame;
+  {
+    IFFReader::AnimationPlayer player(anim, 7, 3);
+    const auto next = [&] {
+      while (!player.Pop(frame)) {
+        std::this_thread::yield();
+      }
+      return frame.frame;
+    };
+    Assert::AreEqual(size_t(7), next());
+    Assert::AreEqual(size_t(8), next());
+    Assert::AreEqual(size_t(9), next());
+    Assert::AreEqual(uint32_t(4), frame.jiffies);
+    Assert::AreEqual(size_t(0), next());
+    player.Seek(2);
+    Assert::AreEqual(size_t(2), next());
+    Assert::AreEqual(uint32_t(10), frame.jiffies);
+    Assert::AreEqual(size_t(3), next());
+    Assert::AreEqual(size_t(0), player.Damaged());
+  }
+  for (uint32_t y = 0; y < 50; ++y) {
+    for (uint32_t x = 0; x < width; ++x) {
+      Assert::AreEqual(palette[animation_index(3, x, y)],
+                       frame.pixels[y * width + x]);
+    }
+  }
+}
 }
 ;
 }